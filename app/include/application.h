@@ -18,6 +18,8 @@ typedef struct Application
     // Internal timing
     uint8_t target_fps;
     double frame_target_frequency;
+    // Deadline of the next frame on the GetMonotonicTime clock.
+    double next_frame_time;
     uint64_t frame_count;
     double prev_fps_update_time;
     // Context and data
@@ -29,10 +31,12 @@ typedef struct Application
 /// @details This sets up all the vulkan configuration, GLFW configuration and custom configurations.
 /// @param src_display_buffer Pointer to the memory region that the graphics library will draw from.
 /// @param src_display_buffer_size Size of memory region that the graphics library will draw from.
+/// @param present_mode requested swapchain present mode. Falls back to FIFO if unsupported.
 /// @return Returns a handle to the created application.
-Application *CreateApplication(Display *display, uint16_t *keys, uint8_t target_fps, LogLevel log_level);
+Application *CreateApplication(Display *display, InputChannel *input, uint8_t target_fps, GraphioPresentMode present_mode, LogLevel log_level);
 
 /// @brief Starts the application in a new thread with a render loop at 60 hz.
+/// @details Frames start on an absolute schedule, so sleep overshoot doesn't accumulate as drift.
 /// @param app Handle to application.
 void RunApplication(Application *app);
 
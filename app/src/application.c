@@ -7,7 +7,7 @@
 
 #include "application.h"
 
-Application *CreateApplication(Display *display, uint16_t *keys, uint8_t target_fps, LogLevel log_level)
+Application *CreateApplication(Display *display, InputChannel *input, uint8_t target_fps, GraphioPresentMode present_mode, LogLevel log_level)
 {
     Application *app = calloc(1, sizeof(Application));
 
@@ -20,48 +20,59 @@ Application *CreateApplication(Display *display, uint16_t *keys, uint8_t target_
     logger_LogDebug(app->logger, "Frame target frequency: %f secs.", app->frame_target_frequency);
 
     // Create and configure graphics context.
-    app->gio_context = gio_CreateGraphioContext(app->logger, display, keys);
+    app->gio_context = gio_CreateGraphioContext(app->logger, display, input, present_mode);
 
     return app;
 }
 
 void RunApplication(Application *app)
 {
+    app->next_frame_time = GetMonotonicTime();
+    app->prev_fps_update_time = app->next_frame_time;
+
     // Each cycle of this loop is one frame.
     while (!glfwWindowShouldClose(app->gio_context->window))
     {
-        // Get start time of frame.
-        double start_time = gio_GetCurrentTime();
-
         // Poll events
         glfwPollEvents();
 
-        // TODO: Draw display to screen.
         gio_Draw(app->gio_context);
 
-        // Get end time of frame, calculate delta and delay.
-        double end_time = gio_GetCurrentTime();
-
-        double delta_time = end_time - start_time;
-        struct timespec delay_time = {
-            .tv_nsec = SEC_TO_NS(app->frame_target_frequency - delta_time),
-        };
-
-        // Cap at target FPS.
-        if (delay_time.tv_nsec > 0)
+        // Cap at target FPS. Deadlines advance by whole periods, so a late frame is made up
+        // by the next one rather than pushing every later frame back.
+        app->next_frame_time += app->frame_target_frequency;
+        double now = GetMonotonicTime();
+        if (now - app->next_frame_time > app->frame_target_frequency)
         {
-            nanosleep(&delay_time, NULL);
+            // More than a frame behind, e.g. after a stall. Start over instead of bursting frames.
+            app->next_frame_time = now;
+        }
+        else
+        {
+            SleepUntil(app->next_frame_time, SLEEP_SPIN_THRESHOLD);
         }
 
         // Calculate FPS.
-        end_time = gio_GetCurrentTime();
-        delta_time = end_time - app->prev_fps_update_time;
+        double end_time = GetMonotonicTime();
+        double delta_time = end_time - app->prev_fps_update_time;
         app->frame_count++;
         if (delta_time >= 1.0)
         {
             double fps = (double)app->frame_count / delta_time;
             gio_UpdateFPS(app->gio_context, fps);
 
+            FrameMetrics metrics;
+            gio_GetFrameMetrics(app->gio_context, &metrics);
+            logger_LogDebug(app->logger,
+                            "Frame time ms p50 %.2f p95 %.2f p99 %.2f max %.2f. "
+                            "Input latency ms p50 %.2f p95 %.2f p99 %.2f max %.2f (%llu samples, present wait %s).",
+                            metrics.frame_time_p50 * 1e3, metrics.frame_time_p95 * 1e3,
+                            metrics.frame_time_p99 * 1e3, metrics.frame_time_max * 1e3,
+                            metrics.input_latency_p50 * 1e3, metrics.input_latency_p95 * 1e3,
+                            metrics.input_latency_p99 * 1e3, metrics.input_latency_max * 1e3,
+                            (unsigned long long)metrics.input_latency_samples,
+                            metrics.present_wait ? "on" : "off");
+
             app->frame_count = 0;
             app->prev_fps_update_time = end_time;
         }
@@ -1,12 +1,11 @@
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 
 #include <core/cpu.h>
 #include <core/memory.h>
 #include <core/keys.h>
 
-#include <loader/loader.h>
-
 #include <application.h>
 
 #ifdef CH8_PNGS_DIR
@@ -23,24 +22,39 @@
 
 #define TEST_SUITE_ROMS ROMS_BASE_PATH "test_suite/"
 
+static GraphioPresentMode ParsePresentMode(const char *name);
+
 int main(int argc, char **argv)
 {
-    core_InitializeLoader(LOG_LEVEL_FULL);
+    // Keep log file I/O off the emulation and render threads. Records are dropped rather than stalling them.
+    logger_StartAsync(LOGGER_ASYNC_DEFAULT_CAPACITY, LOGGER_OVERFLOW_DROP);
 
-    CPUState *cpu = core_CreateCPU(60, gio_GetCurrentTime, LOG_LEVEL_FULL);
+    CPUState *cpu = core_CreateCPU(60, CH8_DEFAULT_SEED, gio_GetCurrentTime, LOG_LEVEL_FULL);
 
     if (argc == 1)
     {
-        core_LoadBinary16File(TEST_SUITE_ROMS "7-beep.ch8", cpu->memory,
-                              CH8_PROGRAM_START_ADDRESS, cpu->memory_size);
+        core_LoadProgramCPU(cpu, TEST_SUITE_ROMS "7-beep.ch8");
+    }
+    else if (argc >= 2)
+    {
+        // XO-CHIP ROMs are told apart by their .xo8 extension.
+        core_SetMachineCPU(cpu, core_GetMachineForROM(argv[1]));
+        core_LoadProgramCPU(cpu, argv[1]);
     }
-    else if (argc == 2)
+
+    // Optional second argument: fifo, mailbox or immediate.
+    GraphioPresentMode present_mode = argc >= 3 ? ParsePresentMode(argv[2]) : GRAPHIO_PRESENT_MODE_MAILBOX;
+
+    // Optional third argument: file to record input to, for replay with ch8-replay.
+    Movie *movie = NULL;
+    if (argc >= 4)
     {
-        core_LoadBinary16File(argv[1], cpu->memory,
-                              CH8_PROGRAM_START_ADDRESS, cpu->memory_size);
+        movie = core_CreateMovieRecorder(argv[3], cpu);
+        if (movie != NULL)
+            core_SetMovieCPU(cpu, movie);
     }
 
-    Application *app = CreateApplication(&cpu->display, &cpu->keys, 60, LOG_LEVEL_FULL);
+    Application *app = CreateApplication(&cpu->display, &cpu->input, 60, present_mode, LOG_LEVEL_FULL);
 
     core_StartCPU(cpu);
 
@@ -48,15 +62,34 @@ int main(int argc, char **argv)
 
     core_StopCPU(cpu);
 
+    if (movie != NULL)
+    {
+        core_SetMovieCPU(cpu, NULL);
+        core_DestroyMovie(movie);
+    }
+
     DestroyApplication(app);
 
-    gio_SavePixelBufferPNG(PNGS_BASE_PATH "display_buffer.png", cpu->display.display_buffer,
+    uint8_t display_rgba[CH8_INTERNAL_DISPLAY_BUFFER_SIZE];
+    core_ExpandDisplayRGBA(cpu->display.planes, cpu->display.plane_mask, cpu->display.hires, display_rgba);
+    gio_SavePixelBufferPNG(PNGS_BASE_PATH "display_buffer.png", display_rgba,
                            cpu->display.display_buffer_width,
                            cpu->display.display_buffer_height,
                            cpu->display.display_buffer_channels);
 
     core_DestroyCPU(cpu);
 
-    core_DestroyLoader();
+    logger_StopAsync();
     return 0;
 }
+
+GraphioPresentMode ParsePresentMode(const char *name)
+{
+    if (strcmp(name, "fifo") == 0)
+        return GRAPHIO_PRESENT_MODE_FIFO;
+    if (strcmp(name, "immediate") == 0)
+        return GRAPHIO_PRESENT_MODE_IMMEDIATE;
+    if (strcmp(name, "mailbox") != 0)
+        fprintf(stderr, "Unknown present mode %s. Using mailbox.\n", name);
+    return GRAPHIO_PRESENT_MODE_MAILBOX;
+}
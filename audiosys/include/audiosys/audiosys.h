@@ -2,6 +2,7 @@
 #define AUDIOSYS_AUDIOSYS_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #include <AL/al.h>
@@ -34,6 +35,14 @@ void aud_DestroyAudioContext(AudioContext *ctx);
 
 bool aud_CreateSound(AudioContext *ctx, const char *path, uint8_t slot, bool looping);
 
+/// @brief Fills 'slot' with mono 8-bit unsigned samples instead of a .wav file.
+/// @details Stops the slot first if it is playing.
+/// @param samples samples to copy. Not referenced after the call.
+/// @param sample_count number of samples.
+/// @param sample_rate playback rate in Hz.
+bool aud_CreateSoundFromSamples(AudioContext *ctx, const uint8_t *samples, size_t sample_count,
+                                uint32_t sample_rate, uint8_t slot, bool looping);
+
 bool aud_PlaySound(AudioContext *ctx, uint8_t slot);
 
 bool aud_StopSound(AudioContext *ctx, uint8_t slot);
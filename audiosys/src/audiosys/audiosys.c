@@ -148,6 +148,32 @@ bool aud_CreateSound(AudioContext *ctx, const char *path, uint8_t slot, bool loo
     return true;
 }
 
+bool aud_CreateSoundFromSamples(AudioContext *ctx, const uint8_t *samples, size_t sample_count,
+                                uint32_t sample_rate, uint8_t slot, bool looping)
+{
+    if (ctx->slots[slot])
+    {
+        // A buffer can't be detached from a source that is still playing it.
+        alSourceStop(ctx->sources[slot]);
+        alSourcei(ctx->sources[slot], AL_BUFFER, 0);
+    }
+
+    // OpenAL copies the samples, so the caller may reuse them.
+    alBufferData(ctx->source_buffers[slot], AL_FORMAT_MONO8, samples, sample_count, sample_rate);
+    if (CheckOpenalError())
+        return false;
+
+    alSourcei(ctx->sources[slot], AL_BUFFER, ctx->source_buffers[slot]);
+    if (CheckOpenalError())
+        raise(SIGABRT);
+
+    alSourcei(ctx->sources[slot], AL_LOOPING, looping ? AL_TRUE : AL_FALSE);
+
+    ctx->slots[slot] = true;
+
+    return true;
+}
+
 bool aud_PlaySound(AudioContext *ctx, uint8_t slot)
 {
     if (!ctx->slots[slot])
@@ -0,0 +1,39 @@
+#ifndef MATHS_RANDOM_H
+#define MATHS_RANDOM_H
+
+#include <stdint.h>
+
+// State of a xoshiro256** generator. Cheap to copy and owned by its user, so
+// independent instances never share or lock a sequence.
+typedef struct
+{
+    uint64_t s[4];
+} RandomState;
+
+/// @brief Seeds 'state' from a single 64-bit value using splitmix64.
+/// @details Equal seeds always produce equal sequences. Any seed, including 0, is valid.
+void SeedRandomState(RandomState *state, uint64_t seed);
+
+static inline uint64_t RotateLeft64(uint64_t x, int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+/// @brief Returns the next 64 random bits. The high bits are the strongest.
+static inline uint64_t NextRandomState(RandomState *state)
+{
+    uint64_t *s = state->s;
+    const uint64_t result = RotateLeft64(s[1] * 5, 7) * 9;
+    const uint64_t t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = RotateLeft64(s[3], 45);
+
+    return result;
+}
+
+#endif
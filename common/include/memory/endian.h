@@ -0,0 +1,29 @@
+#ifndef COMMON_ENDIAN_H
+#define COMMON_ENDIAN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Helpers for file formats, which are all little-endian whatever the host.
+
+/// @brief Writes the low 'size' bytes of 'value' at 'buffer + *offset' and advances 'offset'.
+static inline void WriteLittleEndian(uint8_t *buffer, size_t *offset, uint64_t value, size_t size)
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        buffer[(*offset)++] = (value >> (8 * i)) & 0xFF;
+    }
+}
+
+/// @brief Reads a 'size' byte value at 'buffer + *offset' and advances 'offset'.
+static inline uint64_t ReadLittleEndian(const uint8_t *buffer, size_t *offset, size_t size)
+{
+    uint64_t value = 0;
+    for (size_t i = 0; i < size; i++)
+    {
+        value |= (uint64_t)buffer[(*offset)++] << (8 * i);
+    }
+    return value;
+}
+
+#endif
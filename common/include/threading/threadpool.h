@@ -0,0 +1,73 @@
+#ifndef COMMON_THREADPOOL_H
+#define COMMON_THREADPOOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+typedef void (*ThreadPoolTask)(void *argument);
+
+typedef struct
+{
+    ThreadPoolTask task;
+    void *argument;
+} ThreadPoolJob;
+
+// Double-ended queue of jobs owned by one worker. The owner pushes and pops at the bottom,
+// idle workers steal from the top, so each worker mostly runs what it submitted itself.
+typedef struct
+{
+    pthread_mutex_t lock;
+    ThreadPoolJob *jobs;
+    size_t capacity;
+    size_t top;
+    size_t bottom;
+} ThreadPoolDeque;
+
+typedef struct ThreadPool ThreadPool;
+
+typedef struct
+{
+    ThreadPool *pool;
+    size_t index;
+    pthread_t thread_id;
+    uint64_t jobs_run;
+    uint64_t jobs_stolen;
+} ThreadPoolWorker;
+
+struct ThreadPool
+{
+    ThreadPoolWorker *workers;
+    ThreadPoolDeque *deques;
+    size_t count;
+    // Jobs submitted but not yet taken by a worker. Counted just before the push, so it can
+    // briefly run ahead of the deques. Workers sleep while it is zero.
+    size_t queued;
+    // Jobs submitted but not finished.
+    size_t pending;
+    // Round-robin target for jobs submitted from outside the pool.
+    size_t next_deque;
+    bool stopping;
+    pthread_mutex_t lock;
+    pthread_cond_t work_available;
+    pthread_cond_t all_done;
+};
+
+/// @brief Starts a work-stealing pool.
+/// @param n_threads number of workers. One per online CPU if 0.
+/// @return handle to pool.
+ThreadPool *CreateThreadPool(size_t n_threads);
+
+/// @brief Queues 'task(argument)'.
+/// @details Called from a worker, the job goes on that worker's own deque, so a task can
+/// resubmit itself to continue later without losing locality. Otherwise jobs are spread round-robin.
+void SubmitThreadPool(ThreadPool *pool, ThreadPoolTask task, void *argument);
+
+/// @brief Blocks until every submitted job, including jobs submitted by jobs, has finished.
+void WaitThreadPool(ThreadPool *pool);
+
+/// @brief Waits for pending jobs, stops the workers and frees the pool.
+void DestroyThreadPool(ThreadPool *pool);
+
+#endif
@@ -5,6 +5,19 @@
 #define SEC_TO_NS(sec) ((sec) * SEC_TO_NS_FACTOR)
 #define NS_TO_SEC(sec) ((double)(sec) / SEC_TO_NS_FACTOR)
 
+// Remaining time below which SleepUntil spins rather than sleeps, in seconds.
+// Covers the usual scheduler wake-up latency of a few hundred microseconds with margin.
+#define SLEEP_SPIN_THRESHOLD (0.002)
 
+/// @brief Returns seconds on a monotonic clock with an arbitrary epoch.
+double GetMonotonicTime();
+
+/// @brief Waits until GetMonotonicTime() reaches 'deadline'.
+/// @details Sleeps for all but the last 'spin_threshold' seconds, then spins. Plain sleeps
+/// routinely overshoot by a scheduler tick; spinning the remainder keeps the wake-up within
+/// microseconds at the cost of a little CPU time. Returns at once if 'deadline' has passed.
+/// @param deadline time to wait for, as returned by GetMonotonicTime.
+/// @param spin_threshold seconds before 'deadline' to stop sleeping. SLEEP_SPIN_THRESHOLD suits most uses.
+void SleepUntil(double deadline, double spin_threshold);
 
 #endif
@@ -0,0 +1,13 @@
+#include "maths/random.h"
+
+void SeedRandomState(RandomState *state, uint64_t seed)
+{
+    // splitmix64 spreads the seed over all 256 bits and never yields the all-zero state.
+    for (int i = 0; i < 4; i++)
+    {
+        uint64_t z = (seed += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        state->s[i] = z ^ (z >> 31);
+    }
+}
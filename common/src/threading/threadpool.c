@@ -0,0 +1,226 @@
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "threading/threadpool.h"
+#include "memory/memory.h"
+
+// Worker running on this thread, or NULL outside the pool.
+static __thread ThreadPoolWorker *current_worker = NULL;
+
+static void *RunWorker(void *vargp);
+static void PushBottom(ThreadPoolDeque *deque, ThreadPoolJob job);
+static bool PopBottom(ThreadPoolDeque *deque, ThreadPoolJob *job);
+static bool StealTop(ThreadPoolDeque *deque, ThreadPoolJob *job);
+static bool FindJob(ThreadPoolWorker *worker, ThreadPoolJob *job);
+
+ThreadPool *CreateThreadPool(size_t n_threads)
+{
+    if (n_threads == 0)
+    {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        n_threads = online > 0 ? (size_t)online : 1;
+    }
+
+    ThreadPool *pool = calloc(1, sizeof(ThreadPool));
+    pool->count = n_threads;
+    pool->workers = calloc(n_threads, sizeof(ThreadPoolWorker));
+    pool->deques = calloc(n_threads, sizeof(ThreadPoolDeque));
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work_available, NULL);
+    pthread_cond_init(&pool->all_done, NULL);
+
+    for (size_t i = 0; i < n_threads; i++)
+    {
+        pthread_mutex_init(&pool->deques[i].lock, NULL);
+        pool->workers[i].pool = pool;
+        pool->workers[i].index = i;
+    }
+    for (size_t i = 0; i < n_threads; i++)
+    {
+        pthread_create(&pool->workers[i].thread_id, NULL, RunWorker, &pool->workers[i]);
+    }
+
+    return pool;
+}
+
+void SubmitThreadPool(ThreadPool *pool, ThreadPoolTask task, void *argument)
+{
+    ThreadPoolJob job = {task, argument};
+
+    // Count the job before it becomes stealable. Otherwise another worker could run and finish
+    // it first, taking 'pending' to 0 while its submitter is still running and 'queued' below 0.
+    pthread_mutex_lock(&pool->lock);
+    size_t index;
+    if (current_worker != NULL && current_worker->pool == pool)
+    {
+        index = current_worker->index;
+    }
+    else
+    {
+        index = pool->next_deque++ % pool->count;
+    }
+    pool->queued++;
+    pool->pending++;
+    pthread_mutex_unlock(&pool->lock);
+
+    PushBottom(&pool->deques[index], job);
+
+    pthread_mutex_lock(&pool->lock);
+    pthread_cond_signal(&pool->work_available);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void WaitThreadPool(ThreadPool *pool)
+{
+    pthread_mutex_lock(&pool->lock);
+    while (pool->pending > 0)
+    {
+        pthread_cond_wait(&pool->all_done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void DestroyThreadPool(ThreadPool *pool)
+{
+    WaitThreadPool(pool);
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->work_available);
+    pthread_mutex_unlock(&pool->lock);
+
+    // Workers still running may steal from any deque, so join them all before tearing down.
+    for (size_t i = 0; i < pool->count; i++)
+    {
+        pthread_join(pool->workers[i].thread_id, NULL);
+    }
+    for (size_t i = 0; i < pool->count; i++)
+    {
+        pthread_mutex_destroy(&pool->deques[i].lock);
+        FREE_ARRAY(ThreadPoolJob, pool->deques[i].jobs, pool->deques[i].capacity);
+    }
+
+    pthread_cond_destroy(&pool->all_done);
+    pthread_cond_destroy(&pool->work_available);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->deques);
+    free(pool->workers);
+    free(pool);
+}
+
+void *RunWorker(void *vargp)
+{
+    ThreadPoolWorker *worker = vargp;
+    ThreadPool *pool = worker->pool;
+    current_worker = worker;
+
+    for (;;)
+    {
+        ThreadPoolJob job;
+        if (FindJob(worker, &job))
+        {
+            job.task(job.argument);
+            worker->jobs_run++;
+
+            pthread_mutex_lock(&pool->lock);
+            if (--pool->pending == 0)
+            {
+                pthread_cond_broadcast(&pool->all_done);
+            }
+            pthread_mutex_unlock(&pool->lock);
+            continue;
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        while (pool->queued == 0 && !pool->stopping)
+        {
+            pthread_cond_wait(&pool->work_available, &pool->lock);
+        }
+        bool stopping = pool->stopping && pool->queued == 0;
+        pthread_mutex_unlock(&pool->lock);
+
+        if (stopping)
+        {
+            break;
+        }
+    }
+
+    current_worker = NULL;
+    return NULL;
+}
+
+bool FindJob(ThreadPoolWorker *worker, ThreadPoolJob *job)
+{
+    ThreadPool *pool = worker->pool;
+
+    bool found = PopBottom(&pool->deques[worker->index], job);
+    for (size_t i = 1; !found && i < pool->count; i++)
+    {
+        // Steal from the other workers, starting with our neighbour.
+        found = StealTop(&pool->deques[(worker->index + i) % pool->count], job);
+        if (found)
+        {
+            worker->jobs_stolen++;
+        }
+    }
+
+    if (found)
+    {
+        pthread_mutex_lock(&pool->lock);
+        pool->queued--;
+        pthread_mutex_unlock(&pool->lock);
+    }
+
+    return found;
+}
+
+void PushBottom(ThreadPoolDeque *deque, ThreadPoolJob job)
+{
+    pthread_mutex_lock(&deque->lock);
+    if (deque->bottom - deque->top == deque->capacity)
+    {
+        // Grow and unwrap the ring so 'top' starts at index 0.
+        size_t old_capacity = deque->capacity;
+        size_t new_capacity = GROW_CAPACITY(old_capacity);
+        ThreadPoolJob *jobs = ALLOCATE(ThreadPoolJob, new_capacity);
+        for (size_t i = 0; i < old_capacity; i++)
+        {
+            jobs[i] = deque->jobs[(deque->top + i) % old_capacity];
+        }
+        FREE_ARRAY(ThreadPoolJob, deque->jobs, old_capacity);
+        deque->jobs = jobs;
+        deque->capacity = new_capacity;
+        deque->bottom -= deque->top;
+        deque->top = 0;
+    }
+
+    deque->jobs[deque->bottom % deque->capacity] = job;
+    deque->bottom++;
+    pthread_mutex_unlock(&deque->lock);
+}
+
+bool PopBottom(ThreadPoolDeque *deque, ThreadPoolJob *job)
+{
+    pthread_mutex_lock(&deque->lock);
+    bool found = deque->bottom != deque->top;
+    if (found)
+    {
+        deque->bottom--;
+        *job = deque->jobs[deque->bottom % deque->capacity];
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return found;
+}
+
+bool StealTop(ThreadPoolDeque *deque, ThreadPoolJob *job)
+{
+    pthread_mutex_lock(&deque->lock);
+    bool found = deque->bottom != deque->top;
+    if (found)
+    {
+        *job = deque->jobs[deque->top % deque->capacity];
+        deque->top++;
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return found;
+}
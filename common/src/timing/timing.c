@@ -0,0 +1,39 @@
+#include <time.h>
+#include <errno.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SPIN_PAUSE() _mm_pause()
+#else
+#define SPIN_PAUSE() ((void)0)
+#endif
+
+#include "timing/timing.h"
+
+double GetMonotonicTime()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + NS_TO_SEC(ts.tv_nsec);
+}
+
+void SleepUntil(double deadline, double spin_threshold)
+{
+    double sleep_until = deadline - spin_threshold;
+    if (GetMonotonicTime() < sleep_until)
+    {
+        // Absolute sleep, so an interrupted sleep resumes against the same deadline.
+        struct timespec wake_time = {
+            .tv_sec = (time_t)sleep_until,
+            .tv_nsec = (long)SEC_TO_NS(sleep_until - (time_t)sleep_until),
+        };
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake_time, NULL) == EINTR)
+        {
+        }
+    }
+
+    while (GetMonotonicTime() < deadline)
+    {
+        SPIN_PAUSE();
+    }
+}
@@ -3,35 +3,94 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stdatomic.h>
 #include <pthread.h>
 
 #include <audiosys/audiosys.h>
+#include <maths/random.h>
 
 #include "logger/logger.h"
 #include "display.h"
+#include "instruction.h"
+#include "keys.h"
+#include "jit.h"
+#include "trace.h"
+#include "profile.h"
+#include "rewind.h"
+#include "movie.h"
 
+// Address space of CHIP-8 and SUPER-CHIP.
 #define CH8_MEM_SIZE (4096)
+// Address space of XO-CHIP. 'CPUState.memory' is always this large; 'memory_size' is the part
+// the selected machine addresses.
+#define CH8_XO_MEM_SIZE (65536)
 #define CH8_VREG_COUNT (16)
 
 #define CH8_STACK_DEPTH (16)
 
 #define CH8_FONT_START_ADDRESS (0x50)
 #define CH8_FONT_SIZE (16 * 5)
+// SUPER-CHIP 8x10 digits, right after the small font.
+#define CH8_BIG_FONT_START_ADDRESS (CH8_FONT_START_ADDRESS + CH8_FONT_SIZE)
+#define CH8_BIG_FONT_SIZE (16 * 10)
 #define CH8_PROGRAM_START_ADDRESS (0x200)
 
+#define CH8_DECODE_CACHE_SIZE (CH8_XO_MEM_SIZE / 2)
+
+// XO-CHIP audio pattern: 128 1-bit samples, played at 4000 * 2^((pitch - 64) / 48) Hz.
+#define CH8_AUDIO_PATTERN_SIZE (16)
+#define CH8_AUDIO_PATTERN_SAMPLES (CH8_AUDIO_PATTERN_SIZE * 8)
+#define CH8_AUDIO_DEFAULT_PITCH (64)
+
 #define CH8_TIMER_FREQUENCY (60)
 
+// Longest the paced CPU thread sleeps between slices, in seconds.
+#define CH8_SCHEDULER_SLICE (0.002)
+// Backlog of timer ticks the paced CPU thread catches up on before dropping cycles.
+#define CH8_SCHEDULER_MAX_CATCH_UP_TICKS (6)
+
 #define SOUND_TIMER_SOUND_SLOT (0)
+#define AUDIO_PATTERN_SOUND_SLOT (1)
+#define CH8_SOUND_SLOT_COUNT (2)
+
+// Seed for callers that don't care about the CXNN sequence.
+#define CH8_DEFAULT_SEED (1)
+
+typedef enum CPUExecMode
+{
+    // Decoded-instruction interpreter. The reference implementation.
+    CPU_EXEC_INTERPRETER = 0,
+    // Basic-block recompiler. Only used by core_RunCPUUnthrottled.
+    CPU_EXEC_JIT = 1,
+    // Direct-threaded interpreter. Only available when built with CH8_THREADED_DISPATCH.
+    CPU_EXEC_THREADED = 2,
+} CPUExecMode;
+
+typedef enum CPUMachine
+{
+    // CHIP-8 with the SUPER-CHIP extensions. 4 KiB of memory, one monochrome plane.
+    CPU_MACHINE_CHIP8 = 0,
+    // XO-CHIP. 64 KiB of memory, two bit planes for four colors and a programmable audio pattern.
+    CPU_MACHINE_XOCHIP = 1,
+    CPU_MACHINE_COUNT,
+} CPUMachine;
 
 typedef struct CPUState
 {
     // Memory
-    uint8_t memory[CH8_MEM_SIZE];
+    uint8_t memory[CH8_XO_MEM_SIZE];
     size_t memory_size;
+    CPUMachine machine;
     size_t font_start_address;
+    size_t big_font_start_address;
+    // One entry per even address. Must be invalidated whenever 'memory' is written.
+    DecodedInstruction decode_cache[CH8_DECODE_CACHE_SIZE];
     // Peripherals
-    Display display;
+    // Keys seen by instructions. Only changes between instructions, through core_SetKeysCPU.
     uint16_t keys;
+    // Keys held on the host. Written by the input thread and latched into 'keys' by the paced
+    // CPU thread before every slice, so key changes land on a known cycle.
+    InputChannel input;
     // Stack
     uint16_t stack[CH8_STACK_DEPTH];
     uint16_t *stack_pointer;
@@ -39,24 +98,87 @@ typedef struct CPUState
     uint8_t variable_registers[CH8_VREG_COUNT];
     uint16_t program_counter;
     uint16_t index_register;
+    // CXNN's random number generator. Per CPU so instances don't share a sequence.
+    uint64_t random_seed;
+    RandomState random_state;
     // Timers
     uint8_t delay_timer;
-    pthread_t delay_timer_thread_id;
     uint8_t sound_timer;
-    pthread_t sound_timer_thread_id;
+    bool sound_playing;
+    // Slot 'sound_playing' refers to.
+    uint8_t sound_slot;
+    // XO-CHIP audio, loaded by F002 and FX3A. Set 'audio_pattern_dirty' to re-upload it.
+    uint8_t audio_pattern[CH8_AUDIO_PATTERN_SIZE];
+    uint8_t audio_pitch;
+    bool audio_pattern_dirty;
     // Clock
-    double timer_target_frequency;
-    double clock_target_frequency;
+    uint32_t clock_target_frequency;
     double (*pfn_get_time)();
+    uint64_t cycles;
+    uint64_t cycles_per_timer_tick;
+    uint64_t next_timer_tick_cycle;
     // Internal
     Logger *logger;
     pthread_t thread_id;
     bool running;
+    bool headless;
+    // Set while FX0A re-executes for lack of a key.
+    bool waiting_for_key;
+    // Set once the program overflows or underflows the stack. The faulting 2NNN or 00EE then
+    // re-executes without effect, so a broken ROM stalls instead of writing past 'stack'.
+    bool stack_fault;
+    CPUExecMode exec_mode;
+    JitContext *jit;
+    // Binary instruction trace. NULL when not tracing.
+    TraceWriter *trace;
+    // Timers as of the last trace record. Ticks happen between instructions, so the next
+    // record reports their effect against these rather than the values before its instruction.
+    uint8_t traced_delay_timer;
+    uint8_t traced_sound_timer;
+    // Set by a timer tick while tracing, flags the next record with CH8_TRACE_TIMER_TICK.
+    bool traced_timer_tick;
+    // Execution counters. NULL when not profiling.
+    CPUProfile *profile;
+    // Receives a frame after every timer tick. NULL when not recording.
+    RewindBuffer *rewind;
+    // Input recording or replay. NULL when neither.
+    Movie *movie;
     AudioContext *audio_context;
+    // Kept last: it is large and only touched by drawing, so it stays clear of the hot fields above.
+    Display display;
 } CPUState;
 
-CPUState *core_CreateCPU(uint8_t clock_target_freq, double (*pfn_get_time)(), LogLevel log_level);
+/// @brief Creates a CPU with audio and a log file, meant to be run in real time by core_StartCPU.
+/// @param clock_target_freq emulated instructions per second.
+/// @param seed seed of the CXNN random number generator.
+/// @param pfn_get_time wall-clock source in seconds. Only used for pacing.
+/// @param log_level level of 'cpu.log'.
+/// @return handle to the created CPU.
+CPUState *core_CreateCPU(uint32_t clock_target_freq, uint64_t seed, double (*pfn_get_time)(), LogLevel log_level);
+
+/// @brief Creates a CPU without an audio device, log file or wall-clock pacing.
+/// @details Meant for batch and regression runs driven by core_RunCPUUnthrottled.
+/// @param clock_target_freq emulated clock frequency. Only used to derive how many
+/// cycles pass between each 60 Hz timer tick.
+/// @param seed seed of the CXNN random number generator. Equal seeds and inputs give equal runs.
+/// @return handle to the created CPU.
+CPUState *core_CreateHeadlessCPU(uint32_t clock_target_freq, uint64_t seed);
+
+/// @brief Executes 'n_cycles' instructions on the caller's thread without sleeping.
+/// @details This is the scheduler. Delay and sound timers are decremented every
+/// 'cycles_per_timer_tick' cycles, so a run is reproducible regardless of host speed.
+/// FX0A never blocks; it re-executes until a key is set in 'keys' so timers keep running.
+/// Must not be called while the CPU is started.
+/// @param cpu CPU to run.
+/// @param n_cycles number of instructions to execute.
+/// @return number of instructions executed.
+uint64_t core_RunCPUUnthrottled(CPUState *cpu, uint64_t n_cycles);
 
+/// @brief Runs the CPU in real time on its own thread.
+/// @details The thread drives core_RunCPUUnthrottled with however many cycles are due by
+/// 'pfn_get_time', and sleeps in between. Timers and sound run on the same thread.
+/// While the program waits in FX0A with no timer running, the thread blocks on 'input'
+/// until a key is pressed and emulated time stands still.
 void core_StartCPU(CPUState *cpu);
 
 void core_StopCPU(CPUState *cpu);
@@ -65,4 +187,85 @@ void core_DestroyCPU(CPUState *cpu);
 
 void core_DumpMemoryCPU(CPUState *cpu);
 
+/// @brief Selects the machine 'cpu' emulates. Call before loading a program.
+/// @details XO-CHIP addresses 64 KiB, draws to the planes picked by FN01, loads I with F000 NNNN
+/// and plays the F002 audio pattern instead of the beep. Switching resets the display and audio
+/// pattern; memory is kept.
+/// @param cpu CPU to configure.
+/// @param machine machine to emulate.
+/// @return false if 'machine' is not a CPUMachine. The current machine is kept then.
+bool core_SetMachineCPU(CPUState *cpu, CPUMachine machine);
+
+/// @brief Returns the machine a ROM is meant for, going by its extension.
+/// @return CPU_MACHINE_XOCHIP for ".xo8" files, CPU_MACHINE_CHIP8 otherwise.
+CPUMachine core_GetMachineForROM(const char *filename);
+
+/// @brief Selects how core_RunCPUUnthrottled executes instructions.
+/// @details The JIT skips per-instruction debug logging and is only available on x86-64.
+/// It only compiles CHIP-8; XO-CHIP runs on the interpreter while the JIT is selected.
+/// The threaded interpreter runs the same handlers as the interpreter with per-handler dispatch.
+/// The interpreter stays the reference for differential testing.
+/// @param cpu CPU to configure.
+/// @param mode execution mode.
+/// @return false if 'mode' is unsupported on this host. The current mode is kept then.
+bool core_SetExecModeCPU(CPUState *cpu, CPUExecMode mode);
+
+/// @brief Records every executed instruction to 'trace' until set back to NULL.
+/// @details While tracing, core_RunCPUUnthrottled uses the interpreter regardless of the
+/// execution mode, as only it sees every instruction. The file header is written if 'trace'
+/// is empty, then one CPUTraceRecord per instruction. Timer ticks are reported on the record of
+/// the next instruction. The CPU does not take ownership of 'trace'.
+/// @param cpu CPU to trace.
+/// @param trace writer to record to, or NULL to stop tracing.
+void core_SetTraceCPU(CPUState *cpu, TraceWriter *trace);
+
+/// @brief Counts every executed instruction in 'profile' until set back to NULL.
+/// @details Like tracing, profiling makes core_RunCPUUnthrottled use the interpreter, as only
+/// it sees every instruction. Counters accumulate across calls until core_ResetProfile.
+/// The CPU does not take ownership of 'profile'.
+/// @param cpu CPU to profile.
+/// @param profile counters to add to, or NULL to stop profiling.
+void core_SetProfileCPU(CPUState *cpu, CPUProfile *profile);
+
+/// @brief Records a frame into 'rewind' after every 60 Hz timer tick until set back to NULL.
+/// @details Rewind with core_RewindCPU. The CPU does not take ownership of 'rewind'.
+/// @param cpu CPU to record.
+/// @param rewind buffer to record into, or NULL to stop recording.
+void core_SetRewindCPU(CPUState *cpu, RewindBuffer *rewind);
+
+/// @brief Sets the emulated keys from the next instruction on.
+/// @details Records the change if a movie is being recorded. Ignored while replaying a movie,
+/// as the movie drives the keys then. Must be called from the thread running the CPU.
+/// @param cpu CPU to update.
+/// @param keys bitmap of held keys, see CH8_IO_KEY0_BIT.
+void core_SetKeysCPU(CPUState *cpu, uint16_t keys);
+
+/// @brief Records input into, or replays input from, 'movie' until set back to NULL.
+/// @details A recorder starts with the current keys. Setting it back to NULL ends the recording
+/// at the current cycle. A replay must start from the state the recording did: same machine, clock
+/// frequency, seed, program and cycle. core_RunCPUUnthrottled then stops at every event, so
+/// keys change on the recorded cycles in every execution mode.
+/// The CPU does not take ownership of 'movie'.
+/// @param cpu CPU to record or replay.
+/// @param movie movie from core_CreateMovieRecorder or core_OpenMovie, or NULL to stop.
+/// @return false if 'movie' is a replay that doesn't match the CPU. Nothing is attached then.
+bool core_SetMovieCPU(CPUState *cpu, Movie *movie);
+
+/// @brief Loads a ROM at CH8_PROGRAM_START_ADDRESS and invalidates the decoded instructions it overwrites.
+/// @param cpu CPU to load into.
+/// @param filename ROM to load.
+/// @return end of memory range we loaded into.
+size_t core_LoadProgramCPU(CPUState *cpu, const char *filename);
+
+/// @brief Drops cached decoded instructions overlapping [address, address + size).
+/// @details Must be called after writing to 'cpu->memory' from outside the CPU.
+/// @param cpu CPU owning the cache.
+/// @param address first byte written.
+/// @param size number of bytes written.
+void core_InvalidateDecodedCPU(CPUState *cpu, uint16_t address, size_t size);
+
+/// @brief Drops every cached decoded instruction and compiled JIT block.
+/// @details Must be called after replacing the whole of 'cpu->memory' or changing the machine.
+void core_FlushDecodedCPU(CPUState *cpu);
+
 #endif
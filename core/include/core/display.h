@@ -2,23 +2,127 @@
 #define CORE_DISPLAY_H
 
 #include <stdint.h>
-#include <pthread.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdatomic.h>
 
-// 64 pixels width, 32 pixels height. 4 bytes per pixel.
+// 64 pixels width, 32 pixels height in lores, and 128 by 64 in SUPER-CHIP hires.
+// Stored at 1 bit per pixel per plane, expanded to 4 bytes per pixel at hires size for rendering.
 #define CH8_DISPLAY_WIDTH (64)
 #define CH8_DISPLAY_HEIGHT (32)
+#define CH8_DISPLAY_HIRES_WIDTH (128)
+#define CH8_DISPLAY_HIRES_HEIGHT (64)
+// 64-bit words per row. Lores rows only use the first; the second stays zero.
+#define CH8_DISPLAY_ROW_WORDS (CH8_DISPLAY_HIRES_WIDTH / 64)
+// Bit planes. CHIP-8 only draws to plane 0; XO-CHIP selects planes with FN01, and the two bits
+// of a pixel pick one of four colors.
+#define CH8_DISPLAY_PLANE_COUNT (2)
+#define CH8_DISPLAY_ALL_PLANES ((1 << CH8_DISPLAY_PLANE_COUNT) - 1)
+// Bytes of a plane in use at each resolution. Lores is one contiguous run of word 0s.
+#define CH8_DISPLAY_LORES_ROWS_SIZE (CH8_DISPLAY_HEIGHT * sizeof(uint64_t))
+#define CH8_DISPLAY_HIRES_ROWS_SIZE (CH8_DISPLAY_ROW_WORDS * CH8_DISPLAY_HIRES_HEIGHT * sizeof(uint64_t))
 #define CH8_INTERNAL_DISPLAY_CHANNELS (4)
-#define CH8_INTERNAL_DISPLAY_BUFFER_SIZE (CH8_DISPLAY_WIDTH * CH8_DISPLAY_HEIGHT * CH8_INTERNAL_DISPLAY_CHANNELS)
-#define CH8_DISPLAY_BUFFER_SIZE (CH8_DISPLAY_WIDTH * CH8_DISPLAY_HEIGHT)
+#define CH8_INTERNAL_DISPLAY_BUFFER_SIZE (CH8_DISPLAY_HIRES_WIDTH * CH8_DISPLAY_HIRES_HEIGHT * CH8_INTERNAL_DISPLAY_CHANNELS)
+#define CH8_DISPLAY_BUFFER_SIZE (CH8_DISPLAY_HIRES_WIDTH * CH8_DISPLAY_HIRES_HEIGHT)
+
+// 'Display.planes[p][w][y]' holds pixels [64w, 64w + 64) of row y in plane p. Words come first
+// so that lores screens take the first CH8_DISPLAY_HEIGHT words of a plane, as compact as a
+// 64-bit row layout.
+// Word and bit holding pixel 'x'. The most significant bit is the leftmost pixel, so a sprite
+// byte drawn at 'x' < 64 is '(uint64_t)byte << 56 >> x' in word 0.
+#define CH8_DISPLAY_PIXEL_WORD(x) ((x) / 64)
+#define CH8_DISPLAY_PIXEL_BIT(x) (0x8000000000000000ULL >> ((x) % 64))
+
+// Number of frames in the CPU to renderer handoff: one being written, one published, one being read.
+#define CH8_DISPLAY_FRAME_COUNT (3)
+// Set in 'Display.published_frame' while the renderer hasn't picked up the published frame.
+#define CH8_DISPLAY_FRAME_FRESH (0x80)
+#define CH8_DISPLAY_FRAME_INDEX_MASK (0x03)
+
+// A complete screen handed from the CPU to the renderer.
+typedef struct DisplayFrame
+{
+    // Only planes in 'plane_mask' are copied. The others hold stale data and read as blank.
+    uint64_t planes[CH8_DISPLAY_PLANE_COUNT][CH8_DISPLAY_ROW_WORDS][CH8_DISPLAY_HIRES_HEIGHT];
+    // Number of frames published up to and including this one. 0 is the blank initial screen.
+    uint64_t generation;
+    // Bit y is set if row y may differ from frame 'generation - 1'. Rows are in this frame's resolution.
+    uint64_t dirty_rows;
+    bool hires;
+    uint8_t plane_mask;
+} DisplayFrame;
 
 typedef struct Display
 {
-    pthread_mutex_t display_buffer_lock;
-    uint8_t display_buffer[CH8_INTERNAL_DISPLAY_BUFFER_SIZE];
+    // The canonical screen the CPU draws into. 1 bit per pixel per plane, rows past the current
+    // resolution are zero. Only ever touched by the CPU thread; the renderer reads published
+    // frames instead.
+    uint64_t planes[CH8_DISPLAY_PLANE_COUNT][CH8_DISPLAY_ROW_WORDS][CH8_DISPLAY_HIRES_HEIGHT];
+    // Bit y is set if row y was drawn to since the last core_PublishDisplay.
+    uint64_t dirty_rows;
+    // SUPER-CHIP 128x64 mode. Switching clears the screen.
+    bool hires;
+    // Planes drawn to, cleared and scrolled by the CPU. XO-CHIP FN01; always plane 0 on CHIP-8.
+    uint8_t selected_planes;
+    // Planes that have been selected since the screen was last reset. Planes outside it are
+    // blank, so publishing and rendering a CHIP-8 screen only ever touches plane 0.
+    uint8_t plane_mask;
+    // Generation of the last published frame. CPU thread only.
+    uint64_t generation;
+    // Triple buffer. Each side owns one frame exclusively and swaps it with the published one,
+    // so neither the CPU nor the renderer ever waits on the other.
+    DisplayFrame frames[CH8_DISPLAY_FRAME_COUNT];
+    // Frame the CPU copies into on publish. CPU thread only.
+    uint8_t back_frame;
+    // Index of the latest published frame, ORed with CH8_DISPLAY_FRAME_FRESH until acquired.
+    _Atomic uint8_t published_frame;
+    // Frame the renderer reads from. Renderer thread only.
+    uint8_t front_frame;
+    // Size in bytes of the RGBA expansion produced by core_ExpandDisplayRGBA. Always hires-sized.
     size_t display_buffer_size;
     size_t display_buffer_width;
     size_t display_buffer_height;
     size_t display_buffer_channels;
 } Display;
 
+/// @brief Clears the screen and every frame of the handoff.
+void core_InitializeDisplay(Display *display);
+
+/// @brief Hands a copy of 'display->planes' to the renderer as the next generation. CPU thread only.
+/// @details Never blocks. A published frame the renderer hasn't acquired yet is replaced,
+/// so consumers may see gaps in 'generation'.
+void core_PublishDisplay(Display *display);
+
+/// @brief Returns the latest frame published by the CPU. Renderer thread only.
+/// @details Never blocks. The frame stays valid and unchanged until the next call.
+/// @param display display to read from.
+/// @param is_new set to whether a frame was published since the last call. May be NULL.
+/// @return latest complete frame.
+const DisplayFrame *core_AcquireDisplayFrame(Display *display, bool *is_new);
+
+/// @brief Returns the RGBA rows that differ from the last frame a consumer handled.
+/// @details The frame's own dirty mask is used when it directly follows 'seen'. Otherwise
+/// frames were skipped and 'seen' is compared row by row. 'seen' is then updated to 'frame'.
+/// @param frame frame returned by core_AcquireDisplayFrame.
+/// @param seen copy of the last handled frame. Start zeroed.
+/// @return bit y set for every hires row of the RGBA expansion to redraw. 0 if nothing changed.
+uint64_t core_TakeDisplayFrameChanges(const DisplayFrame *frame, DisplayFrame *seen);
+
+/// @brief Expands a screen to hires-sized RGBA8 with opaque alpha.
+/// @details Plane 0 alone is white, plane 1 alone orange, both brown, neither black, so a CHIP-8
+/// screen is white on black. Lores pixels become 2x2 blocks. Planes are combined with SSE2
+/// where available. Only needed by the renderer and image export; the CPU never touches RGBA.
+/// @param planes screen to expand, such as 'Display.planes' or 'DisplayFrame.planes'.
+/// @param plane_mask planes to read. Others are taken as blank.
+/// @param hires whether 'planes' holds a hires screen.
+/// @param rgba destination of CH8_INTERNAL_DISPLAY_BUFFER_SIZE bytes.
+void core_ExpandDisplayRGBA(const uint64_t planes[][CH8_DISPLAY_ROW_WORDS][CH8_DISPLAY_HIRES_HEIGHT],
+                            uint8_t plane_mask, bool hires, uint8_t *rgba);
+
+/// @brief Same as core_ExpandDisplayRGBA, but only for RGBA rows [first_row, first_row + row_count).
+/// @details Rows are hires rows in either mode. 'rgba' still points at the whole screen.
+/// Other rows are left untouched.
+void core_ExpandDisplayRowsRGBA(const uint64_t planes[][CH8_DISPLAY_ROW_WORDS][CH8_DISPLAY_HIRES_HEIGHT],
+                                uint8_t plane_mask, bool hires, size_t first_row, size_t row_count, uint8_t *rgba);
+
 #endif
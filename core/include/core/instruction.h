@@ -0,0 +1,93 @@
+#ifndef CORE_INSTRUCTION_H
+#define CORE_INSTRUCTION_H
+
+#include <stdint.h>
+
+typedef struct CPUState CPUState;
+typedef struct DecodedInstruction DecodedInstruction;
+
+typedef enum InstructionOp
+{
+    // Not decoded yet. Decodes the instruction in place on first execution.
+    OP_DECODE = 0,
+    OP_00E0,
+    OP_00EE,
+    // SUPER-CHIP scrolling and resolution switches.
+    OP_00CN,
+    OP_00FB,
+    OP_00FC,
+    OP_00FE,
+    OP_00FF,
+    OP_0NNN,
+    OP_1NNN,
+    OP_2NNN,
+    OP_3XNN,
+    OP_4XNN,
+    OP_5XY0,
+    OP_6XNN,
+    OP_7XNN,
+    OP_8XY0,
+    OP_8XY1,
+    OP_8XY2,
+    OP_8XY3,
+    OP_8XY4,
+    OP_8XY5,
+    OP_8XY6,
+    OP_8XY7,
+    OP_8XYE,
+    OP_9XY0,
+    OP_ANNN,
+    OP_BNNN,
+    OP_CXNN,
+    OP_DXYN,
+    OP_EX9E,
+    OP_EXA1,
+    // XO-CHIP long I load, plane select and audio pattern.
+    OP_F000,
+    OP_FN01,
+    OP_F002,
+    OP_FX07,
+    OP_FX0A,
+    OP_FX15,
+    OP_FX18,
+    OP_FX1E,
+    OP_FX29,
+    OP_FX30,
+    OP_FX33,
+    OP_FX3A,
+    OP_FX55,
+    OP_FX65,
+    OP_NOT_IMPLEMENTED,
+    OP_COUNT,
+} InstructionOp;
+
+// Executes a decoded instruction. PC already points at the next instruction when called.
+typedef void (*InstructionHandler)(CPUState *cpu, const DecodedInstruction *instruction);
+
+// An instruction decoded once and cached per even address in CPUState.decode_cache.
+// All operand fields are extracted up front so handlers never touch the raw opcode.
+struct DecodedInstruction
+{
+    InstructionHandler handler;
+    // Index of 'handler'. Used by dispatchers that jump rather than call.
+    uint8_t op;
+    uint16_t opcode;
+    // 12-bit immediate address.
+    uint16_t nnn;
+    // 4-bit register indices.
+    uint8_t x;
+    uint8_t y;
+    // 4-bit and 8-bit immediate values.
+    uint8_t n;
+    uint8_t nn;
+};
+
+/// @brief Decodes a raw opcode into 'instruction'.
+/// @param opcode big-endian opcode as read from memory.
+/// @param instruction decoded instruction to populate.
+void core_DecodeInstruction(uint16_t opcode, DecodedInstruction *instruction);
+
+/// @brief Returns the opcode pattern of 'op', such as "8XY4".
+const char *core_GetInstructionOpName(InstructionOp op);
+
+#endif
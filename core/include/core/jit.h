@@ -0,0 +1,78 @@
+#ifndef CORE_JIT_H
+#define CORE_JIT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct CPUState CPUState;
+
+// Size of the executable code buffer. The whole cache is flushed when it runs full.
+#define CH8_JIT_CODE_BUFFER_SIZE (1024 * 1024)
+// Longest straight-line run of instructions compiled into a single block.
+#define CH8_JIT_MAX_BLOCK_INSTRUCTIONS (64)
+// A block invalidated this many times is left to the interpreter until the next flush.
+// Recompiling self-modifying code on every write costs far more than interpreting it.
+#define CH8_JIT_MAX_INVALIDATIONS (8)
+
+// Native code for a straight-line run of instructions starting at 'start_address'.
+// A block always runs to completion and leaves PC at the next instruction to execute.
+typedef struct JitBlock
+{
+    void (*code)(CPUState *cpu);
+    uint16_t start_address;
+    // First address after the last instruction in the block.
+    uint16_t end_address;
+    // Number of instructions, and so emulated cycles, executed by one run of the block.
+    uint32_t cycles;
+    // Block is a single jump to itself. Running it any number of times changes nothing but cycles.
+    bool idle_loop;
+    // Number of times code starting at this address has been invalidated.
+    uint8_t invalidations;
+} JitBlock;
+
+typedef struct JitContext
+{
+    uint8_t *code_buffer;
+    size_t code_buffer_size;
+    size_t code_buffer_used;
+    // Blocks indexed by start address / 2. 'code' is NULL if not compiled.
+    JitBlock *blocks;
+    size_t blocks_count;
+    // Non-zero for every 64-byte page of emulated memory that compiled code was read from.
+    uint8_t *code_pages;
+    size_t code_pages_count;
+    // Statistics.
+    uint64_t blocks_compiled;
+    uint64_t blocks_invalidated;
+    uint64_t flushes;
+} JitContext;
+
+/// @brief Checks whether the JIT can run on this host.
+/// @return true on x86-64 POSIX hosts.
+bool jit_IsSupported();
+
+/// @brief Creates a JIT context with an empty block cache for 'memory_size' bytes of emulated memory.
+/// @return handle to context, or NULL if the JIT is unsupported or the code buffer can't be mapped.
+JitContext *jit_CreateContext(size_t memory_size);
+
+/// @brief Unmaps the code buffer and frees the context.
+void jit_DestroyContext(JitContext *ctx);
+
+/// @brief Runs the block starting at the current PC, compiling it first if needed.
+/// @details Nothing is executed if PC is odd or the block is longer than 'max_cycles',
+/// so the caller can fall back to the interpreter and stay cycle exact.
+/// Idle loops (a jump to itself) consume all of 'max_cycles' at once.
+/// @param ctx JIT context owned by 'cpu'.
+/// @param cpu CPU to run.
+/// @param max_cycles upper bound of cycles to execute.
+/// @return number of cycles executed. 0 if the caller must interpret the next instruction.
+uint32_t jit_RunBlock(JitContext *ctx, CPUState *cpu, uint64_t max_cycles);
+
+/// @brief Drops every block overlapping [address, address + size).
+void jit_Invalidate(JitContext *ctx, uint16_t address, size_t size);
+
+/// @brief Drops every block and resets the code buffer.
+void jit_Flush(JitContext *ctx);
+
+#endif
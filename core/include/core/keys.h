@@ -2,6 +2,9 @@
 #define CORE_KEYS_H
 
 #include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
 
 #define CH8_IO_KEY0_BIT  (0x1 << 0)
 #define CH8_IO_KEY1_BIT  (0x1 << 1)
@@ -20,7 +23,59 @@
 #define CH8_IO_KEYE_BIT  (0x1 << 14)
 #define CH8_IO_KEYF_BIT  (0x1 << 15)
 
+// Must be a power of two.
+#define CH8_INPUT_EDGE_CAPACITY 64
+
+// Keys held on the host, handed from a single input thread to the CPU thread.
+// The CPU thread can block on it until a key changes, instead of polling.
+typedef struct InputChannel
+{
+    // Every key currently held. Updated with atomic OR / AND-NOT, so chords are kept.
+    _Atomic uint16_t keys;
+    // Queue of key states, one per press or release, so presses shorter than the CPU's
+    // polling interval are still seen. Written by the input thread, read by the CPU thread.
+    uint16_t edges[CH8_INPUT_EDGE_CAPACITY];
+    _Atomic uint32_t edge_head;
+    _Atomic uint32_t edge_tail;
+    // Threads inside core_WaitInputChannel. Key updates only take 'lock' when non-zero.
+    _Atomic uint32_t waiters;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    // Set by core_InterruptInputChannel to release waiters for good. Guarded by 'lock'.
+    bool interrupted;
+} InputChannel;
+
+void core_InitializeInputChannel(InputChannel *input);
+
+void core_DestroyInputChannel(InputChannel *input);
+
+/// @brief Marks 'key_bit' as held, along with any other held keys. Input thread only.
+void core_PressInputKey(InputChannel *input, uint16_t key_bit);
+
+/// @brief Marks 'key_bit' as no longer held. Input thread only.
+void core_ReleaseInputKey(InputChannel *input, uint16_t key_bit);
+
+/// @brief Returns the keys currently held. Never blocks.
+uint16_t core_GetInputKeys(InputChannel *input);
+
+/// @brief Returns the key state after the oldest queued edge, or the held keys if none is queued.
+/// @details Applying one edge at a time lets a press and release between two polls both be seen.
+/// Falls back to the held keys if edges were dropped because the queue was full. CPU thread only.
+uint16_t core_PollInputKeys(InputChannel *input);
+
+/// @brief Blocks until an edge is queued, the held keys differ from 'keys' or the channel is
+/// interrupted.
+/// @details Returns straight away if any is already the case.
+void core_WaitInputChannel(InputChannel *input, uint16_t keys);
+
+/// @brief Releases every current and future waiter until core_ResumeInputChannel.
+void core_InterruptInputChannel(InputChannel *input);
+
+/// @brief Lets core_WaitInputChannel block again after core_InterruptInputChannel.
+void core_ResumeInputChannel(InputChannel *input);
+
 uint16_t MapKeyBit(uint8_t key);
-uint8_t MapBitKey(uint16_t bit);
+/// @brief Returns the lowest key set in 'bits', or 0xFF if none is.
+uint8_t MapBitKey(uint16_t bits);
 
 #endif
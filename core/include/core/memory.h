@@ -9,4 +9,9 @@
     ((idx) += 2, \
      (uint16_t)(((mem_ptr)[(idx) - 2] << 8) | (mem_ptr)[(idx) - 1]))
 
+// Reads the big-endian word at 'address' without side effects. Both bytes are masked with
+// 'mask', the memory size - 1, so a word at the last address ends at address 0.
+#define PEEK_16BIT(mem_ptr, address, mask) \
+    ((uint16_t)(((mem_ptr)[(address) & (mask)] << 8) | (mem_ptr)[((address) + 1) & (mask)]))
+
 #endif
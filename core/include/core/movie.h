@@ -0,0 +1,73 @@
+#ifndef CORE_MOVIE_H
+#define CORE_MOVIE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define CH8_MOVIE_MAGIC "CH8M"
+#define CH8_MOVIE_VERSION (2)
+#define CH8_MOVIE_HEADER_SIZE (4 + 2 + 1 + 4 + 8 + 8 + 8)
+#define CH8_MOVIE_EVENT_SIZE (8 + 2)
+
+typedef struct CPUState CPUState;
+
+// File layout, all little-endian:
+//   header: "CH8M", u16 version, u8 machine, u32 clock frequency, u64 seed, u64 program hash,
+//           u64 start cycle
+//   events: u64 cycle, u16 keys
+// Each event sets the emulated keys before the instruction at 'cycle' executes. Events are in
+// cycle order. The last event marks the end of the recording.
+typedef struct MovieHeader
+{
+    // CPUMachine the program ran on.
+    uint8_t machine;
+    uint32_t clock_frequency;
+    uint64_t seed;
+    // FNV-1a of memory from CH8_PROGRAM_START_ADDRESS up, when recording started.
+    uint64_t program_hash;
+    uint64_t start_cycle;
+} MovieHeader;
+
+typedef struct Movie
+{
+    FILE *file;
+    bool recording;
+    MovieHeader header;
+    // Replay: next event to apply. 'next_cycle' is UINT64_MAX once all are applied.
+    uint64_t next_cycle;
+    uint16_t next_keys;
+    // Replay: cycle of the last event.
+    uint64_t end_cycle;
+    // Recording: last keys written, to skip events that change nothing.
+    uint16_t recorded_keys;
+} Movie;
+
+/// @brief Creates 'filename' to record the input of 'cpu' into.
+/// @details Stores what a replay needs to match: machine, clock frequency, seed, loaded program and cycle.
+/// Attach with core_SetMovieCPU before the CPU runs on.
+/// @return handle to the movie, or NULL if the file can't be created.
+Movie *core_CreateMovieRecorder(const char *filename, const CPUState *cpu);
+
+/// @brief Opens a recorded movie for replay.
+/// @details Create the CPU from the header's clock frequency and seed, select its machine, and
+/// load the same program.
+/// @return handle to the movie, or NULL if 'filename' is not a movie of a supported version.
+Movie *core_OpenMovie(const char *filename);
+
+void core_DestroyMovie(Movie *movie);
+
+/// @brief Hashes the program area of 'cpu', as stored in MovieHeader.program_hash.
+uint64_t core_HashProgramMovie(const CPUState *cpu);
+
+/// @brief Hashes the screen of 'cpu', every plane at hires size.
+/// @details The framebuffer hash printed by ch8-batch and ch8-replay, so their runs can be compared.
+uint64_t core_HashDisplayCPU(const CPUState *cpu);
+
+/// @brief Reads the next event into 'next_cycle' and 'next_keys'. Used by the CPU during replay.
+void core_AdvanceMovie(Movie *movie);
+
+/// @brief Appends an event. Used by the CPU while recording.
+void core_WriteMovieEvent(Movie *movie, uint64_t cycle, uint16_t keys);
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef CORE_PROFILE_H
+#define CORE_PROFILE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "instruction.h"
+
+// One slot per even address of the 64 KiB XO-CHIP address space.
+#define CH8_PROFILE_ADDRESS_SLOTS (65536 / 2)
+
+typedef struct CPUState CPUState;
+
+// Execution counts gathered by CycleCPU while profiling. Every instruction is one emulated
+// cycle, so counts are also the cycles spent per opcode and per address.
+typedef struct CPUProfile
+{
+    uint64_t instructions;
+    uint64_t op_counts[OP_COUNT];
+    // Indexed by PC >> 1. Instructions at odd addresses count toward the even address below.
+    uint64_t address_counts[CH8_PROFILE_ADDRESS_SLOTS];
+} CPUProfile;
+
+typedef struct ProfileHotAddress
+{
+    uint16_t address;
+    // Opcode at 'address' when the addresses were collected.
+    uint16_t opcode;
+    InstructionOp op;
+    uint64_t count;
+} ProfileHotAddress;
+
+/// @brief Zeroes every counter.
+void core_ResetProfile(CPUProfile *profile);
+
+/// @brief Finds the most executed addresses.
+/// @param profile profile to read.
+/// @param cpu CPU the profile was gathered on. Only used to read the opcode at each address.
+/// @param hot addresses in descending order of count, ties by ascending address.
+/// @param max_hot capacity of 'hot'.
+/// @return number of addresses written to 'hot'.
+size_t core_GetProfileHotAddresses(const CPUProfile *profile, const CPUState *cpu, ProfileHotAddress *hot, size_t max_hot);
+
+/// @brief Prints the opcode mix and the 'top_n' hottest addresses.
+void core_PrintProfile(const CPUProfile *profile, const CPUState *cpu, size_t top_n, FILE *out);
+
+#endif
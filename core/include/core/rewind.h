@@ -0,0 +1,80 @@
+#ifndef CORE_REWIND_H
+#define CORE_REWIND_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "state.h"
+
+// Frames between keyframes. Seeking decodes at most one keyframe and one delta.
+#define CH8_REWIND_DEFAULT_KEYFRAME_INTERVAL (60)
+// Five minutes at 60 fps.
+#define CH8_REWIND_DEFAULT_FRAMES (5 * 60 * 60)
+#define CH8_REWIND_DEFAULT_BUFFER_SIZE (4 * 1024 * 1024)
+// Largest encoded frame. Runs are only split on 8 or more equal bytes, so a run header
+// never costs more than the bytes it skips.
+#define CH8_REWIND_MAX_RECORD_SIZE (CH8_STATE_SIZE + 8)
+
+typedef struct RewindEntry
+{
+    uint32_t offset;
+    uint32_t size;
+    // Size of the decoded state. Depends on the machine.
+    uint32_t state_size;
+    // Entries back to the keyframe this frame is a delta against. 0 for keyframes.
+    uint32_t keyframe_distance;
+} RewindEntry;
+
+// Ring of per-frame save states. Keyframes are stored as deltas against an all-zero state,
+// other frames as deltas against their keyframe, so unchanged memory and display rows cost
+// nothing. A delta is a list of runs: u32 bytes skipped, u32 length, then 'length' bytes of
+// the state XOR its base. When the buffer fills up, the oldest keyframe and its deltas go.
+typedef struct RewindBuffer
+{
+    uint8_t *data;
+    size_t data_size;
+    // Where the next frame is written.
+    size_t head;
+    // Ring of frames, oldest first.
+    RewindEntry *entries;
+    size_t max_entries;
+    size_t first_entry;
+    size_t entries_count;
+    uint32_t keyframe_interval;
+    // Distance the next frame would have to the current keyframe.
+    uint32_t frames_since_keyframe;
+    // Decoded current keyframe, the base of new deltas.
+    uint8_t keyframe_state[CH8_STATE_SIZE];
+    size_t keyframe_state_size;
+    // Scratch state for saving and seeking.
+    uint8_t state[CH8_STATE_SIZE];
+    // Keyframe decoded while seeking. Only becomes 'keyframe_state' once the seek succeeds.
+    uint8_t seek_keyframe_state[CH8_STATE_SIZE];
+} RewindBuffer;
+
+/// @brief Creates an empty rewind buffer.
+/// @param buffer_size bytes of encoded frames to keep. At least CH8_REWIND_MAX_RECORD_SIZE.
+/// @param max_frames frames to keep at most, whatever their size.
+/// @param keyframe_interval frames between keyframes.
+/// @return handle to the buffer, or NULL if 'buffer_size' can't hold a frame.
+RewindBuffer *core_CreateRewindBuffer(size_t buffer_size, size_t max_frames, uint32_t keyframe_interval);
+
+void core_DestroyRewindBuffer(RewindBuffer *rewind);
+
+/// @brief Appends the current state of 'cpu' as the newest frame. Never allocates.
+void core_PushRewindFrame(RewindBuffer *rewind, const CPUState *cpu);
+
+/// @brief Number of frames that can be rewound to.
+size_t core_GetRewindFrameCount(const RewindBuffer *rewind);
+
+/// @brief Restores 'cpu' to 'frames' frames before the newest and drops every newer frame.
+/// @details Takes the same time regardless of distance: one keyframe and one delta are decoded.
+/// Must not be called while the CPU is started.
+/// @param rewind buffer to rewind through.
+/// @param cpu CPU to restore.
+/// @param frames 0 restores the newest frame. Clamped to the oldest frame.
+/// @return false if the buffer is empty or the frame could not be restored.
+bool core_RewindCPU(RewindBuffer *rewind, CPUState *cpu, size_t frames);
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef CORE_STATE_H
+#define CORE_STATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define CH8_STATE_MAGIC "CH8S"
+#define CH8_STATE_VERSION (4)
+
+// Size of a version 4 state without its memory.
+#define CH8_STATE_FIXED_SIZE (6 + 1 + 16 + 2 + 2 + 32 + 1 + 2 + 4 + 8 + 8 + 8 + 32 + 1 + 1 + 1 + 2 * 64 * 2 * 8 + 16 + 1)
+// Size of a state of a machine addressing 'memory_size' bytes. Only addressable memory is saved,
+// so a CHIP-8 or SUPER-CHIP state takes 6286 bytes and an XO-CHIP state 67726.
+#define CH8_STATE_SIZE_FOR_MEMORY(memory_size) (CH8_STATE_FIXED_SIZE + (memory_size))
+// Largest state, that of XO-CHIP. A buffer of this size holds a state of any machine.
+#define CH8_STATE_SIZE CH8_STATE_SIZE_FOR_MEMORY(65536)
+
+typedef struct CPUState CPUState;
+
+// File layout, all little-endian:
+//   header: "CH8S", u16 version
+//   machine: u8 CPUMachine
+//   memory: 4096 bytes, or 65536 on XO-CHIP
+//   registers: u8 V0-VF, u16 PC, u16 I
+//   stack: u16 x 16, u8 depth
+//   timers: u8 delay, u8 sound
+//   clock: u32 target frequency, u64 cycles per timer tick, u64 cycle, u64 next timer tick cycle
+//   random: u64 x 4 xoshiro256** state
+//   display: u8 hires, u8 selected planes, u8 plane mask, u64 x 2 planes x 64 rows x 2 words
+//   audio: 16 bytes pattern, u8 pitch
+// Host state such as threads, the logger, audio, tracing and the execution mode is not saved.
+
+/// @brief Serializes the emulated state of 'cpu' into 'buffer' without allocating.
+/// @details Must not be called while the CPU is started.
+/// @param cpu CPU to save.
+/// @param buffer destination of CH8_STATE_SIZE bytes, or CH8_STATE_SIZE_FOR_MEMORY(cpu->memory_size).
+/// @param buffer_size size of 'buffer'.
+/// @return bytes written, or 0 if 'buffer' is too small.
+size_t core_SaveState(const CPUState *cpu, uint8_t *buffer, size_t buffer_size);
+
+/// @brief Restores state saved by core_SaveState.
+/// @details Every decoded instruction and JIT block is dropped. The display is published, so
+/// the renderer shows the restored screen. Must not be called while the CPU is started.
+/// @param cpu CPU to restore into.
+/// @param buffer saved state.
+/// @param buffer_size size of 'buffer'.
+/// @return false if 'buffer' is not a valid state of a supported version. 'cpu' is untouched then.
+bool core_LoadState(CPUState *cpu, const uint8_t *buffer, size_t buffer_size);
+
+#endif
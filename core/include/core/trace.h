@@ -0,0 +1,65 @@
+#ifndef CORE_TRACE_H
+#define CORE_TRACE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "logger/trace.h"
+
+#define CH8_TRACE_MAGIC "CH8T"
+#define CH8_TRACE_VERSION (2)
+
+// Bits of CPUTraceRecord.changed. Bits 0-15 flag V0-VF.
+#define CH8_TRACE_CHANGED_VREGS (0xFFFFu)
+#define CH8_TRACE_CHANGED_I (1u << 16)
+#define CH8_TRACE_CHANGED_DELAY_TIMER (1u << 17)
+#define CH8_TRACE_CHANGED_SOUND_TIMER (1u << 18)
+#define CH8_TRACE_CHANGED_STACK (1u << 19)
+// The timers ticked since the previous record. Carries no value: DT and ST are compared with
+// the previous record, so any decrement by the tick is already flagged above.
+#define CH8_TRACE_TIMER_TICK (1u << 20)
+
+// Size of the fixed part of a record in the file: cycle, address, opcode and changed mask.
+#define CH8_TRACE_RECORD_HEADER_SIZE (12)
+// Largest record in the file: header, 16 registers, I, both timers and stack depth.
+#define CH8_TRACE_RECORD_MAX_SIZE (CH8_TRACE_RECORD_HEADER_SIZE + 16 + 2 + 3)
+
+// File layout, all little-endian:
+//   header: "CH8T", u16 version
+//   records: u32 cycle, u16 address, u16 opcode, u32 changed,
+//            then the new value of every flagged field in bit order:
+//            u8 per V register, u16 I, u8 delay timer, u8 sound timer, u8 stack depth.
+// The cycle is truncated to 32 bits; readers unwrap it by assuming it only increases.
+typedef struct CPUTraceRecord
+{
+    uint64_t cycle;
+    uint16_t address;
+    uint16_t opcode;
+    uint32_t changed;
+    // New values after the instruction, and for the timers after any tick before it.
+    // Only fields flagged in 'changed' are valid.
+    uint8_t variable_registers[16];
+    uint16_t index_register;
+    uint8_t delay_timer;
+    uint8_t sound_timer;
+    uint8_t stack_depth;
+} CPUTraceRecord;
+
+/// @brief Appends the file header to an empty trace.
+void core_WriteTraceHeader(TraceWriter *writer);
+
+/// @brief Appends 'record' to the trace, encoding only the fields flagged in 'changed'.
+void core_WriteTraceRecord(TraceWriter *writer, const CPUTraceRecord *record);
+
+/// @brief Reads and validates the file header.
+/// @return false if 'file_pointer' is not a trace of a supported version.
+bool core_ReadTraceHeader(FILE *file_pointer);
+
+/// @brief Reads the next record.
+/// @param file_pointer trace positioned after the header or a previous record.
+/// @param record decoded record. 'cycle' is unwrapped using its previous value, so reuse the same record.
+/// @return false at end of file or on a truncated record.
+bool core_ReadTraceRecord(FILE *file_pointer, CPUTraceRecord *record);
+
+#endif
@@ -3,6 +3,8 @@
 #include <signal.h>
 #include <assert.h>
 #include <stdbool.h>
+#include <math.h>
+#include <strings.h>
 
 #include "core/cpu.h"
 #include "core/memory.h"
@@ -29,70 +31,239 @@ static uint8_t font_data[CH8_FONT_SIZE] = {
     0xF0, 0x80, 0xF0, 0x80, 0x80  // F
 };
 
+// SUPER-CHIP has digits 0-9 only. A-F follow the XO-CHIP font.
+static uint8_t big_font_data[CH8_BIG_FONT_SIZE] = {
+    0x3C, 0x7E, 0xE7, 0xC3, 0xC3, 0xC3, 0xC3, 0xE7, 0x7E, 0x3C, // 0
+    0x18, 0x38, 0x58, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x3C, // 1
+    0x3E, 0x7F, 0xC3, 0x06, 0x0C, 0x18, 0x30, 0x60, 0xFF, 0xFF, // 2
+    0x3C, 0x7E, 0xC3, 0x03, 0x0E, 0x0E, 0x03, 0xC3, 0x7E, 0x3C, // 3
+    0x06, 0x0E, 0x1E, 0x36, 0x66, 0xC6, 0xFF, 0xFF, 0x06, 0x06, // 4
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFC, 0xFE, 0x03, 0xC3, 0x7E, 0x3C, // 5
+    0x3E, 0x7C, 0xE0, 0xC0, 0xFC, 0xFE, 0xC3, 0xC3, 0x7E, 0x3C, // 6
+    0xFF, 0xFF, 0x03, 0x06, 0x0C, 0x18, 0x30, 0x60, 0x60, 0x60, // 7
+    0x3C, 0x7E, 0xC3, 0xC3, 0x7E, 0x7E, 0xC3, 0xC3, 0x7E, 0x3C, // 8
+    0x3C, 0x7E, 0xC3, 0xC3, 0x7F, 0x3F, 0x03, 0x03, 0x3E, 0x7C, // 9
+    0x7E, 0xFF, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3, // A
+    0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, // B
+    0x3C, 0xFF, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0xFF, 0x3C, // C
+    0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC, // D
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // E
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xC0, 0xC0  // F
+};
+
+// XO-CHIP plays this square wave until a program loads its own pattern with F002.
+static const uint8_t default_audio_pattern[CH8_AUDIO_PATTERN_SIZE] = {
+    0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0,
+    0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0
+};
+
+static void InitializeCPU(CPUState *cpu, uint32_t clock_target_freq, uint64_t seed);
+static void TickTimers(CPUState *cpu);
+static void UpdateSound(CPUState *cpu);
+static void UploadAudioPattern(CPUState *cpu);
 static void *RunCPU(void *vargp);
-static void *RunDelayTimer(void *vargp);
-static void *RunSoundTimer(void *vargp);
 static void CycleCPU(CPUState *cpu);
-// Returns true if any pixels were turned off.
-static bool SetPixel(CPUState *cpu, uint8_t x, uint8_t y, uint8_t pixel_value);
-static bool SetPixels(CPUState *cpu, uint8_t x, uint8_t y, uint8_t pixels);
-static void SetAlpha(CPUState *cpu, uint8_t x, uint8_t y, uint8_t alpha_value);
+static void ExecuteNextCPU(CPUState *cpu);
+static void TraceCycleCPU(CPUState *cpu);
+static void ProfileInstruction(CPUState *cpu);
+static void ReplayMovie(CPUState *cpu);
+static bool CanIdleCPU(CPUState *cpu);
+static void LatchKeysCPU(CPUState *cpu, uint64_t *next_input_cycle);
+#ifdef CH8_THREADED_DISPATCH
+static void RunThreaded(CPUState *cpu, uint64_t n_cycles);
+#endif
+static void DecodeAndExecute(CPUState *cpu, const DecodedInstruction *instruction);
+static void InvalidateDecoded(CPUState *cpu, uint16_t address, size_t size);
+static void SetDisplayHires(CPUState *cpu, bool hires);
+static void SkipNextInstruction(CPUState *cpu);
+// Instruction handlers. See README.md for the opcode table.
+static void Op00E0(CPUState *cpu, const DecodedInstruction *instruction);
+static void Op00EE(CPUState *cpu, const DecodedInstruction *instruction);
+static void Op00CN(CPUState *cpu, const DecodedInstruction *instruction);
+static void Op00FB(CPUState *cpu, const DecodedInstruction *instruction);
+static void Op00FC(CPUState *cpu, const DecodedInstruction *instruction);
+static void Op00FE(CPUState *cpu, const DecodedInstruction *instruction);
+static void Op00FF(CPUState *cpu, const DecodedInstruction *instruction);
+static void Op0NNN(CPUState *cpu, const DecodedInstruction *instruction);
+static void Op1NNN(CPUState *cpu, const DecodedInstruction *instruction);
+static void Op2NNN(CPUState *cpu, const DecodedInstruction *instruction);
+static void Op3XNN(CPUState *cpu, const DecodedInstruction *instruction);
+static void Op4XNN(CPUState *cpu, const DecodedInstruction *instruction);
+static void Op5XY0(CPUState *cpu, const DecodedInstruction *instruction);
+static void Op6XNN(CPUState *cpu, const DecodedInstruction *instruction);
+static void Op7XNN(CPUState *cpu, const DecodedInstruction *instruction);
+static void Op8XY0(CPUState *cpu, const DecodedInstruction *instruction);
+static void Op8XY1(CPUState *cpu, const DecodedInstruction *instruction);
+static void Op8XY2(CPUState *cpu, const DecodedInstruction *instruction);
+static void Op8XY3(CPUState *cpu, const DecodedInstruction *instruction);
+static void Op8XY4(CPUState *cpu, const DecodedInstruction *instruction);
+static void Op8XY5(CPUState *cpu, const DecodedInstruction *instruction);
+static void Op8XY6(CPUState *cpu, const DecodedInstruction *instruction);
+static void Op8XY7(CPUState *cpu, const DecodedInstruction *instruction);
+static void Op8XYE(CPUState *cpu, const DecodedInstruction *instruction);
+static void Op9XY0(CPUState *cpu, const DecodedInstruction *instruction);
+static void OpANNN(CPUState *cpu, const DecodedInstruction *instruction);
+static void OpBNNN(CPUState *cpu, const DecodedInstruction *instruction);
+static void OpCXNN(CPUState *cpu, const DecodedInstruction *instruction);
+static void OpDXYN(CPUState *cpu, const DecodedInstruction *instruction);
+static void OpEX9E(CPUState *cpu, const DecodedInstruction *instruction);
+static void OpEXA1(CPUState *cpu, const DecodedInstruction *instruction);
+static void OpF000(CPUState *cpu, const DecodedInstruction *instruction);
+static void OpFN01(CPUState *cpu, const DecodedInstruction *instruction);
+static void OpF002(CPUState *cpu, const DecodedInstruction *instruction);
+static void OpFX07(CPUState *cpu, const DecodedInstruction *instruction);
+static void OpFX0A(CPUState *cpu, const DecodedInstruction *instruction);
+static void OpFX15(CPUState *cpu, const DecodedInstruction *instruction);
+static void OpFX18(CPUState *cpu, const DecodedInstruction *instruction);
+static void OpFX1E(CPUState *cpu, const DecodedInstruction *instruction);
+static void OpFX29(CPUState *cpu, const DecodedInstruction *instruction);
+static void OpFX30(CPUState *cpu, const DecodedInstruction *instruction);
+static void OpFX33(CPUState *cpu, const DecodedInstruction *instruction);
+static void OpFX3A(CPUState *cpu, const DecodedInstruction *instruction);
+static void OpFX55(CPUState *cpu, const DecodedInstruction *instruction);
+static void OpFX65(CPUState *cpu, const DecodedInstruction *instruction);
+static void OpNotImplemented(CPUState *cpu, const DecodedInstruction *instruction);
+
+// Handlers indexed by InstructionOp.
+static const InstructionHandler instruction_handlers[OP_COUNT] = {
+    [OP_DECODE] = DecodeAndExecute,
+    [OP_00E0] = Op00E0,
+    [OP_00EE] = Op00EE,
+    [OP_00CN] = Op00CN,
+    [OP_00FB] = Op00FB,
+    [OP_00FC] = Op00FC,
+    [OP_00FE] = Op00FE,
+    [OP_00FF] = Op00FF,
+    [OP_0NNN] = Op0NNN,
+    [OP_1NNN] = Op1NNN,
+    [OP_2NNN] = Op2NNN,
+    [OP_3XNN] = Op3XNN,
+    [OP_4XNN] = Op4XNN,
+    [OP_5XY0] = Op5XY0,
+    [OP_6XNN] = Op6XNN,
+    [OP_7XNN] = Op7XNN,
+    [OP_8XY0] = Op8XY0,
+    [OP_8XY1] = Op8XY1,
+    [OP_8XY2] = Op8XY2,
+    [OP_8XY3] = Op8XY3,
+    [OP_8XY4] = Op8XY4,
+    [OP_8XY5] = Op8XY5,
+    [OP_8XY6] = Op8XY6,
+    [OP_8XY7] = Op8XY7,
+    [OP_8XYE] = Op8XYE,
+    [OP_9XY0] = Op9XY0,
+    [OP_ANNN] = OpANNN,
+    [OP_BNNN] = OpBNNN,
+    [OP_CXNN] = OpCXNN,
+    [OP_DXYN] = OpDXYN,
+    [OP_EX9E] = OpEX9E,
+    [OP_EXA1] = OpEXA1,
+    [OP_F000] = OpF000,
+    [OP_FN01] = OpFN01,
+    [OP_F002] = OpF002,
+    [OP_FX07] = OpFX07,
+    [OP_FX0A] = OpFX0A,
+    [OP_FX15] = OpFX15,
+    [OP_FX18] = OpFX18,
+    [OP_FX1E] = OpFX1E,
+    [OP_FX29] = OpFX29,
+    [OP_FX30] = OpFX30,
+    [OP_FX33] = OpFX33,
+    [OP_FX3A] = OpFX3A,
+    [OP_FX55] = OpFX55,
+    [OP_FX65] = OpFX65,
+    [OP_NOT_IMPLEMENTED] = OpNotImplemented,
+};
+
+static const char *instruction_op_names[OP_COUNT] = {
+    [OP_DECODE] = "DECODE",
+    [OP_00E0] = "00E0",
+    [OP_00EE] = "00EE",
+    [OP_00CN] = "00CN",
+    [OP_00FB] = "00FB",
+    [OP_00FC] = "00FC",
+    [OP_00FE] = "00FE",
+    [OP_00FF] = "00FF",
+    [OP_0NNN] = "0NNN",
+    [OP_1NNN] = "1NNN",
+    [OP_2NNN] = "2NNN",
+    [OP_3XNN] = "3XNN",
+    [OP_4XNN] = "4XNN",
+    [OP_5XY0] = "5XY0",
+    [OP_6XNN] = "6XNN",
+    [OP_7XNN] = "7XNN",
+    [OP_8XY0] = "8XY0",
+    [OP_8XY1] = "8XY1",
+    [OP_8XY2] = "8XY2",
+    [OP_8XY3] = "8XY3",
+    [OP_8XY4] = "8XY4",
+    [OP_8XY5] = "8XY5",
+    [OP_8XY6] = "8XY6",
+    [OP_8XY7] = "8XY7",
+    [OP_8XYE] = "8XYE",
+    [OP_9XY0] = "9XY0",
+    [OP_ANNN] = "ANNN",
+    [OP_BNNN] = "BNNN",
+    [OP_CXNN] = "CXNN",
+    [OP_DXYN] = "DXYN",
+    [OP_EX9E] = "EX9E",
+    [OP_EXA1] = "EXA1",
+    [OP_F000] = "F000",
+    [OP_FN01] = "FN01",
+    [OP_F002] = "F002",
+    [OP_FX07] = "FX07",
+    [OP_FX0A] = "FX0A",
+    [OP_FX15] = "FX15",
+    [OP_FX18] = "FX18",
+    [OP_FX1E] = "FX1E",
+    [OP_FX29] = "FX29",
+    [OP_FX30] = "FX30",
+    [OP_FX33] = "FX33",
+    [OP_FX3A] = "FX3A",
+    [OP_FX55] = "FX55",
+    [OP_FX65] = "FX65",
+    [OP_NOT_IMPLEMENTED] = "NOT_IMPLEMENTED",
+};
+
 static bool KeyPressed(CPUState *cpu, uint16_t key_bit);
-static uint8_t WaitKeyPressed(CPUState *cpu);
-static void PushStack(CPUState *cpu, uint16_t pc);
-static uint16_t PopStack(CPUState *cpu);
+static bool PushStack(CPUState *cpu, uint16_t pc);
+static bool PopStack(CPUState *cpu, uint16_t *pc);
+static void StackFault(CPUState *cpu, const DecodedInstruction *instruction, const char *reason);
 
-CPUState *core_CreateCPU(uint8_t clock_target_freq, double (*pfn_get_time)(), LogLevel log_level)
+CPUState *core_CreateCPU(uint32_t clock_target_freq, uint64_t seed, double (*pfn_get_time)(), LogLevel log_level)
 {
     CPUState *cpu = calloc(1, sizeof(CPUState));
 
     // Internal
     cpu->running = false;
-    cpu->clock_target_frequency = (double)1 / clock_target_freq;
-    cpu->timer_target_frequency = (double)1 / CH8_TIMER_FREQUENCY;
+    cpu->headless = false;
     cpu->pfn_get_time = pfn_get_time;
     cpu->logger = logger_Initialize(LOGS_BASE_PATH "cpu.log", log_level);
 
-    cpu->font_start_address = CH8_FONT_START_ADDRESS;
-    cpu->memory_size = CH8_MEM_SIZE;
-
-    cpu->display.display_buffer_size = CH8_INTERNAL_DISPLAY_BUFFER_SIZE;
-    cpu->display.display_buffer_width = CH8_DISPLAY_WIDTH;
-    cpu->display.display_buffer_height = CH8_DISPLAY_HEIGHT;
-    cpu->display.display_buffer_channels = CH8_INTERNAL_DISPLAY_CHANNELS;
-    pthread_mutex_init(&cpu->display.display_buffer_lock, NULL);
-    // Initialize alpha-channel to 0xFF.
-    for (uint8_t y = 0; y < CH8_DISPLAY_HEIGHT; y++)
-    {
-        for (uint8_t x = 0; x < CH8_DISPLAY_WIDTH; x++)
-        {
-            SetAlpha(cpu, x, y, 0xFF);
-        }
-    }
-
-    cpu->stack_pointer = cpu->stack;
-
-    cpu->delay_timer = 0;
+    InitializeCPU(cpu, clock_target_freq, seed);
 
-    cpu->sound_timer = 0;
-    cpu->audio_context = aud_CreateAudioContext(1);
+    cpu->audio_context = aud_CreateAudioContext(CH8_SOUND_SLOT_COUNT);
 
     if (!aud_CreateSound(cpu->audio_context, SOUNDS_BASE_PATH "sound_timer.wav",
                          SOUND_TIMER_SOUND_SLOT, true))
         logger_LogError(cpu->logger, "Failed to create sound timer sound.");
 
-    cpu->index_register = 0;
-    cpu->program_counter = CH8_PROGRAM_START_ADDRESS;
+    return cpu;
+}
 
-    // Load font into memory.
-    logger_LogInfo(cpu->logger, "Loading font starting at address 0x%04x.", CH8_FONT_START_ADDRESS);
-    uint16_t end_address = core_LoadBinary16Data(cpu->memory, CH8_FONT_START_ADDRESS, cpu->memory_size, font_data, CH8_FONT_SIZE);
-    // Check alignment is correct. Should be 2-byte alignment.
-    if (end_address % 2 != 0)
-    {
-        logger_LogError(cpu->logger, "Font data does not have correct alignment. Alignment should be 2 bytes.");
-        raise(SIGABRT);
-    }
+CPUState *core_CreateHeadlessCPU(uint32_t clock_target_freq, uint64_t seed)
+{
+    CPUState *cpu = calloc(1, sizeof(CPUState));
+
+    // Internal
+    // No logger, audio context or time source. Everything is driven by emulated cycles.
+    cpu->running = false;
+    cpu->headless = true;
+    cpu->pfn_get_time = NULL;
+    cpu->logger = NULL;
+    cpu->audio_context = NULL;
+
+    InitializeCPU(cpu, clock_target_freq, seed);
 
     return cpu;
 }
@@ -100,9 +271,8 @@ CPUState *core_CreateCPU(uint8_t clock_target_freq, double (*pfn_get_time)(), Lo
 void core_StartCPU(CPUState *cpu)
 {
     cpu->running = true;
+    core_ResumeInputChannel(&cpu->input);
     pthread_create(&cpu->thread_id, NULL, RunCPU, (void *)cpu);
-    pthread_create(&cpu->delay_timer_thread_id, NULL, RunDelayTimer, (void *)cpu);
-    pthread_create(&cpu->sound_timer_thread_id, NULL, RunSoundTimer, (void *)cpu);
     logger_LogInfo(cpu->logger, "Starting CPU on thread 0x%016lx.", cpu->thread_id);
 }
 
@@ -110,9 +280,9 @@ void core_StopCPU(CPUState *cpu)
 {
     logger_LogInfo(cpu->logger, "Stopping CPU on thread 0x%016lx.", cpu->thread_id);
     cpu->running = false;
+    // The thread may be blocked on input rather than sleeping.
+    core_InterruptInputChannel(&cpu->input);
     pthread_join(cpu->thread_id, NULL);
-    pthread_join(cpu->delay_timer_thread_id, NULL);
-    pthread_join(cpu->sound_timer_thread_id, NULL);
 }
 
 void core_DestroyCPU(CPUState *cpu)
@@ -122,7 +292,15 @@ void core_DestroyCPU(CPUState *cpu)
         core_StopCPU(cpu);
     }
     logger_Destroy(cpu->logger);
-    aud_DestroyAudioContext(cpu->audio_context);
+    if (cpu->jit)
+    {
+        jit_DestroyContext(cpu->jit);
+    }
+    if (cpu->audio_context)
+    {
+        aud_DestroyAudioContext(cpu->audio_context);
+    }
+    core_DestroyInputChannel(&cpu->input);
     free(cpu);
 }
 
@@ -139,731 +317,1695 @@ void core_DumpMemoryCPU(CPUState *cpu)
     printf("\n");
 }
 
-void *RunCPU(void *vargp)
+bool core_SetExecModeCPU(CPUState *cpu, CPUExecMode mode)
 {
-    CPUState *cpu = vargp;
-    while (cpu->running)
+#ifndef CH8_THREADED_DISPATCH
+    if (mode == CPU_EXEC_THREADED)
     {
-        // Get start time of cycle.
-        double start_time = cpu->pfn_get_time();
-
-        // Do work
-        CycleCPU(cpu);
-
-        // Get end time of frame, calculate delta and delay.
-        double end_time = cpu->pfn_get_time();
-
-        double delta_time = end_time - start_time;
-        struct timespec delay_time = {
-            .tv_nsec = SEC_TO_NS(cpu->clock_target_frequency - delta_time),
-        };
+        logger_LogError(cpu->logger, "Threaded dispatch is not compiled in. Build with CH8_THREADED_DISPATCH.");
+        return false;
+    }
+#endif
 
-        // Cap at target clock frequency.
-        if (delay_time.tv_nsec > 0)
+    if (mode == CPU_EXEC_JIT && cpu->jit == NULL)
+    {
+        cpu->jit = jit_CreateContext(cpu->memory_size);
+        if (cpu->jit == NULL)
         {
-            nanosleep(&delay_time, NULL);
+            logger_LogError(cpu->logger, "JIT is not supported on this host.");
+            return false;
         }
     }
 
-    pthread_exit(NULL);
+    cpu->exec_mode = mode;
+    return true;
 }
 
-void *RunDelayTimer(void *vargp)
+bool core_SetMachineCPU(CPUState *cpu, CPUMachine machine)
 {
-    CPUState *cpu = vargp;
-    while (cpu->running)
+    if (machine >= CPU_MACHINE_COUNT)
     {
-        // Get start time of cycle.
-        double start_time = cpu->pfn_get_time();
-
-        if (cpu->delay_timer > 0)
-            cpu->delay_timer--;
+        logger_LogError(cpu->logger, "Unknown machine %d.", machine);
+        return false;
+    }
 
-        // Get end time of frame, calculate delta and delay.
-        double end_time = cpu->pfn_get_time();
+    cpu->machine = machine;
+    cpu->memory_size = machine == CPU_MACHINE_XOCHIP ? CH8_XO_MEM_SIZE : CH8_MEM_SIZE;
+    cpu->program_counter &= cpu->memory_size - 1;
+    // Instructions were decoded and compiled for the previous machine.
+    core_FlushDecodedCPU(cpu);
+
+    // Only XO-CHIP selects planes. Start over with plane 0, as on reset.
+    core_InitializeDisplay(&cpu->display);
+    memcpy(cpu->audio_pattern, default_audio_pattern, CH8_AUDIO_PATTERN_SIZE);
+    cpu->audio_pitch = CH8_AUDIO_DEFAULT_PITCH;
+    cpu->audio_pattern_dirty = true;
+    return true;
+}
 
-        double delta_time = end_time - start_time;
-        struct timespec delay_time = {
-            .tv_nsec = SEC_TO_NS(cpu->timer_target_frequency - delta_time),
-        };
+CPUMachine core_GetMachineForROM(const char *filename)
+{
+    const char *extension = strrchr(filename, '.');
+    if (extension != NULL && strcasecmp(extension, ".xo8") == 0)
+    {
+        return CPU_MACHINE_XOCHIP;
+    }
+    return CPU_MACHINE_CHIP8;
+}
 
-        // Cap at target clock frequency.
-        if (delay_time.tv_nsec > 0)
-        {
-            nanosleep(&delay_time, NULL);
-        }
+void core_SetTraceCPU(CPUState *cpu, TraceWriter *trace)
+{
+    if (trace != NULL && trace->bytes_written == 0 && trace->buffer_used == 0)
+    {
+        core_WriteTraceHeader(trace);
     }
 
-    pthread_exit(NULL);
+    cpu->trace = trace;
+    cpu->traced_delay_timer = cpu->delay_timer;
+    cpu->traced_sound_timer = cpu->sound_timer;
+    cpu->traced_timer_tick = false;
 }
 
-void *RunSoundTimer(void *vargp)
+void core_SetProfileCPU(CPUState *cpu, CPUProfile *profile)
 {
-    CPUState *cpu = vargp;
-    bool sound_playing = false;
-    while (cpu->running)
+    cpu->profile = profile;
+}
+
+void core_SetRewindCPU(CPUState *cpu, RewindBuffer *rewind)
+{
+    cpu->rewind = rewind;
+}
+
+void core_SetKeysCPU(CPUState *cpu, uint16_t keys)
+{
+    Movie *movie = cpu->movie;
+    if (movie != NULL && !movie->recording)
     {
-        // Get start time of cycle.
-        double start_time = cpu->pfn_get_time();
+        return;
+    }
 
-        if (cpu->sound_timer > 0)
-        {
-            if(!sound_playing)
-            {
-                aud_PlaySound(cpu->audio_context, SOUND_TIMER_SOUND_SLOT);
-                sound_playing = true;
-            }
-            cpu->sound_timer--;
-        }
-        else
-        {
-            aud_StopSound(cpu->audio_context, SOUND_TIMER_SOUND_SLOT);
-            sound_playing = false;
-        }
+    cpu->keys = keys;
+    if (movie != NULL && keys != movie->recorded_keys)
+    {
+        core_WriteMovieEvent(movie, cpu->cycles, keys);
+    }
+}
 
-        // Get end time of frame, calculate delta and delay.
-        double end_time = cpu->pfn_get_time();
+bool core_SetMovieCPU(CPUState *cpu, Movie *movie)
+{
+    if (cpu->movie != NULL && cpu->movie->recording)
+    {
+        // The last event marks where the recording ends.
+        core_WriteMovieEvent(cpu->movie, cpu->cycles, cpu->keys);
+    }
+    cpu->movie = NULL;
 
-        double delta_time = end_time - start_time;
-        struct timespec delay_time = {
-            .tv_nsec = SEC_TO_NS(cpu->timer_target_frequency - delta_time),
-        };
+    if (movie == NULL)
+    {
+        return true;
+    }
 
-        // Cap at target clock frequency.
-        if (delay_time.tv_nsec > 0)
-        {
-            nanosleep(&delay_time, NULL);
-        }
+    if (movie->recording)
+    {
+        core_WriteMovieEvent(movie, cpu->cycles, cpu->keys);
+    }
+    else if (movie->header.machine != cpu->machine ||
+             movie->header.clock_frequency != cpu->clock_target_frequency ||
+             movie->header.seed != cpu->random_seed ||
+             movie->header.start_cycle != cpu->cycles ||
+             movie->header.program_hash != core_HashProgramMovie(cpu))
+    {
+        logger_LogError(cpu->logger, "Movie was recorded from a different machine, clock, seed, program or cycle.");
+        return false;
     }
 
-    pthread_exit(NULL);
+    cpu->movie = movie;
+    return true;
 }
 
-void CycleCPU(CPUState *cpu)
+size_t core_LoadProgramCPU(CPUState *cpu, const char *filename)
 {
-    // Fetch instruction.
-    // Side-effect: increases program_counter by 2.
-    uint16_t instruction = READ_16BIT(cpu->memory, cpu->program_counter);
+    size_t end_address = core_LoadBinary16File(cpu->logger, filename, cpu->memory, CH8_PROGRAM_START_ADDRESS, cpu->memory_size);
+    InvalidateDecoded(cpu, CH8_PROGRAM_START_ADDRESS, end_address - CH8_PROGRAM_START_ADDRESS);
+    return end_address;
+}
 
-    // Decode and execute instruction.
-    // Test on most significant nibble.
-    switch (instruction & 0xF000)
+void core_InvalidateDecodedCPU(CPUState *cpu, uint16_t address, size_t size)
+{
+    InvalidateDecoded(cpu, address, size);
+}
+
+void core_FlushDecodedCPU(CPUState *cpu)
+{
+    for (size_t i = 0; i < CH8_DECODE_CACHE_SIZE; i++)
     {
-    case 0x0000:
+        cpu->decode_cache[i].op = OP_DECODE;
+        cpu->decode_cache[i].handler = DecodeAndExecute;
+    }
+
+    if (cpu->jit)
     {
-        switch (instruction & 0x00FF)
-        {
-        // 0x00E0 - Clear screen.
-        case 0x00E0:
+        jit_Flush(cpu->jit);
+    }
+}
+
+uint64_t core_RunCPUUnthrottled(CPUState *cpu, uint64_t n_cycles)
+{
+    uint64_t end_cycle = cpu->cycles + n_cycles;
+    while (cpu->cycles < end_cycle)
+    {
+        if (cpu->movie != NULL)
+            ReplayMovie(cpu);
+
+        // Run until the next timer tick or the end of the budget, whichever comes first.
+        uint64_t stop_cycle = cpu->next_timer_tick_cycle < end_cycle ? cpu->next_timer_tick_cycle : end_cycle;
+        // Or the next replayed key change. Always UINT64_MAX unless replaying.
+        if (cpu->movie != NULL && cpu->movie->next_cycle < stop_cycle)
+            stop_cycle = cpu->movie->next_cycle;
+        // Only the interpreter sees every instruction, so it runs while tracing or profiling.
+        CPUExecMode mode = cpu->trace == NULL && cpu->profile == NULL ? cpu->exec_mode : CPU_EXEC_INTERPRETER;
+        // The JIT only compiles CHIP-8.
+        if (mode == CPU_EXEC_JIT && cpu->machine != CPU_MACHINE_CHIP8)
+            mode = CPU_EXEC_INTERPRETER;
+        if (mode == CPU_EXEC_JIT)
         {
-            // Set every pixel to 0.
-            for (uint8_t y = 0; y < CH8_DISPLAY_HEIGHT; y++)
+            while (cpu->cycles < stop_cycle)
             {
-                for (uint8_t x = 0; x < CH8_DISPLAY_WIDTH; x++)
+                // Blocks never cross a timer tick, so timers are observed at the same cycle as interpreted.
+                uint32_t executed = jit_RunBlock(cpu->jit, cpu, stop_cycle - cpu->cycles);
+                if (executed == 0)
                 {
-                    SetPixel(cpu, x, y, 0);
+                    CycleCPU(cpu);
+                    executed = 1;
                 }
+                cpu->cycles += executed;
             }
-            logger_LogDebug(cpu->logger, "(0x%04X) - Clear screen.", instruction);
-            break;
         }
-        // 0x00EE - Return.
-        case 0x00EE:
+#ifdef CH8_THREADED_DISPATCH
+        else if (mode == CPU_EXEC_THREADED)
         {
-            // Pop previous PC of stack and set current PC.
-            cpu->program_counter = PopStack(cpu);
-            logger_LogDebug(cpu->logger, "(0x%04X) - Return.", instruction);
-            break;
+            RunThreaded(cpu, stop_cycle - cpu->cycles);
+            cpu->cycles = stop_cycle;
         }
-        // 0x0NNN - Ignored as we're not running on a machine with actual chip-8 support.
-        default:
-            logger_LogDebug(cpu->logger, "(0x%04X) - Call machine code routine(NOT IMPLEMENTED).", instruction);
-            break;
+#endif
+        else
+        {
+            while (cpu->cycles < stop_cycle)
+            {
+                CycleCPU(cpu);
+                cpu->cycles++;
+            }
+        }
+
+        if (cpu->cycles == cpu->next_timer_tick_cycle)
+        {
+            TickTimers(cpu);
+            cpu->next_timer_tick_cycle += cpu->cycles_per_timer_tick;
+
+            // Only once the tick is done, so a restored frame doesn't tick again.
+            if (cpu->rewind != NULL)
+                core_PushRewindFrame(cpu->rewind, cpu);
         }
-        break;
-    }
-    // 0x1NNN - Jump to NNN.
-    case 0x1000:
-    {
-        // Extract 12-bit immediate address(NNN).
-        uint16_t immediate_addr = instruction & 0x0FFF;
-        // Set PC.
-        cpu->program_counter = immediate_addr;
-        logger_LogDebug(cpu->logger, "(0x%04X) - Jump to 0x%04X.", instruction, immediate_addr);
-        break;
     }
-    // 0x2NNN - Call subroutine at address NNN.
-    case 0x2000:
+
+    return n_cycles;
+}
+
+void InitializeCPU(CPUState *cpu, uint32_t clock_target_freq, uint64_t seed)
+{
+    cpu->clock_target_frequency = clock_target_freq;
+
+    // Timers tick at a fixed ratio of emulated cycles, whether paced or not.
+    cpu->cycles = 0;
+    cpu->cycles_per_timer_tick = clock_target_freq > CH8_TIMER_FREQUENCY ? clock_target_freq / CH8_TIMER_FREQUENCY : 1;
+    cpu->next_timer_tick_cycle = cpu->cycles_per_timer_tick;
+
+    cpu->font_start_address = CH8_FONT_START_ADDRESS;
+    cpu->big_font_start_address = CH8_BIG_FONT_START_ADDRESS;
+    cpu->machine = CPU_MACHINE_CHIP8;
+    cpu->memory_size = CH8_MEM_SIZE;
+    // Nothing is decoded yet. Every entry decodes itself on first execution, including those
+    // past 'memory_size' that another machine may reach.
+    core_FlushDecodedCPU(cpu);
+
+    cpu->display.display_buffer_size = CH8_INTERNAL_DISPLAY_BUFFER_SIZE;
+    cpu->display.display_buffer_width = CH8_DISPLAY_HIRES_WIDTH;
+    cpu->display.display_buffer_height = CH8_DISPLAY_HIRES_HEIGHT;
+    cpu->display.display_buffer_channels = CH8_INTERNAL_DISPLAY_CHANNELS;
+    core_InitializeDisplay(&cpu->display);
+
+    cpu->stack_pointer = cpu->stack;
+
+    core_InitializeInputChannel(&cpu->input);
+    cpu->waiting_for_key = false;
+    cpu->stack_fault = false;
+
+    cpu->delay_timer = 0;
+    cpu->sound_timer = 0;
+    memcpy(cpu->audio_pattern, default_audio_pattern, CH8_AUDIO_PATTERN_SIZE);
+    cpu->audio_pitch = CH8_AUDIO_DEFAULT_PITCH;
+    cpu->audio_pattern_dirty = true;
+
+    cpu->index_register = 0;
+    cpu->program_counter = CH8_PROGRAM_START_ADDRESS;
+
+    cpu->random_seed = seed;
+    SeedRandomState(&cpu->random_state, seed);
+
+    // Load font into memory.
+    logger_LogInfo(cpu->logger, "Loading font starting at address 0x%04x.", CH8_FONT_START_ADDRESS);
+    size_t end_address = core_LoadBinary16Data(cpu->logger, cpu->memory, CH8_FONT_START_ADDRESS, cpu->memory_size, font_data, CH8_FONT_SIZE);
+    // Check alignment is correct. Should be 2-byte alignment.
+    if (end_address % 2 != 0)
     {
-        // Extract 12-bit immediate address(NNN).
-        uint16_t immediate_addr = instruction & 0x0FFF;
-        // Push current PC on stack.
-        PushStack(cpu, cpu->program_counter);
-        // Set PC to NNN.
-        cpu->program_counter = immediate_addr;
-        logger_LogDebug(cpu->logger, "(0x%04X) - Call subroutine at address %04X.", instruction, immediate_addr);
-        break;
+        logger_LogError(cpu->logger, "Font data does not have correct alignment. Alignment should be 2 bytes.");
+        raise(SIGABRT);
     }
-    // 0x3XNN - Skips next instruction if Vx == NN.
-    case 0x3000:
+    core_LoadBinary16Data(cpu->logger, cpu->memory, CH8_BIG_FONT_START_ADDRESS, cpu->memory_size, big_font_data, CH8_BIG_FONT_SIZE);
+}
+
+void TickTimers(CPUState *cpu)
+{
+    if (cpu->delay_timer > 0)
+        cpu->delay_timer--;
+
+    // The tone plays for as long as the sound timer is non-zero at a tick.
+    UpdateSound(cpu);
+    if (cpu->sound_timer > 0)
+        cpu->sound_timer--;
+    if (cpu->trace != NULL)
+        cpu->traced_timer_tick = true;
+
+    // The tick doubles as vblank. Publishing here rather than per sprite keeps the copy off
+    // the DXYN path and hands the renderer at most one frame per tick.
+    if (cpu->display.dirty_rows != 0)
+        core_PublishDisplay(&cpu->display);
+}
+
+void UpdateSound(CPUState *cpu)
+{
+    if (cpu->audio_context == NULL)
     {
-        // Extract 4-bit register index(X).
-        uint8_t register_index = (instruction & 0x0F00) >> 8;
-        // Extract 8-bit immediate value(NN).
-        uint8_t immediate_value = instruction & 0x00FF;
-        // Skip next instruction if VX == NN.
-        if (cpu->variable_registers[register_index] == immediate_value)
-        {
-            // Note: we only increase by two here because PC is automatically incremented
-            //       when we read the next instruction.
-            cpu->program_counter += 2;
-        }
-        logger_LogDebug(cpu->logger, "(0x%04X) - Skip next instruction if (V%X(%02X) == %02X)(%s).",
-                        instruction, register_index, cpu->variable_registers[register_index], immediate_value,
-                        cpu->variable_registers[register_index] == immediate_value ? "true" : "false");
-        break;
+        return;
     }
-    // 0x4XNN - Skips next instruction if VX != NN.
-    case 0x4000:
+
+    if (cpu->audio_pattern_dirty)
     {
-        // Extract 4-bit register index(X).
-        uint8_t register_index = (instruction & 0x0F00) >> 8;
-        // Extract 8-bit immediate value(NN).
-        uint8_t immediate_value = instruction & 0x00FF;
-        // Skip next instruction if VX == NN.
-        if (cpu->variable_registers[register_index] != immediate_value)
+        // A playing buffer can't be refilled. Stop it here; it restarts below with the new pattern.
+        if (cpu->sound_playing)
         {
-            // Note: we only increase by two here because PC is automatically incremented
-            //       when we read the next instruction.
-            cpu->program_counter += 2;
+            aud_StopSound(cpu->audio_context, cpu->sound_slot);
+            cpu->sound_playing = false;
         }
-        logger_LogDebug(cpu->logger, "(0x%04X) - Skip next instruction if (V%X(%02X) != %02X)(%s).",
-                        instruction, register_index, cpu->variable_registers[register_index], immediate_value,
-                        cpu->variable_registers[register_index] != immediate_value ? "true" : "false");
-        break;
+        UploadAudioPattern(cpu);
+        cpu->audio_pattern_dirty = false;
     }
-    // 0x5XY0 - Skips next instruction if VX == VY.
-    case 0x5000:
+
+    if (cpu->sound_timer > 0 && !cpu->sound_playing)
     {
-        // Extract 4-bit register index(X).
-        uint8_t register_index_x = (instruction & 0x0F00) >> 8;
-        // Extract 4-bit register_index(Y).
-        uint8_t register_index_y = (instruction & 0x00F0) >> 4;
-        // Skip next instruction if VX == NN.
-        if (cpu->variable_registers[register_index_x] == cpu->variable_registers[register_index_y])
-        {
-            // Note: we only increase by two here because PC is automatically incremented
-            //       when we read the next instruction.
-            cpu->program_counter += 2;
-        }
-        logger_LogDebug(cpu->logger, "(0x%04X) - Skip next instruction if (V%X(%02X) == V%X(%02X))(%s).",
-                        instruction, register_index_x, cpu->variable_registers[register_index_x],
-                        register_index_y, cpu->variable_registers[register_index_y],
-                        cpu->variable_registers[register_index_x] == cpu->variable_registers[register_index_y] ? "true" : "false");
-        break;
+        // XO-CHIP plays its pattern instead of the beep.
+        cpu->sound_slot = cpu->machine == CPU_MACHINE_XOCHIP ? AUDIO_PATTERN_SOUND_SLOT : SOUND_TIMER_SOUND_SLOT;
+        aud_PlaySound(cpu->audio_context, cpu->sound_slot);
+        cpu->sound_playing = true;
     }
-    // 0x6XNN - Set Vx to NN.
-    case 0x6000:
+    else if (cpu->sound_timer == 0 && cpu->sound_playing)
     {
-        // Extract 4-bit register index(X).
-        uint8_t register_index = (instruction & 0x0F00) >> 8;
-        // Extract 8-bit immediate value(NN).
-        uint8_t immediate_value = instruction & 0x00FF;
-        // Set Vx.
-        cpu->variable_registers[register_index] = immediate_value;
-        logger_LogDebug(cpu->logger, "(0x%04X) - Set V%X to 0x%02X.", instruction, register_index, immediate_value);
-        break;
+        aud_StopSound(cpu->audio_context, cpu->sound_slot);
+        cpu->sound_playing = false;
     }
-    // 0x7XNN - Add NN to Vx.
-    case 0x7000:
+}
+
+// Renders the 1-bit pattern to 8-bit samples at the rate set by the pitch.
+void UploadAudioPattern(CPUState *cpu)
+{
+    uint8_t samples[CH8_AUDIO_PATTERN_SAMPLES];
+    for (size_t i = 0; i < CH8_AUDIO_PATTERN_SAMPLES; i++)
     {
-        // Extract 4-bit register index(X).
-        uint8_t register_index = (instruction & 0x0F00) >> 8;
-        // Extract 8-bit immediate value(NN).
-        uint8_t immediate_value = instruction & 0x00FF;
-        // Add to Vx.
-        cpu->variable_registers[register_index] += immediate_value;
-        logger_LogDebug(cpu->logger, "(0x%04X) - Add 0x%02X to V%X.", instruction, register_index, immediate_value);
-        break;
+        bool high = cpu->audio_pattern[i / 8] & (0x80 >> (i % 8));
+        samples[i] = high ? 0xC0 : 0x40;
     }
-    // 0x8XY_ - All 0x8000 instructions have X/Y register index.
-    case 0x8000:
-    {
-        // Extract 4-bit register index(X).
-        uint8_t register_index_x = (instruction & 0x0F00) >> 8;
-        // Extract 4-bit register index(Y).
-        uint8_t register_index_y = (instruction & 0x00F0) >> 4;
 
-        switch (instruction & 0x000F)
-        {
-        // 0x8XY0 - Set VX to VY.
-        case 0x0000:
-        {
-            // Set VX to VY.
-            cpu->variable_registers[register_index_x] = cpu->variable_registers[register_index_y];
-            logger_LogDebug(cpu->logger, "(0x%04X) - Set V%X to V%X(%02X).",
-                            instruction, register_index_x, register_index_y, cpu->variable_registers[register_index_y]);
-            break;
-        }
-        // 0x8XY1 - Set VX to VX | VY.
-        case 0x0001:
-        {
-            cpu->variable_registers[register_index_x] |= cpu->variable_registers[register_index_y];
-            logger_LogDebug(cpu->logger, "(0x%04X) - Set V%X to V%X(%02X) | V%X(%02X).",
-                            instruction, register_index_x,
-                            register_index_x, cpu->variable_registers[register_index_x],
-                            register_index_y, cpu->variable_registers[register_index_y]);
-            break;
-        }
-        // 0x8XY2 - Set VX to VX & VY.
-        case 0x0002:
+    uint32_t sample_rate = (uint32_t)(4000.0 * exp2((cpu->audio_pitch - 64) / 48.0));
+    if (!aud_CreateSoundFromSamples(cpu->audio_context, samples, CH8_AUDIO_PATTERN_SAMPLES, sample_rate,
+                                    AUDIO_PATTERN_SOUND_SLOT, true))
+        logger_LogError(cpu->logger, "Failed to create audio pattern sound.");
+}
+
+void *RunCPU(void *vargp)
+{
+    // Wall-clock pacing on top of the cycle-driven scheduler. Each slice runs every cycle that
+    // has come due since start, then sleeps until the next one is due. Timers are ticked by
+    // core_RunCPUUnthrottled, so paced and unthrottled runs of the same input are identical.
+    CPUState *cpu = vargp;
+    double start_time = cpu->pfn_get_time();
+    uint64_t start_cycle = cpu->cycles;
+    uint64_t next_input_cycle = cpu->cycles;
+    while (cpu->running)
+    {
+        double elapsed_time = cpu->pfn_get_time() - start_time;
+        uint64_t due_cycle = start_cycle + (uint64_t)(elapsed_time * cpu->clock_target_frequency);
+        if (due_cycle > cpu->cycles)
         {
-            cpu->variable_registers[register_index_x] &= cpu->variable_registers[register_index_y];
-            logger_LogDebug(cpu->logger, "(0x%04X) - Set V%X to V%X(%02X) & V%X(%02X).",
-                            instruction, register_index_x,
-                            register_index_x, cpu->variable_registers[register_index_x],
-                            register_index_y, cpu->variable_registers[register_index_y]);
-            break;
+            uint64_t n_cycles = due_cycle - cpu->cycles;
+            // Fell far behind, e.g. after being suspended. Drop the backlog instead of fast-forwarding.
+            uint64_t max_cycles = cpu->cycles_per_timer_tick * CH8_SCHEDULER_MAX_CATCH_UP_TICKS;
+            if (n_cycles > max_cycles)
+            {
+                start_cycle += n_cycles - max_cycles;
+                n_cycles = max_cycles;
+            }
+            if (cpu->cycles >= next_input_cycle)
+            {
+                LatchKeysCPU(cpu, &next_input_cycle);
+            }
+            core_RunCPUUnthrottled(cpu, n_cycles);
         }
-        // 0x8XY3 - Set VX to VX ^ VY.
-        case 0x0003:
+
+        if (CanIdleCPU(cpu))
         {
-            cpu->variable_registers[register_index_x] ^= cpu->variable_registers[register_index_y];
-            logger_LogDebug(cpu->logger, "(0x%04X) - Set V%X to V%X(%02X) ^ V%X(%02X).",
-                            instruction, register_index_x,
-                            register_index_x, cpu->variable_registers[register_index_x],
-                            register_index_y, cpu->variable_registers[register_index_y]);
-            break;
+            // Nothing can happen until a key is pressed. Block instead of re-executing FX0A, and
+            // restart the schedule afterwards so the idle time is not caught up on.
+            core_WaitInputChannel(&cpu->input, cpu->keys);
+            LatchKeysCPU(cpu, &next_input_cycle);
+            start_time = cpu->pfn_get_time();
+            start_cycle = cpu->cycles;
+            continue;
         }
-        // 0x8XY4 - Add VY to VX.
-        // Set VF if overflow.
-        case 0x0004:
+
+        // Sleep until the next cycle is due, but no longer than one slice so stopping stays responsive.
+        double next_time = (double)(cpu->cycles + 1 - start_cycle) / cpu->clock_target_frequency;
+        double delay = next_time - (cpu->pfn_get_time() - start_time);
+        if (delay > CH8_SCHEDULER_SLICE)
+            delay = CH8_SCHEDULER_SLICE;
+        if (delay > 0)
         {
-            // We need to use a uint16_t here to be able to check for overflow.
-            uint16_t result = cpu->variable_registers[register_index_x] + cpu->variable_registers[register_index_y];
-            // Initially, we set overflow to 0.
-            cpu->variable_registers[0xF] = 0;
-            // If there is overflow, we set it to 1.
-            if (result > 0xFF)
-                cpu->variable_registers[0xF] = 1;
-            // Either way, we will store the first byte of result in VX.
-            cpu->variable_registers[register_index_x] = result & 0xFF;
-
-            logger_LogDebug(cpu->logger, "(0x%04X) - Add V%X(%02X) to V%X - VF(%02X).",
-                            instruction, register_index_y, cpu->variable_registers[register_index_y],
-                            register_index_x, cpu->variable_registers[0xF]);
-            break;
+            struct timespec delay_time = {
+                .tv_sec = 0,
+                .tv_nsec = SEC_TO_NS(delay),
+            };
+            nanosleep(&delay_time, NULL);
         }
-        // 0x8XY5 - Subtract VY from VX.
-        // Set VF if not underflow.
-        case 0x0005:
-        {
-            // Check underflow.
-            uint8_t underflow = cpu->variable_registers[register_index_x] < cpu->variable_registers[register_index_y] ? 1 : 0;
-            // Set VX.
-            cpu->variable_registers[register_index_x] -= cpu->variable_registers[register_index_y];
-            // Set underflow.
-            cpu->variable_registers[0xF] = !underflow;
+    }
 
-            logger_LogDebug(cpu->logger, "(0x%04X) - Sub V%X(%02X) from V%X - VF(%02X).",
-                            instruction, register_index_y, cpu->variable_registers[register_index_y],
-                            register_index_x, cpu->variable_registers[0xF]);
-            break;
-        }
-        // 0x8XY6 - Right-shift VX by 1.
-        // Stores least significant bit in VF prior to shift.
-        case 0x0006:
-        {
-            // Store least significant bit in VF prior to shift.
-            cpu->variable_registers[0xF] = cpu->variable_registers[register_index_x] & 0x01;
-            // Right-shift VX by 1.
-            cpu->variable_registers[register_index_x] >>= 1;
+    pthread_exit(NULL);
+}
 
-            logger_LogDebug(cpu->logger, "(0x%04X) -  V%X(%02X) >> 1 - VF(%02X).",
-                            instruction, register_index_x, cpu->variable_registers[register_index_x],
-                            cpu->variable_registers[0xF]);
-            break;
-        }
-        // 0x8XY7 - Set VX to VY - VX.
-        // Set VF if not underflow.
-        case 0x0007:
-        {
-            // Check underflow.
-            uint8_t underflow = cpu->variable_registers[register_index_y] < cpu->variable_registers[register_index_x] ? 1 : 0;
-            // Set VX.
-            cpu->variable_registers[register_index_x] = cpu->variable_registers[register_index_y] - cpu->variable_registers[register_index_x];
-            // Set underflow.
-            cpu->variable_registers[0xF] = !underflow;
-
-            logger_LogDebug(cpu->logger, "(0x%04X) - Set V%X to V%X(%02X) - V%X(%02X) - VF(%02X).",
-                            instruction, register_index_x,
-                            register_index_y, cpu->variable_registers[register_index_y],
-                            register_index_x, cpu->variable_registers[register_index_x],
-                            cpu->variable_registers[0xF]);
-            break;
-        }
-        // 0x8XYE - Left-shift VX by 1.
-        // Stores most significant bit in VF prior to shift.
-        case 0x000E:
-        {
-            // Store most significant bit in VF prior to shift.
-            cpu->variable_registers[0xF] = cpu->variable_registers[register_index_x] & (0x01 << 7);
-            // Left-shift VX by 1.
-            cpu->variable_registers[register_index_x] <<= 1;
+// True when the next cycles can only repeat FX0A: no key, no running timer, and the last frame
+// already published. Never while replaying a movie, whose keys don't come from the input channel.
+bool CanIdleCPU(CPUState *cpu)
+{
+    return cpu->waiting_for_key && cpu->keys == 0 &&
+           cpu->delay_timer == 0 && cpu->sound_timer == 0 &&
+           cpu->display.dirty_rows == 0 &&
+           (cpu->movie == NULL || cpu->movie->recording);
+}
 
-            logger_LogDebug(cpu->logger, "(0x%04X) -  V%X(%02X) << 1 - VF(%02X).",
-                            instruction, register_index_x, cpu->variable_registers[register_index_x],
-                            cpu->variable_registers[0xF]);
-            break;
-        }
-        default:
-            logger_LogDebug(cpu->logger, "(0x%04X) - (NOT IMPLEMENTED).", instruction);
-            break;
-        }
-    }
-    // 0x9XY0 - Skips next instruction if VX != VY.
-    case 0x9000:
+// Applies the next key edge. The following one waits a timer tick, so that a tap shorter
+// than a frame is still held for one, as programs tend to poll keys once per frame.
+void LatchKeysCPU(CPUState *cpu, uint64_t *next_input_cycle)
+{
+    uint16_t keys = core_PollInputKeys(&cpu->input);
+    if (keys != cpu->keys)
     {
-        // Extract 4-bit register index(X).
-        uint8_t register_index_x = (instruction & 0x0F00) >> 8;
-        // Extract 4-bit register_index(Y).
-        uint8_t register_index_y = (instruction & 0x00F0) >> 4;
-        // Skip next instruction if VX == NN.
-        if (cpu->variable_registers[register_index_x] != cpu->variable_registers[register_index_y])
-        {
-            // Note: we only increase by two here because PC is automatically incremented
-            //       when we read the next instruction.
-            cpu->program_counter += 2;
-        }
-        logger_LogDebug(cpu->logger, "(0x%04X) - Skip next instruction if (V%X(%02X) != V%X(%02X))(%s).",
-                        instruction, register_index_x, cpu->variable_registers[register_index_x],
-                        register_index_y, cpu->variable_registers[register_index_y],
-                        cpu->variable_registers[register_index_x] != cpu->variable_registers[register_index_y] ? "true" : "false");
-        break;
+        core_SetKeysCPU(cpu, keys);
+        *next_input_cycle = cpu->cycles + cpu->cycles_per_timer_tick;
     }
-    // 0xANNN - Set index register(I) to NNN.
-    case 0xA000:
+}
+
+void CycleCPU(CPUState *cpu)
+{
+    if (cpu->profile != NULL)
     {
-        // Extract 12-bit immediate address(NNN).
-        uint16_t immediate_addr = instruction & 0x0FFF;
-        // Set I.
-        cpu->index_register = immediate_addr;
-        logger_LogDebug(cpu->logger, "(0x%04X) - Set I to 0x%04X.", instruction, immediate_addr);
-        break;
+        ProfileInstruction(cpu);
     }
-    // 0xBNNN - Jump to address V0 + NNN.
-    case 0xB000:
+
+    if (cpu->trace != NULL)
     {
-        // Extract 12-bit immediate address(NNN).
-        uint16_t immediate_addr = instruction & 0x0FFF;
-        // Set PC to V0 + NNN.
-        cpu->program_counter = cpu->variable_registers[0x0] + immediate_addr;
+        TraceCycleCPU(cpu);
+        return;
+    }
 
-        logger_LogDebug(cpu->logger, "(0x%04X) - Jump to V0(%02X) + 0x%04X.",
-                        instruction, cpu->variable_registers[0x0], immediate_addr);
-        break;
+    ExecuteNextCPU(cpu);
+}
+
+void TraceCycleCPU(CPUState *cpu)
+{
+    CPUTraceRecord record;
+    record.cycle = cpu->cycles;
+    record.address = cpu->program_counter & (cpu->memory_size - 1);
+    record.opcode = PEEK_16BIT(cpu->memory, record.address, cpu->memory_size - 1);
+
+    uint8_t variable_registers[CH8_VREG_COUNT];
+    memcpy(variable_registers, cpu->variable_registers, sizeof(variable_registers));
+    uint16_t index_register = cpu->index_register;
+    uint16_t *stack_pointer = cpu->stack_pointer;
+
+    ExecuteNextCPU(cpu);
+
+    record.changed = cpu->traced_timer_tick ? CH8_TRACE_TIMER_TICK : 0;
+    cpu->traced_timer_tick = false;
+    if (memcmp(variable_registers, cpu->variable_registers, sizeof(variable_registers)) != 0)
+    {
+        for (uint8_t i = 0; i < CH8_VREG_COUNT; i++)
+        {
+            if (variable_registers[i] != cpu->variable_registers[i])
+                record.changed |= 1u << i;
+        }
+        memcpy(record.variable_registers, cpu->variable_registers, sizeof(record.variable_registers));
     }
-    // 0xCXNN - Set VX to bitwise-and between random number and NN.
-    case 0xC000:
+    if (index_register != cpu->index_register)
+    {
+        record.changed |= CH8_TRACE_CHANGED_I;
+        record.index_register = cpu->index_register;
+    }
+    // Against the last record, so decrements by ticks since then are reported too.
+    if (cpu->traced_delay_timer != cpu->delay_timer)
+    {
+        record.changed |= CH8_TRACE_CHANGED_DELAY_TIMER;
+        record.delay_timer = cpu->traced_delay_timer = cpu->delay_timer;
+    }
+    if (cpu->traced_sound_timer != cpu->sound_timer)
+    {
+        record.changed |= CH8_TRACE_CHANGED_SOUND_TIMER;
+        record.sound_timer = cpu->traced_sound_timer = cpu->sound_timer;
+    }
+    if (stack_pointer != cpu->stack_pointer)
+    {
+        record.changed |= CH8_TRACE_CHANGED_STACK;
+        record.stack_depth = cpu->stack_pointer - cpu->stack;
+    }
+
+    core_WriteTraceRecord(cpu->trace, &record);
+}
+
+// Applies every replayed key change due by the current cycle.
+void ReplayMovie(CPUState *cpu)
+{
+    Movie *movie = cpu->movie;
+    while (movie->next_cycle <= cpu->cycles)
+    {
+        cpu->keys = movie->next_keys;
+        core_AdvanceMovie(movie);
+    }
+}
+
+// Counts the instruction about to execute.
+void ProfileInstruction(CPUState *cpu)
+{
+    uint16_t address = cpu->program_counter & (cpu->memory_size - 1);
+    CPUProfile *profile = cpu->profile;
+    profile->instructions++;
+    profile->address_counts[(address >> 1) & (CH8_PROFILE_ADDRESS_SLOTS - 1)]++;
+
+    // The cache knows the op, except on first execution and at odd addresses. Decode those here.
+    InstructionOp op = cpu->decode_cache[(address >> 1) & (CH8_DECODE_CACHE_SIZE - 1)].op;
+    if (op == OP_DECODE || (address & 0x1))
+    {
+        DecodedInstruction instruction;
+        core_DecodeInstruction(PEEK_16BIT(cpu->memory, address, cpu->memory_size - 1), &instruction);
+        op = instruction.op;
+    }
+    profile->op_counts[op]++;
+}
+
+void ExecuteNextCPU(CPUState *cpu)
+{
+    // Fetch instruction.
+    // Side-effect: increases program_counter by 2. Every write to PC wraps it around the end
+    // of memory, so it always addresses memory of the current machine.
+    uint16_t mask = cpu->memory_size - 1;
+    uint16_t address = cpu->program_counter;
+    cpu->program_counter = (address + 2) & mask;
+
+    // Instructions at odd addresses are rare and not cached. Decode them on the fly.
+    if (address & 0x1)
+    {
+        DecodedInstruction instruction;
+        core_DecodeInstruction(PEEK_16BIT(cpu->memory, address, mask), &instruction);
+        instruction.handler(cpu, &instruction);
+        return;
+    }
+
+    // Execute cached instruction. Entries that haven't been decoded yet point at DecodeAndExecute.
+    const DecodedInstruction *instruction = &cpu->decode_cache[(address >> 1) & (CH8_DECODE_CACHE_SIZE - 1)];
+    instruction->handler(cpu, instruction);
+}
+
+const char *core_GetInstructionOpName(InstructionOp op)
+{
+    return op < OP_COUNT ? instruction_op_names[op] : "INVALID";
+}
+
+void core_DecodeInstruction(uint16_t opcode, DecodedInstruction *instruction)
+{
+    instruction->opcode = opcode;
+    // Extract 12-bit immediate address(NNN).
+    instruction->nnn = opcode & 0x0FFF;
+    // Extract 4-bit register indices(X/Y).
+    instruction->x = (opcode & 0x0F00) >> 8;
+    instruction->y = (opcode & 0x00F0) >> 4;
+    // Extract 4-bit and 8-bit immediate values(N/NN).
+    instruction->n = opcode & 0x000F;
+    instruction->nn = opcode & 0x00FF;
+
+    // Test on most significant nibble.
+    switch (opcode & 0xF000)
     {
-        // Extract 4-bit register index(X).
-        uint8_t register_index = (instruction & 0x0F00) >> 8;
-        // Extract 8-bit immediate value(NN).
-        uint8_t immediate_value = instruction & 0x00FF;
-        // Set VX to bitwise-and between random number and NN.
-        uint8_t random_number = (uint8_t)rand();
-        cpu->variable_registers[register_index] = random_number & immediate_value;
-
-        logger_LogDebug(cpu->logger, "(0x%04X) - Set V%X to rand(%02X) & %02X.",
-                        instruction, register_index,
-                        random_number, immediate_value);
+    case 0x0000:
+    {
+        switch (opcode & 0x00FF)
+        {
+        case 0x00E0:
+            instruction->op = OP_00E0;
+            break;
+        case 0x00EE:
+            instruction->op = OP_00EE;
+            break;
+        case 0x00FB:
+            instruction->op = OP_00FB;
+            break;
+        case 0x00FC:
+            instruction->op = OP_00FC;
+            break;
+        case 0x00FE:
+            instruction->op = OP_00FE;
+            break;
+        case 0x00FF:
+            instruction->op = OP_00FF;
+            break;
+        default:
+            instruction->op = (opcode & 0x00F0) == 0x00C0 ? OP_00CN : OP_0NNN;
+            break;
+        }
         break;
     }
-    // 0xDXYN - Draw a sprite at (Vx, Vy) with 8 pixels width and N pixels height.
-    // Set Vf if any pixels are turned off(set to 0) when drawing.
-    case 0xD000:
+    case 0x1000:
+        instruction->op = OP_1NNN;
+        break;
+    case 0x2000:
+        instruction->op = OP_2NNN;
+        break;
+    case 0x3000:
+        instruction->op = OP_3XNN;
+        break;
+    case 0x4000:
+        instruction->op = OP_4XNN;
+        break;
+    case 0x5000:
+        instruction->op = OP_5XY0;
+        break;
+    case 0x6000:
+        instruction->op = OP_6XNN;
+        break;
+    case 0x7000:
+        instruction->op = OP_7XNN;
+        break;
+    case 0x8000:
     {
-        // Extract 8-bit register index(X).
-        uint8_t register_index_x = (instruction & 0x0F00) >> 8;
-        // Extract 8-bit register index(Y).
-        uint8_t register_index_y = (instruction & 0x00F0) >> 4;
-        // Extract height N.
-        uint8_t height = (instruction & 0x000F);
-
-        // We modulo by width/height so coordinate will wrap if it's past the width/height
-        // of the screen.
-        // Get X coordinate modulo 64.
-        uint8_t x_coord = cpu->variable_registers[register_index_x] % 64;
-        // Get Y coordinate module 32.
-        uint8_t y_coord = cpu->variable_registers[register_index_y] % 32;
-        // Set VF to 0 initially.
-        cpu->variable_registers[0xF] = 0;
-
-        // There are N rows of 8 bits in a sprite.
-        // The fonts, for example, are all 5 rows tall, which each row containing 8 bits/1 byte.
-
-        // If we turn off any pixels, we set this flag so we can set VF correctly.
-        bool turned_off = false;
-        // The index register points at the first row in the sprite.
-        // We should loop through all N rows without incrementing I, and draw it to the screen.
-        // We stop if we reach the bottom of the screen.
-        for (uint16_t i = 0; i < height && y_coord < cpu->display.display_buffer_height; i++)
+        switch (opcode & 0x000F)
         {
-            // Get row.
-            uint8_t row = cpu->memory[cpu->index_register + i];
-            // Set pixels in display buffer to bits in row.
-            if (SetPixels(cpu, x_coord, y_coord, row))
-                turned_off = true;
-            y_coord++;
+        case 0x0000:
+            instruction->op = OP_8XY0;
+            break;
+        case 0x0001:
+            instruction->op = OP_8XY1;
+            break;
+        case 0x0002:
+            instruction->op = OP_8XY2;
+            break;
+        case 0x0003:
+            instruction->op = OP_8XY3;
+            break;
+        case 0x0004:
+            instruction->op = OP_8XY4;
+            break;
+        case 0x0005:
+            instruction->op = OP_8XY5;
+            break;
+        case 0x0006:
+            instruction->op = OP_8XY6;
+            break;
+        case 0x0007:
+            instruction->op = OP_8XY7;
+            break;
+        case 0x000E:
+            instruction->op = OP_8XYE;
+            break;
+        default:
+            instruction->op = OP_NOT_IMPLEMENTED;
+            break;
         }
-
-        cpu->variable_registers[0xF] = turned_off;
-
-        logger_LogDebug(cpu->logger, "(0x%04X) - Draw sprite at (V%X(0x%02X), V%X(0x%02X)). Width: 8 pixels. Height: %d pixels. VF(0x%02X).",
-                        instruction, register_index_x, cpu->variable_registers[register_index_x],
-                        register_index_y, cpu->variable_registers[register_index_y],
-                        height, cpu->variable_registers[0xF]);
         break;
     }
-    // 0xEX__ - Both instructions here have register index X.
+    case 0x9000:
+        instruction->op = OP_9XY0;
+        break;
+    case 0xA000:
+        instruction->op = OP_ANNN;
+        break;
+    case 0xB000:
+        instruction->op = OP_BNNN;
+        break;
+    case 0xC000:
+        instruction->op = OP_CXNN;
+        break;
+    case 0xD000:
+        instruction->op = OP_DXYN;
+        break;
     case 0xE000:
     {
-        // Extract 4-bit register index(X).
-        uint8_t register_index = (instruction & 0x0F00) >> 8;
-
-        switch (instruction & 0x00FF)
+        switch (opcode & 0x00FF)
         {
-        // 0xEX9E - Skips next instruction if key stored in VX is pressed.
         case 0x009E:
-        {
-            uint16_t key_bit = (0x1 << cpu->variable_registers[register_index]);
-            // If key is pressed, increment PC by 2.
-            if (KeyPressed(cpu, key_bit))
-            {
-                cpu->program_counter += 2;
-            }
-            logger_LogDebug(cpu->logger, "(0x%04X) - Skip next instruction if key V%X(%02X) is pressed.",
-                            instruction, register_index, cpu->variable_registers[register_index]);
+            instruction->op = OP_EX9E;
             break;
-        }
-        // 0xEXA1 - Skips next instruction if key stored in VX is not pressed.
         case 0x00A1:
-        {
-            uint16_t key_bit = (0x1 << cpu->variable_registers[register_index]);
-            // If key is not pressed, increment PC by 2.
-            if (!KeyPressed(cpu, key_bit))
-            {
-                cpu->program_counter += 2;
-            }
-            logger_LogDebug(cpu->logger, "(0x%04X) - Skip next instruction if key V%X(%02X) is not pressed.",
-                            instruction, register_index, cpu->variable_registers[register_index]);
+            instruction->op = OP_EXA1;
             break;
-        }
         default:
-            logger_LogDebug(cpu->logger, "(0x%04X) - (NOT IMPLEMENTED).", instruction);
+            instruction->op = OP_NOT_IMPLEMENTED;
             break;
         }
+        break;
     }
-    // 0xFX__ - All instructions here have register index X.
     case 0xF000:
     {
-        // Extract 4-bit register index(X).
-        uint8_t register_index = (instruction & 0x0F00) >> 8;
-
-        switch (instruction & 0x00FF)
+        switch (opcode & 0x00FF)
         {
-        // 0xFX07 - Set VX to value in delay timer.
+        case 0x0000:
+            instruction->op = opcode == 0xF000 ? OP_F000 : OP_NOT_IMPLEMENTED;
+            break;
+        case 0x0001:
+            instruction->op = OP_FN01;
+            break;
+        case 0x0002:
+            instruction->op = opcode == 0xF002 ? OP_F002 : OP_NOT_IMPLEMENTED;
+            break;
         case 0x0007:
-        {
-            cpu->variable_registers[register_index] = cpu->delay_timer;
-            logger_LogDebug(cpu->logger, "(0x%04X) - Set V%X to delay timer(%02X).",
-                            instruction, register_index, cpu->delay_timer);
+            instruction->op = OP_FX07;
             break;
-        }
-        // 0xFX0A - Wait for keypress and assign it to VX.
         case 0x000A:
-        {
-            uint8_t key_pressed = WaitKeyPressed(cpu);
-            cpu->variable_registers[register_index] = key_pressed;
-            logger_LogDebug(cpu->logger, "(0x%04X) - Waited for keypress. Key %02X pressed and stored in V%X.",
-                            instruction, key_pressed, register_index);
+            instruction->op = OP_FX0A;
             break;
-        }
-        // 0xFX15 - Sets delay timer to VX.
         case 0x0015:
-        {
-            // Set delay timer.
-            cpu->delay_timer = cpu->variable_registers[register_index];
-            logger_LogDebug(cpu->logger, "(0x%04X) - Set delay timer to V%X(%02X).",
-                            instruction, register_index, cpu->variable_registers[register_index]);
+            instruction->op = OP_FX15;
             break;
-        }
-        // 0xFX18 - Sets sound timer to VX.
         case 0x0018:
-        {
-            // Set sound timer.
-            cpu->sound_timer = cpu->variable_registers[register_index];
-
-            logger_LogDebug(cpu->logger, "(0x%04X) - Set sound timer to V%X(%02X).",
-                            instruction, register_index, cpu->variable_registers[register_index]);
+            instruction->op = OP_FX18;
             break;
-        }
-        // 0xFX1E - Add VX to I.
-        // VF is not affected.
         case 0x001E:
-        {
-            // Add VX to I.
-            cpu->index_register += cpu->variable_registers[register_index];
-
-            logger_LogDebug(cpu->logger, "(0x%04X) - Add V%X(%02X) to I.",
-                            instruction, register_index, cpu->variable_registers[register_index]);
+            instruction->op = OP_FX1E;
             break;
-        }
-        // 0xFX29 - Set I to location of sprite indexed by VX.
         case 0x0029:
-        {
-            uint16_t sprite_addr = cpu->memory[cpu->font_start_address + (5 * cpu->variable_registers[register_index])];
-            cpu->index_register = sprite_addr;
-            logger_LogDebug(cpu->logger, "(0x%04X) - Set I to address(%04X) of sprite V%X(%02X).",
-                            instruction, sprite_addr, register_index, cpu->variable_registers[register_index]);
+            instruction->op = OP_FX29;
+            break;
+        case 0x0030:
+            instruction->op = OP_FX30;
             break;
-        }
-        // 0xFX33 - Store the binary-coded decimal of VX with the
-        //          100-place at I, 10-place at I+1 and 1-place at I+2.
         case 0x0033:
-        {
-            // 100-place
-            uint8_t binary = cpu->variable_registers[register_index];
-            uint8_t modulo = binary % 100;
-            uint8_t result = (binary - modulo) / 100;
-            cpu->memory[cpu->index_register] = result;
-            // 10-place
-            binary = modulo;
-            modulo = binary % 10;
-            result = (binary - modulo) / 10;
-            cpu->memory[cpu->index_register + 1] = result;
-            // 1-place
-            cpu->memory[cpu->index_register + 2] = modulo;
-            logger_LogDebug(cpu->logger, "(0x%04X) - Store BCD of V%X(%02X) starting at address I(%04X).",
-                            instruction, register_index, cpu->variable_registers[register_index], cpu->index_register);
+            instruction->op = OP_FX33;
+            break;
+        case 0x003A:
+            instruction->op = OP_FX3A;
             break;
-        }
-        // 0xFX55 - Store V0-VX in memory starting at address I.
         case 0x0055:
-        {
-            for (uint8_t i = 0; i <= register_index; i++)
-            {
-                cpu->memory[cpu->index_register + i] = cpu->variable_registers[i];
-            }
-            logger_LogDebug(cpu->logger, "(0x%04X) - Storing registers V0-V%X in memory starting at address I(%04X).",
-                            instruction, register_index, cpu->index_register);
+            instruction->op = OP_FX55;
             break;
-        }
-        // 0xFX65 - Loads V0-VX from memory starting at address I.
         case 0x0065:
-        {
-            for (uint8_t i = 0; i <= register_index; i++)
-            {
-                cpu->variable_registers[i] = cpu->memory[cpu->index_register + i];
-            }
-            logger_LogDebug(cpu->logger, "(0x%04X) - Loading registers V0-V%X from memory starting at address I(%04X).",
-                            instruction, register_index, cpu->index_register);
+            instruction->op = OP_FX65;
             break;
-        }
         default:
-            logger_LogDebug(cpu->logger, "(0x%04X) - (NOT IMPLEMENTED).\n", instruction);
+            instruction->op = OP_NOT_IMPLEMENTED;
             break;
         }
+        break;
     }
     default:
-        logger_LogDebug(cpu->logger, "(0x%04X) - (NOT IMPLEMENTED).\n", instruction);
+        instruction->op = OP_NOT_IMPLEMENTED;
         break;
     }
+
+    instruction->handler = instruction_handlers[instruction->op];
 }
 
-bool SetPixel(CPUState *cpu, uint8_t x, uint8_t y, uint8_t pixel_value)
+#ifdef CH8_THREADED_DISPATCH
+// Direct-threaded variant of CycleCPU. Every handler ends in its own indirect jump to the next
+// handler, so the branch predictor sees one jump site per opcode instead of a single shared one.
+// Relies on GCC/Clang labels-as-values.
+void RunThreaded(CPUState *cpu, uint64_t n_cycles)
 {
-    if (x >= cpu->display.display_buffer_width || y >= cpu->display.display_buffer_height)
-        return false;
+    static void *const labels[OP_COUNT] = {
+        [OP_DECODE] = &&op_decode,
+        [OP_00E0] = &&op_00E0,
+        [OP_00EE] = &&op_00EE,
+        [OP_00CN] = &&op_00CN,
+        [OP_00FB] = &&op_00FB,
+        [OP_00FC] = &&op_00FC,
+        [OP_00FE] = &&op_00FE,
+        [OP_00FF] = &&op_00FF,
+        [OP_0NNN] = &&op_0NNN,
+        [OP_1NNN] = &&op_1NNN,
+        [OP_2NNN] = &&op_2NNN,
+        [OP_3XNN] = &&op_3XNN,
+        [OP_4XNN] = &&op_4XNN,
+        [OP_5XY0] = &&op_5XY0,
+        [OP_6XNN] = &&op_6XNN,
+        [OP_7XNN] = &&op_7XNN,
+        [OP_8XY0] = &&op_8XY0,
+        [OP_8XY1] = &&op_8XY1,
+        [OP_8XY2] = &&op_8XY2,
+        [OP_8XY3] = &&op_8XY3,
+        [OP_8XY4] = &&op_8XY4,
+        [OP_8XY5] = &&op_8XY5,
+        [OP_8XY6] = &&op_8XY6,
+        [OP_8XY7] = &&op_8XY7,
+        [OP_8XYE] = &&op_8XYE,
+        [OP_9XY0] = &&op_9XY0,
+        [OP_ANNN] = &&op_ANNN,
+        [OP_BNNN] = &&op_BNNN,
+        [OP_CXNN] = &&op_CXNN,
+        [OP_DXYN] = &&op_DXYN,
+        [OP_EX9E] = &&op_EX9E,
+        [OP_EXA1] = &&op_EXA1,
+        [OP_F000] = &&op_F000,
+        [OP_FN01] = &&op_FN01,
+        [OP_F002] = &&op_F002,
+        [OP_FX07] = &&op_FX07,
+        [OP_FX0A] = &&op_FX0A,
+        [OP_FX15] = &&op_FX15,
+        [OP_FX18] = &&op_FX18,
+        [OP_FX1E] = &&op_FX1E,
+        [OP_FX29] = &&op_FX29,
+        [OP_FX30] = &&op_FX30,
+        [OP_FX33] = &&op_FX33,
+        [OP_FX3A] = &&op_FX3A,
+        [OP_FX55] = &&op_FX55,
+        [OP_FX65] = &&op_FX65,
+        [OP_NOT_IMPLEMENTED] = &&op_NotImplemented,
+    };
+
+    const DecodedInstruction *instruction;
+    // Instructions at odd addresses are decoded into here and never cached.
+    DecodedInstruction uncached;
+    // The machine can't change while running, so neither can the size of memory.
+    const uint16_t mask = cpu->memory_size - 1;
+
+#define DISPATCH()                                                                        \
+    do                                                                                    \
+    {                                                                                     \
+        if (n_cycles-- == 0)                                                              \
+            return;                                                                       \
+        uint16_t address = cpu->program_counter;                                          \
+        cpu->program_counter = (address + 2) & mask;                                      \
+        if (address & 0x1)                                                                \
+        {                                                                                 \
+            core_DecodeInstruction(PEEK_16BIT(cpu->memory, address, mask), &uncached);    \
+            instruction = &uncached;                                                      \
+        }                                                                                 \
+        else                                                                              \
+        {                                                                                 \
+            instruction = &cpu->decode_cache[(address >> 1) & (CH8_DECODE_CACHE_SIZE - 1)]; \
+        }                                                                                 \
+        goto *labels[instruction->op];                                                    \
+    } while (0)
+
+#define THREADED_OP(name)               \
+    op_##name : Op##name(cpu, instruction); \
+    DISPATCH();
+
+    DISPATCH();
+
+op_decode:
+{
+    // Only cache entries are ever undecoded. Decode in place and jump straight to the result.
+    size_t index = instruction - cpu->decode_cache;
+    uint16_t address = index << 1;
+    DecodedInstruction *entry = &cpu->decode_cache[index];
+    core_DecodeInstruction(PEEK_16BIT(cpu->memory, address, cpu->memory_size - 1), entry);
+    goto *labels[entry->op];
+}
 
-    // This is set to true if we turn of any pixels and returned in the end.
-    bool turned_off = false;
+    THREADED_OP(00E0)
+    THREADED_OP(00EE)
+    THREADED_OP(00CN)
+    THREADED_OP(00FB)
+    THREADED_OP(00FC)
+    THREADED_OP(00FE)
+    THREADED_OP(00FF)
+    THREADED_OP(0NNN)
+    THREADED_OP(1NNN)
+    THREADED_OP(2NNN)
+    THREADED_OP(3XNN)
+    THREADED_OP(4XNN)
+    THREADED_OP(5XY0)
+    THREADED_OP(6XNN)
+    THREADED_OP(7XNN)
+    THREADED_OP(8XY0)
+    THREADED_OP(8XY1)
+    THREADED_OP(8XY2)
+    THREADED_OP(8XY3)
+    THREADED_OP(8XY4)
+    THREADED_OP(8XY5)
+    THREADED_OP(8XY6)
+    THREADED_OP(8XY7)
+    THREADED_OP(8XYE)
+    THREADED_OP(9XY0)
+    THREADED_OP(ANNN)
+    THREADED_OP(BNNN)
+    THREADED_OP(CXNN)
+    THREADED_OP(DXYN)
+    THREADED_OP(EX9E)
+    THREADED_OP(EXA1)
+    THREADED_OP(F000)
+    THREADED_OP(FN01)
+    THREADED_OP(F002)
+    THREADED_OP(FX07)
+    THREADED_OP(FX0A)
+    THREADED_OP(FX15)
+    THREADED_OP(FX18)
+    THREADED_OP(FX1E)
+    THREADED_OP(FX29)
+    THREADED_OP(FX30)
+    THREADED_OP(FX33)
+    THREADED_OP(FX3A)
+    THREADED_OP(FX55)
+    THREADED_OP(FX65)
+    THREADED_OP(NotImplemented)
+
+#undef THREADED_OP
+#undef DISPATCH
+}
+#endif
+
+void DecodeAndExecute(CPUState *cpu, const DecodedInstruction *instruction)
+{
+    // 'instruction' is the cache entry itself. Decode into it and execute.
+    size_t index = instruction - cpu->decode_cache;
+    uint16_t address = index << 1;
+    DecodedInstruction *entry = &cpu->decode_cache[index];
+    core_DecodeInstruction(PEEK_16BIT(cpu->memory, address, cpu->memory_size - 1), entry);
+    entry->handler(cpu, entry);
+}
+
+void InvalidateDecoded(CPUState *cpu, uint16_t address, size_t size)
+{
+    // Writes through I wrap around the end of memory. Drop the wrapped part as well.
+    if (address < cpu->memory_size && address + size > cpu->memory_size)
+    {
+        InvalidateDecoded(cpu, 0, address + size - cpu->memory_size);
+        size = cpu->memory_size - address;
+    }
+
+    // An entry at an even address covers two bytes, so include the entry overlapping 'address'.
+    size_t first = address >> 1;
+    size_t last = (address + size + 1) >> 1;
+    if (last > CH8_DECODE_CACHE_SIZE)
+        last = CH8_DECODE_CACHE_SIZE;
 
-    // index * 4 because we index as if it's one byte per pixel, but actually it's 4(RGBA).
-    size_t actual_index = ((y * cpu->display.display_buffer_width) + x) * cpu->display.display_buffer_channels;
-    // Set RGB. A is always set to 0xFF.
-    // Since we always set all channels at the same time, we only need to check the first channel
-    // to see if we turn off the pixel.
-    size_t actual_value = pixel_value == 1 ? 0xFF : 0x00;
-    if (cpu->display.display_buffer[actual_index] == actual_value && actual_value == 0xFF)
+    for (size_t i = first; i < last; i++)
     {
-        actual_value = 0x00;
-        turned_off = true;
+        cpu->decode_cache[i].op = OP_DECODE;
+        cpu->decode_cache[i].handler = DecodeAndExecute;
     }
-    cpu->display.display_buffer[actual_index] = actual_value;
-    cpu->display.display_buffer[actual_index + 1] = actual_value;
-    cpu->display.display_buffer[actual_index + 2] = actual_value;
 
-    return turned_off;
+    if (cpu->jit)
+    {
+        jit_Invalidate(cpu->jit, address, size);
+    }
 }
 
-bool SetPixels(CPUState *cpu, uint8_t x, uint8_t y, uint8_t pixels)
+// Switching resolution clears the screen, as on SUPER-CHIP 1.1 and later. Every plane is cleared,
+// whatever is selected.
+void SetDisplayHires(CPUState *cpu, bool hires)
 {
-    assert(x < cpu->display.display_buffer_width);
-    assert(y < cpu->display.display_buffer_height);
+    cpu->display.hires = hires;
+    memset(cpu->display.planes, 0, sizeof(cpu->display.planes));
+    cpu->display.plane_mask = cpu->display.selected_planes;
+    cpu->display.dirty_rows = UINT64_MAX;
+}
 
-    // This is set to true if we turn of any pixels and returned in the end.
-    bool turned_off = false;
+// Steps over the instruction at PC. XO-CHIP's F000 NNNN is the only one taking 4 bytes.
+void SkipNextInstruction(CPUState *cpu)
+{
+    uint16_t mask = cpu->memory_size - 1;
+    uint16_t address = cpu->program_counter & mask;
+    if (cpu->machine == CPU_MACHINE_XOCHIP && PEEK_16BIT(cpu->memory, address, mask) == 0xF000)
+    {
+        address += 2;
+    }
+    cpu->program_counter = (address + 2) & mask;
+}
 
-    // Loop through each bit in 'pixels'.
-    for (uint8_t i = 0; i < 8; i++)
+// 0x00E0 - Clear screen.
+void Op00E0(CPUState *cpu, const DecodedInstruction *instruction)
+{
+    // Set every pixel of the selected planes to 0. Words past the lores rows are already blank in lores.
+    for (size_t plane = 0; plane < CH8_DISPLAY_PLANE_COUNT; plane++)
     {
-        uint8_t mask = 1 << (7 - i);
-        uint8_t pixel_value = (pixels & mask) >> (7 - i);
-        // If the pixel is turned off, we must return it.
-        if (SetPixel(cpu, x + i, y, pixel_value))
-            turned_off = true;
+        if (cpu->display.selected_planes & (1u << plane))
+            memset(cpu->display.planes[plane], 0, cpu->display.hires ? CH8_DISPLAY_HIRES_ROWS_SIZE : CH8_DISPLAY_LORES_ROWS_SIZE);
     }
+    cpu->display.dirty_rows = UINT64_MAX;
+    LOGGER_TRACE_DEBUG(cpu->logger, "(0x%04X) - Clear screen.", instruction->opcode);
+}
 
-    return turned_off;
+// 0x00EE - Return.
+void Op00EE(CPUState *cpu, const DecodedInstruction *instruction)
+{
+    // Pop previous PC of stack and set current PC.
+    uint16_t pc;
+    if (!PopStack(cpu, &pc))
+    {
+        StackFault(cpu, instruction, "Return with an empty stack.");
+        return;
+    }
+    cpu->program_counter = pc;
+    LOGGER_TRACE_DEBUG(cpu->logger, "(0x%04X) - Return.", instruction->opcode);
 }
 
-void SetAlpha(CPUState *cpu, uint8_t x, uint8_t y, uint8_t alpha_value)
+// 0x00CN - Scroll the selected planes down N rows. SUPER-CHIP.
+void Op00CN(CPUState *cpu, const DecodedInstruction *instruction)
 {
-    assert(x < cpu->display.display_buffer_width);
-    assert(y < cpu->display.display_buffer_height);
+    // Each word column is contiguous, so scrolling down is one move per column.
+    size_t height = cpu->display.hires ? CH8_DISPLAY_HIRES_HEIGHT : CH8_DISPLAY_HEIGHT;
+    size_t words = cpu->display.hires ? CH8_DISPLAY_ROW_WORDS : 1;
+    size_t n = instruction->n;
+    for (size_t plane = 0; plane < CH8_DISPLAY_PLANE_COUNT; plane++)
+    {
+        if (!(cpu->display.selected_planes & (1u << plane)))
+            continue;
+        for (size_t word = 0; word < words; word++)
+        {
+            uint64_t *column = cpu->display.planes[plane][word];
+            memmove(column + n, column, (height - n) * sizeof(uint64_t));
+            memset(column, 0, n * sizeof(uint64_t));
+        }
+    }
+    cpu->display.dirty_rows = UINT64_MAX;
+    LOGGER_TRACE_DEBUG(cpu->logger, "(0x%04X) - Scroll down %d rows.", instruction->opcode, instruction->n);
+}
 
-    // index * 4 because we index as if it's one byte per pixel, but actually it's 4(RGBA).
-    size_t actual_index = ((y * cpu->display.display_buffer_width) + x) * cpu->display.display_buffer_channels;
-    // Set RGB. A is always set to 0xFF.
-    cpu->display.display_buffer[actual_index + 3] = alpha_value;
+// 0x00FB - Scroll the selected planes right 4 pixels. SUPER-CHIP.
+void Op00FB(CPUState *cpu, const DecodedInstruction *instruction)
+{
+    // Shift whole words. In hires the pixels leaving word 0 carry into word 1.
+    for (size_t plane = 0; plane < CH8_DISPLAY_PLANE_COUNT; plane++)
+    {
+        if (!(cpu->display.selected_planes & (1u << plane)))
+            continue;
+        uint64_t (*rows)[CH8_DISPLAY_HIRES_HEIGHT] = cpu->display.planes[plane];
+        if (cpu->display.hires)
+        {
+            for (size_t y = 0; y < CH8_DISPLAY_HIRES_HEIGHT; y++)
+            {
+                rows[1][y] = (rows[1][y] >> 4) | (rows[0][y] << 60);
+                rows[0][y] >>= 4;
+            }
+        }
+        else
+        {
+            for (size_t y = 0; y < CH8_DISPLAY_HEIGHT; y++)
+                rows[0][y] >>= 4;
+        }
+    }
+    cpu->display.dirty_rows = UINT64_MAX;
+    LOGGER_TRACE_DEBUG(cpu->logger, "(0x%04X) - Scroll right 4 pixels.", instruction->opcode);
 }
 
-bool KeyPressed(CPUState *cpu, uint16_t key_bit)
+// 0x00FC - Scroll the selected planes left 4 pixels. SUPER-CHIP.
+void Op00FC(CPUState *cpu, const DecodedInstruction *instruction)
 {
-    return cpu->keys & key_bit;
+    // Lores rows have an empty word 1, so the hires shift works for both.
+    size_t height = cpu->display.hires ? CH8_DISPLAY_HIRES_HEIGHT : CH8_DISPLAY_HEIGHT;
+    for (size_t plane = 0; plane < CH8_DISPLAY_PLANE_COUNT; plane++)
+    {
+        if (!(cpu->display.selected_planes & (1u << plane)))
+            continue;
+        uint64_t (*rows)[CH8_DISPLAY_HIRES_HEIGHT] = cpu->display.planes[plane];
+        for (size_t y = 0; y < height; y++)
+        {
+            rows[0][y] = (rows[0][y] << 4) | (rows[1][y] >> 60);
+            rows[1][y] <<= 4;
+        }
+    }
+    cpu->display.dirty_rows = UINT64_MAX;
+    LOGGER_TRACE_DEBUG(cpu->logger, "(0x%04X) - Scroll left 4 pixels.", instruction->opcode);
+}
+
+// 0x00FE - Switch to 64x32 lores. SUPER-CHIP.
+void Op00FE(CPUState *cpu, const DecodedInstruction *instruction)
+{
+    SetDisplayHires(cpu, false);
+    LOGGER_TRACE_DEBUG(cpu->logger, "(0x%04X) - Switch to lores.", instruction->opcode);
+}
+
+// 0x00FF - Switch to 128x64 hires. SUPER-CHIP.
+void Op00FF(CPUState *cpu, const DecodedInstruction *instruction)
+{
+    SetDisplayHires(cpu, true);
+    LOGGER_TRACE_DEBUG(cpu->logger, "(0x%04X) - Switch to hires.", instruction->opcode);
+}
+
+// 0x0NNN - Ignored as we're not running on a machine with actual chip-8 support.
+void Op0NNN(CPUState *cpu, const DecodedInstruction *instruction)
+{
+    LOGGER_TRACE_DEBUG(cpu->logger, "(0x%04X) - Call machine code routine(NOT IMPLEMENTED).", instruction->opcode);
+}
+
+// 0x1NNN - Jump to NNN.
+void Op1NNN(CPUState *cpu, const DecodedInstruction *instruction)
+{
+    // Set PC.
+    cpu->program_counter = instruction->nnn;
+    LOGGER_TRACE_DEBUG(cpu->logger, "(0x%04X) - Jump to 0x%04X.", instruction->opcode, instruction->nnn);
+}
+
+// 0x2NNN - Call subroutine at address NNN.
+void Op2NNN(CPUState *cpu, const DecodedInstruction *instruction)
+{
+    // Push current PC on stack.
+    if (!PushStack(cpu, cpu->program_counter))
+    {
+        StackFault(cpu, instruction, "Call with a full stack.");
+        return;
+    }
+    // Set PC to NNN.
+    cpu->program_counter = instruction->nnn;
+    LOGGER_TRACE_DEBUG(cpu->logger, "(0x%04X) - Call subroutine at address %04X.", instruction->opcode, instruction->nnn);
+}
+
+// 0x3XNN - Skips next instruction if Vx == NN.
+void Op3XNN(CPUState *cpu, const DecodedInstruction *instruction)
+{
+    uint8_t x = instruction->x;
+    // Skip next instruction if VX == NN.
+    if (cpu->variable_registers[x] == instruction->nn)
+    {
+        SkipNextInstruction(cpu);
+    }
+    LOGGER_TRACE_DEBUG(cpu->logger, "(0x%04X) - Skip next instruction if (V%X(%02X) == %02X)(%s).",
+                    instruction->opcode, x, cpu->variable_registers[x], instruction->nn,
+                    cpu->variable_registers[x] == instruction->nn ? "true" : "false");
+}
+
+// 0x4XNN - Skips next instruction if VX != NN.
+void Op4XNN(CPUState *cpu, const DecodedInstruction *instruction)
+{
+    uint8_t x = instruction->x;
+    // Skip next instruction if VX != NN.
+    if (cpu->variable_registers[x] != instruction->nn)
+    {
+        SkipNextInstruction(cpu);
+    }
+    LOGGER_TRACE_DEBUG(cpu->logger, "(0x%04X) - Skip next instruction if (V%X(%02X) != %02X)(%s).",
+                    instruction->opcode, x, cpu->variable_registers[x], instruction->nn,
+                    cpu->variable_registers[x] != instruction->nn ? "true" : "false");
+}
+
+// 0x5XY0 - Skips next instruction if VX == VY.
+void Op5XY0(CPUState *cpu, const DecodedInstruction *instruction)
+{
+    uint8_t x = instruction->x;
+    uint8_t y = instruction->y;
+    // Skip next instruction if VX == VY.
+    if (cpu->variable_registers[x] == cpu->variable_registers[y])
+    {
+        SkipNextInstruction(cpu);
+    }
+    LOGGER_TRACE_DEBUG(cpu->logger, "(0x%04X) - Skip next instruction if (V%X(%02X) == V%X(%02X))(%s).",
+                    instruction->opcode, x, cpu->variable_registers[x],
+                    y, cpu->variable_registers[y],
+                    cpu->variable_registers[x] == cpu->variable_registers[y] ? "true" : "false");
+}
+
+// 0x6XNN - Set Vx to NN.
+void Op6XNN(CPUState *cpu, const DecodedInstruction *instruction)
+{
+    // Set Vx.
+    cpu->variable_registers[instruction->x] = instruction->nn;
+    LOGGER_TRACE_DEBUG(cpu->logger, "(0x%04X) - Set V%X to 0x%02X.", instruction->opcode, instruction->x, instruction->nn);
+}
+
+// 0x7XNN - Add NN to Vx.
+void Op7XNN(CPUState *cpu, const DecodedInstruction *instruction)
+{
+    // Add to Vx.
+    cpu->variable_registers[instruction->x] += instruction->nn;
+    LOGGER_TRACE_DEBUG(cpu->logger, "(0x%04X) - Add 0x%02X to V%X.", instruction->opcode, instruction->nn, instruction->x);
+}
+
+// 0x8XY0 - Set VX to VY.
+void Op8XY0(CPUState *cpu, const DecodedInstruction *instruction)
+{
+    uint8_t x = instruction->x;
+    uint8_t y = instruction->y;
+    // Set VX to VY.
+    cpu->variable_registers[x] = cpu->variable_registers[y];
+    LOGGER_TRACE_DEBUG(cpu->logger, "(0x%04X) - Set V%X to V%X(%02X).",
+                    instruction->opcode, x, y, cpu->variable_registers[y]);
+}
+
+// 0x8XY1 - Set VX to VX | VY.
+void Op8XY1(CPUState *cpu, const DecodedInstruction *instruction)
+{
+    uint8_t x = instruction->x;
+    uint8_t y = instruction->y;
+    cpu->variable_registers[x] |= cpu->variable_registers[y];
+    LOGGER_TRACE_DEBUG(cpu->logger, "(0x%04X) - Set V%X to V%X(%02X) | V%X(%02X).",
+                    instruction->opcode, x,
+                    x, cpu->variable_registers[x],
+                    y, cpu->variable_registers[y]);
+}
+
+// 0x8XY2 - Set VX to VX & VY.
+void Op8XY2(CPUState *cpu, const DecodedInstruction *instruction)
+{
+    uint8_t x = instruction->x;
+    uint8_t y = instruction->y;
+    cpu->variable_registers[x] &= cpu->variable_registers[y];
+    LOGGER_TRACE_DEBUG(cpu->logger, "(0x%04X) - Set V%X to V%X(%02X) & V%X(%02X).",
+                    instruction->opcode, x,
+                    x, cpu->variable_registers[x],
+                    y, cpu->variable_registers[y]);
+}
+
+// 0x8XY3 - Set VX to VX ^ VY.
+void Op8XY3(CPUState *cpu, const DecodedInstruction *instruction)
+{
+    uint8_t x = instruction->x;
+    uint8_t y = instruction->y;
+    cpu->variable_registers[x] ^= cpu->variable_registers[y];
+    LOGGER_TRACE_DEBUG(cpu->logger, "(0x%04X) - Set V%X to V%X(%02X) ^ V%X(%02X).",
+                    instruction->opcode, x,
+                    x, cpu->variable_registers[x],
+                    y, cpu->variable_registers[y]);
+}
+
+// 0x8XY4 - Add VY to VX.
+// Set VF if overflow.
+void Op8XY4(CPUState *cpu, const DecodedInstruction *instruction)
+{
+    uint8_t x = instruction->x;
+    uint8_t y = instruction->y;
+    // We need to use a uint16_t here to be able to check for overflow.
+    uint16_t result = cpu->variable_registers[x] + cpu->variable_registers[y];
+    // Initially, we set overflow to 0.
+    cpu->variable_registers[0xF] = 0;
+    // If there is overflow, we set it to 1.
+    if (result > 0xFF)
+        cpu->variable_registers[0xF] = 1;
+    // Either way, we will store the first byte of result in VX.
+    cpu->variable_registers[x] = result & 0xFF;
+
+    LOGGER_TRACE_DEBUG(cpu->logger, "(0x%04X) - Add V%X(%02X) to V%X - VF(%02X).",
+                    instruction->opcode, y, cpu->variable_registers[y],
+                    x, cpu->variable_registers[0xF]);
+}
+
+// 0x8XY5 - Subtract VY from VX.
+// Set VF if not underflow.
+void Op8XY5(CPUState *cpu, const DecodedInstruction *instruction)
+{
+    uint8_t x = instruction->x;
+    uint8_t y = instruction->y;
+    // Check underflow.
+    uint8_t underflow = cpu->variable_registers[x] < cpu->variable_registers[y] ? 1 : 0;
+    // Set VX.
+    cpu->variable_registers[x] -= cpu->variable_registers[y];
+    // Set underflow.
+    cpu->variable_registers[0xF] = !underflow;
+
+    LOGGER_TRACE_DEBUG(cpu->logger, "(0x%04X) - Sub V%X(%02X) from V%X - VF(%02X).",
+                    instruction->opcode, y, cpu->variable_registers[y],
+                    x, cpu->variable_registers[0xF]);
+}
+
+// 0x8XY6 - Right-shift VX by 1.
+// Stores least significant bit in VF prior to shift.
+void Op8XY6(CPUState *cpu, const DecodedInstruction *instruction)
+{
+    uint8_t x = instruction->x;
+    // Store least significant bit in VF prior to shift.
+    cpu->variable_registers[0xF] = cpu->variable_registers[x] & 0x01;
+    // Right-shift VX by 1.
+    cpu->variable_registers[x] >>= 1;
+
+    LOGGER_TRACE_DEBUG(cpu->logger, "(0x%04X) -  V%X(%02X) >> 1 - VF(%02X).",
+                    instruction->opcode, x, cpu->variable_registers[x],
+                    cpu->variable_registers[0xF]);
+}
+
+// 0x8XY7 - Set VX to VY - VX.
+// Set VF if not underflow.
+void Op8XY7(CPUState *cpu, const DecodedInstruction *instruction)
+{
+    uint8_t x = instruction->x;
+    uint8_t y = instruction->y;
+    // Check underflow.
+    uint8_t underflow = cpu->variable_registers[y] < cpu->variable_registers[x] ? 1 : 0;
+    // Set VX.
+    cpu->variable_registers[x] = cpu->variable_registers[y] - cpu->variable_registers[x];
+    // Set underflow.
+    cpu->variable_registers[0xF] = !underflow;
+
+    LOGGER_TRACE_DEBUG(cpu->logger, "(0x%04X) - Set V%X to V%X(%02X) - V%X(%02X) - VF(%02X).",
+                    instruction->opcode, x,
+                    y, cpu->variable_registers[y],
+                    x, cpu->variable_registers[x],
+                    cpu->variable_registers[0xF]);
+}
+
+// 0x8XYE - Left-shift VX by 1.
+// Stores most significant bit in VF prior to shift.
+void Op8XYE(CPUState *cpu, const DecodedInstruction *instruction)
+{
+    uint8_t x = instruction->x;
+    // Store most significant bit in VF prior to shift.
+    cpu->variable_registers[0xF] = (cpu->variable_registers[x] >> 7) & 0x01;
+    // Left-shift VX by 1.
+    cpu->variable_registers[x] <<= 1;
+
+    LOGGER_TRACE_DEBUG(cpu->logger, "(0x%04X) -  V%X(%02X) << 1 - VF(%02X).",
+                    instruction->opcode, x, cpu->variable_registers[x],
+                    cpu->variable_registers[0xF]);
+}
+
+// 0x9XY0 - Skips next instruction if VX != VY.
+void Op9XY0(CPUState *cpu, const DecodedInstruction *instruction)
+{
+    uint8_t x = instruction->x;
+    uint8_t y = instruction->y;
+    // Skip next instruction if VX != VY.
+    if (cpu->variable_registers[x] != cpu->variable_registers[y])
+    {
+        SkipNextInstruction(cpu);
+    }
+    LOGGER_TRACE_DEBUG(cpu->logger, "(0x%04X) - Skip next instruction if (V%X(%02X) != V%X(%02X))(%s).",
+                    instruction->opcode, x, cpu->variable_registers[x],
+                    y, cpu->variable_registers[y],
+                    cpu->variable_registers[x] != cpu->variable_registers[y] ? "true" : "false");
+}
+
+// 0xANNN - Set index register(I) to NNN.
+void OpANNN(CPUState *cpu, const DecodedInstruction *instruction)
+{
+    // Set I.
+    cpu->index_register = instruction->nnn;
+    LOGGER_TRACE_DEBUG(cpu->logger, "(0x%04X) - Set I to 0x%04X.", instruction->opcode, instruction->nnn);
+}
+
+// 0xBNNN - Jump to address V0 + NNN.
+void OpBNNN(CPUState *cpu, const DecodedInstruction *instruction)
+{
+    // Set PC to V0 + NNN.
+    cpu->program_counter = (cpu->variable_registers[0x0] + instruction->nnn) & (cpu->memory_size - 1);
+
+    LOGGER_TRACE_DEBUG(cpu->logger, "(0x%04X) - Jump to V0(%02X) + 0x%04X.",
+                    instruction->opcode, cpu->variable_registers[0x0], instruction->nnn);
+}
+
+// 0xCXNN - Set VX to bitwise-and between random number and NN.
+void OpCXNN(CPUState *cpu, const DecodedInstruction *instruction)
+{
+    // Set VX to bitwise-and between random number and NN.
+    uint8_t random_number = (uint8_t)(NextRandomState(&cpu->random_state) >> 56);
+    cpu->variable_registers[instruction->x] = random_number & instruction->nn;
+
+    LOGGER_TRACE_DEBUG(cpu->logger, "(0x%04X) - Set V%X to rand(%02X) & %02X.",
+                    instruction->opcode, instruction->x,
+                    random_number, instruction->nn);
+}
+
+// 0xDXYN - Draw a sprite at (Vx, Vy) with 8 pixels width and N pixels height.
+// 0xDXY0 - Draw a 16x16 sprite at (Vx, Vy). SUPER-CHIP.
+void OpDXYN(CPUState *cpu, const DecodedInstruction *instruction)
+{
+    uint8_t x = instruction->x;
+    uint8_t y = instruction->y;
+    bool hires = cpu->display.hires;
+    bool large = instruction->n == 0;
+    uint8_t height = large ? 16 : instruction->n;
+    uint8_t screen_width = hires ? CH8_DISPLAY_HIRES_WIDTH : CH8_DISPLAY_WIDTH;
+    uint8_t screen_height = hires ? CH8_DISPLAY_HIRES_HEIGHT : CH8_DISPLAY_HEIGHT;
+    uint16_t memory_mask = cpu->memory_size - 1;
+
+    // We modulo by width/height so coordinate will wrap if it's past the width/height
+    // of the screen. Both are powers of two.
+    uint8_t x_coord = cpu->variable_registers[x] & (screen_width - 1);
+    uint8_t y_coord = cpu->variable_registers[y] & (screen_height - 1);
+
+    // There are N rows of 8 bits in a sprite, or 16 rows of 16 bits for 0xDXY0.
+    // The fonts, for example, are all 5 rows tall, which each row containing 8 bits/1 byte.
+
+    // Bits of the sprite that hit a lit pixel. Any hit means a pixel was turned off.
+    uint64_t collisions = 0;
+    uint64_t dirty_rows = 0;
+    // The index register points at the first row in the sprite.
+    // We should loop through all rows without incrementing I, and draw it to the screen.
+    uint16_t address = cpu->index_register;
+    if (!hires && !large && cpu->machine == CPU_MACHINE_CHIP8)
+    {
+        // Plain CHIP-8 sprites: one byte per row, one word per row, plane 0 only. We stop if we
+        // reach the bottom of the screen. Pixels past the right edge are shifted out.
+        uint64_t (*rows)[CH8_DISPLAY_HIRES_HEIGHT] = cpu->display.planes[0];
+        uint8_t first_row = y_coord;
+        for (uint16_t i = 0; i < height && y_coord < CH8_DISPLAY_HEIGHT; i++, y_coord++)
+        {
+            uint64_t sprite = ((uint64_t)cpu->memory[(address + i) & (CH8_MEM_SIZE - 1)] << 56) >> x_coord;
+            collisions |= rows[0][y_coord] & sprite;
+            rows[0][y_coord] ^= sprite;
+        }
+        // Rows [first_row, y_coord) were drawn to. At most 15, so the shift can't overflow.
+        dirty_rows = ((1ULL << (y_coord - first_row)) - 1) << first_row;
+    }
+    else
+    {
+        // SUPER-CHIP clips sprites at the bottom and right edges. XO-CHIP wraps them around.
+        bool wrap = cpu->machine == CPU_MACHINE_XOCHIP;
+        // Each selected plane takes the next rows of sprite data, plane 0 first.
+        for (size_t plane = 0; plane < CH8_DISPLAY_PLANE_COUNT; plane++)
+        {
+            if (!(cpu->display.selected_planes & (1u << plane)))
+                continue;
+
+            uint64_t (*rows)[CH8_DISPLAY_HIRES_HEIGHT] = cpu->display.planes[plane];
+            for (uint16_t i = 0; i < height; i++)
+            {
+                // Left-align the sprite row in a word, then shift it into place.
+                uint64_t sprite = (uint64_t)cpu->memory[address++ & memory_mask] << 56;
+                if (large)
+                    sprite |= (uint64_t)cpu->memory[address++ & memory_mask] << 48;
+
+                uint8_t row = y_coord + i;
+                if (row >= screen_height)
+                {
+                    if (!wrap)
+                        continue;
+                    row &= screen_height - 1;
+                }
+
+                // Hires rows continue into word 1 past x = 64. Lores rows are word 0 only.
+                uint64_t left_bits;
+                uint64_t right_bits;
+                if (!hires)
+                {
+                    left_bits = sprite >> x_coord;
+                    if (wrap && x_coord != 0)
+                        left_bits |= sprite << (64 - x_coord);
+                    right_bits = 0;
+                }
+                else if (x_coord < 64)
+                {
+                    left_bits = sprite >> x_coord;
+                    right_bits = x_coord != 0 ? sprite << (64 - x_coord) : 0;
+                }
+                else
+                {
+                    left_bits = wrap && x_coord != 64 ? sprite << (128 - x_coord) : 0;
+                    right_bits = sprite >> (x_coord - 64);
+                }
+
+                collisions |= (rows[0][row] & left_bits) | (rows[1][row] & right_bits);
+                rows[0][row] ^= left_bits;
+                rows[1][row] ^= right_bits;
+                dirty_rows |= 1ULL << row;
+            }
+        }
+    }
+
+    cpu->variable_registers[0xF] = collisions != 0;
+    cpu->display.dirty_rows |= dirty_rows;
+
+    LOGGER_TRACE_DEBUG(cpu->logger, "(0x%04X) - Draw sprite at (V%X(0x%02X), V%X(0x%02X)). Width: %d pixels. Height: %d pixels. VF(0x%02X).",
+                    instruction->opcode, x, cpu->variable_registers[x],
+                    y, cpu->variable_registers[y],
+                    large ? 16 : 8, height, cpu->variable_registers[0xF]);
+}
+
+// 0xEX9E - Skips next instruction if key stored in VX is pressed.
+void OpEX9E(CPUState *cpu, const DecodedInstruction *instruction)
+{
+    uint8_t x = instruction->x;
+    uint16_t key_bit = (0x1 << cpu->variable_registers[x]);
+    // Skip the next instruction if the key is pressed.
+    if (KeyPressed(cpu, key_bit))
+    {
+        SkipNextInstruction(cpu);
+    }
+    LOGGER_TRACE_DEBUG(cpu->logger, "(0x%04X) - Skip next instruction if key V%X(%02X) is pressed.",
+                    instruction->opcode, x, cpu->variable_registers[x]);
+}
+
+// 0xEXA1 - Skips next instruction if key stored in VX is not pressed.
+void OpEXA1(CPUState *cpu, const DecodedInstruction *instruction)
+{
+    uint8_t x = instruction->x;
+    uint16_t key_bit = (0x1 << cpu->variable_registers[x]);
+    // Skip the next instruction if the key is not pressed.
+    if (!KeyPressed(cpu, key_bit))
+    {
+        SkipNextInstruction(cpu);
+    }
+    LOGGER_TRACE_DEBUG(cpu->logger, "(0x%04X) - Skip next instruction if key V%X(%02X) is not pressed.",
+                    instruction->opcode, x, cpu->variable_registers[x]);
+}
+
+// 0xF000 NNNN - Set I to the 16-bit address NNNN stored after the instruction. XO-CHIP.
+void OpF000(CPUState *cpu, const DecodedInstruction *instruction)
+{
+    if (cpu->machine != CPU_MACHINE_XOCHIP)
+    {
+        OpNotImplemented(cpu, instruction);
+        return;
+    }
+
+    // PC already points at NNNN. Step over it.
+    uint16_t mask = cpu->memory_size - 1;
+    uint16_t address = cpu->program_counter & mask;
+    cpu->index_register = PEEK_16BIT(cpu->memory, address, mask);
+    cpu->program_counter = (address + 2) & mask;
+    LOGGER_TRACE_DEBUG(cpu->logger, "(0x%04X) - Set I to %04X.", instruction->opcode, cpu->index_register);
 }
 
-uint8_t WaitKeyPressed(CPUState *cpu)
+// 0xFN01 - Select the planes to draw to, clear and scroll, as bitmask N. XO-CHIP.
+void OpFN01(CPUState *cpu, const DecodedInstruction *instruction)
 {
-    // Loop while keys == 0(no key pressed).
+    if (cpu->machine != CPU_MACHINE_XOCHIP)
+    {
+        OpNotImplemented(cpu, instruction);
+        return;
+    }
+
+    uint8_t planes = instruction->x & CH8_DISPLAY_ALL_PLANES;
+    cpu->display.selected_planes = planes;
+    cpu->display.plane_mask |= planes;
+    LOGGER_TRACE_DEBUG(cpu->logger, "(0x%04X) - Select planes %X.", instruction->opcode, planes);
+}
+
+// 0xF002 - Load the 16-byte audio pattern at I. XO-CHIP.
+void OpF002(CPUState *cpu, const DecodedInstruction *instruction)
+{
+    if (cpu->machine != CPU_MACHINE_XOCHIP)
+    {
+        OpNotImplemented(cpu, instruction);
+        return;
+    }
+
+    for (uint8_t i = 0; i < CH8_AUDIO_PATTERN_SIZE; i++)
+    {
+        cpu->audio_pattern[i] = cpu->memory[(cpu->index_register + i) & (cpu->memory_size - 1)];
+    }
+    // Uploaded on the next timer tick.
+    cpu->audio_pattern_dirty = true;
+    LOGGER_TRACE_DEBUG(cpu->logger, "(0x%04X) - Load audio pattern from address I(%04X).",
+                    instruction->opcode, cpu->index_register);
+}
+
+// 0xFX07 - Set VX to value in delay timer.
+void OpFX07(CPUState *cpu, const DecodedInstruction *instruction)
+{
+    cpu->variable_registers[instruction->x] = cpu->delay_timer;
+    LOGGER_TRACE_DEBUG(cpu->logger, "(0x%04X) - Set V%X to delay timer(%02X).",
+                    instruction->opcode, instruction->x, cpu->delay_timer);
+}
+
+// 0xFX0A - Wait for keypress and assign it to VX.
+void OpFX0A(CPUState *cpu, const DecodedInstruction *instruction)
+{
+    // Never block the scheduler; timers must keep ticking while we wait.
+    // Re-execute the instruction until a key is pressed instead.
     uint16_t keys = cpu->keys;
-    while (keys == 0)
+    cpu->waiting_for_key = keys == 0;
+    if (keys == 0)
+    {
+        cpu->program_counter = (cpu->program_counter - 2) & (cpu->memory_size - 1);
+        return;
+    }
+    uint8_t key_pressed = MapBitKey(keys);
+    cpu->variable_registers[instruction->x] = key_pressed;
+    LOGGER_TRACE_DEBUG(cpu->logger, "(0x%04X) - Waited for keypress. Key %02X pressed and stored in V%X.",
+                    instruction->opcode, key_pressed, instruction->x);
+}
+
+// 0xFX15 - Sets delay timer to VX.
+void OpFX15(CPUState *cpu, const DecodedInstruction *instruction)
+{
+    // Set delay timer.
+    cpu->delay_timer = cpu->variable_registers[instruction->x];
+    LOGGER_TRACE_DEBUG(cpu->logger, "(0x%04X) - Set delay timer to V%X(%02X).",
+                    instruction->opcode, instruction->x, cpu->variable_registers[instruction->x]);
+}
+
+// 0xFX18 - Sets sound timer to VX.
+void OpFX18(CPUState *cpu, const DecodedInstruction *instruction)
+{
+    // Set sound timer.
+    cpu->sound_timer = cpu->variable_registers[instruction->x];
+
+    LOGGER_TRACE_DEBUG(cpu->logger, "(0x%04X) - Set sound timer to V%X(%02X).",
+                    instruction->opcode, instruction->x, cpu->variable_registers[instruction->x]);
+}
+
+// 0xFX1E - Add VX to I.
+// VF is not affected.
+void OpFX1E(CPUState *cpu, const DecodedInstruction *instruction)
+{
+    // Add VX to I.
+    cpu->index_register += cpu->variable_registers[instruction->x];
+
+    LOGGER_TRACE_DEBUG(cpu->logger, "(0x%04X) - Add V%X(%02X) to I.",
+                    instruction->opcode, instruction->x, cpu->variable_registers[instruction->x]);
+}
+
+// 0xFX29 - Set I to location of sprite indexed by VX.
+void OpFX29(CPUState *cpu, const DecodedInstruction *instruction)
+{
+    // Each font sprite is 5 bytes. Only the lowest nibble of VX selects a character.
+    uint16_t sprite_addr = cpu->font_start_address + (5 * (cpu->variable_registers[instruction->x] & 0x0F));
+    cpu->index_register = sprite_addr;
+    LOGGER_TRACE_DEBUG(cpu->logger, "(0x%04X) - Set I to address(%04X) of sprite V%X(%02X).",
+                    instruction->opcode, sprite_addr, instruction->x, cpu->variable_registers[instruction->x]);
+}
+
+// 0xFX30 - Set I to location of the big sprite indexed by VX. SUPER-CHIP.
+void OpFX30(CPUState *cpu, const DecodedInstruction *instruction)
+{
+    // Each big font sprite is 10 bytes. Only the lowest nibble of VX selects a character.
+    uint16_t sprite_addr = cpu->big_font_start_address + (10 * (cpu->variable_registers[instruction->x] & 0x0F));
+    cpu->index_register = sprite_addr;
+    LOGGER_TRACE_DEBUG(cpu->logger, "(0x%04X) - Set I to address(%04X) of big sprite V%X(%02X).",
+                    instruction->opcode, sprite_addr, instruction->x, cpu->variable_registers[instruction->x]);
+}
+
+// 0xFX33 - Store the binary-coded decimal of VX with the
+//          100-place at I, 10-place at I+1 and 1-place at I+2.
+void OpFX33(CPUState *cpu, const DecodedInstruction *instruction)
+{
+    // Addresses wrap around the end of memory.
+    uint16_t memory_mask = cpu->memory_size - 1;
+    uint16_t address = cpu->index_register & memory_mask;
+    // 100-place
+    uint8_t binary = cpu->variable_registers[instruction->x];
+    uint8_t modulo = binary % 100;
+    uint8_t result = (binary - modulo) / 100;
+    cpu->memory[address] = result;
+    // 10-place
+    binary = modulo;
+    modulo = binary % 10;
+    result = (binary - modulo) / 10;
+    cpu->memory[(address + 1) & memory_mask] = result;
+    // 1-place
+    cpu->memory[(address + 2) & memory_mask] = modulo;
+    // We might have overwritten code.
+    InvalidateDecoded(cpu, address, 3);
+    LOGGER_TRACE_DEBUG(cpu->logger, "(0x%04X) - Store BCD of V%X(%02X) starting at address I(%04X).",
+                    instruction->opcode, instruction->x, cpu->variable_registers[instruction->x], cpu->index_register);
+}
+
+// 0xFX3A - Set the audio pattern pitch to VX. XO-CHIP.
+void OpFX3A(CPUState *cpu, const DecodedInstruction *instruction)
+{
+    if (cpu->machine != CPU_MACHINE_XOCHIP)
+    {
+        OpNotImplemented(cpu, instruction);
+        return;
+    }
+
+    cpu->audio_pitch = cpu->variable_registers[instruction->x];
+    // Uploaded on the next timer tick.
+    cpu->audio_pattern_dirty = true;
+    LOGGER_TRACE_DEBUG(cpu->logger, "(0x%04X) - Set pitch to V%X(%02X).",
+                    instruction->opcode, instruction->x, cpu->variable_registers[instruction->x]);
+}
+
+// 0xFX55 - Store V0-VX in memory starting at address I.
+void OpFX55(CPUState *cpu, const DecodedInstruction *instruction)
+{
+    // Addresses wrap around the end of memory.
+    uint16_t memory_mask = cpu->memory_size - 1;
+    uint16_t address = cpu->index_register & memory_mask;
+    for (uint8_t i = 0; i <= instruction->x; i++)
     {
-        keys = cpu->keys;
+        cpu->memory[(address + i) & memory_mask] = cpu->variable_registers[i];
     }
+    // We might have overwritten code.
+    InvalidateDecoded(cpu, address, instruction->x + 1);
+    LOGGER_TRACE_DEBUG(cpu->logger, "(0x%04X) - Storing registers V0-V%X in memory starting at address I(%04X).",
+                    instruction->opcode, instruction->x, cpu->index_register);
+}
 
-    return MapBitKey(keys);
+// 0xFX65 - Loads V0-VX from memory starting at address I.
+void OpFX65(CPUState *cpu, const DecodedInstruction *instruction)
+{
+    uint16_t memory_mask = cpu->memory_size - 1;
+    for (uint8_t i = 0; i <= instruction->x; i++)
+    {
+        cpu->variable_registers[i] = cpu->memory[(cpu->index_register + i) & memory_mask];
+    }
+    LOGGER_TRACE_DEBUG(cpu->logger, "(0x%04X) - Loading registers V0-V%X from memory starting at address I(%04X).",
+                    instruction->opcode, instruction->x, cpu->index_register);
 }
 
-void PushStack(CPUState *cpu, uint16_t pc)
+void OpNotImplemented(CPUState *cpu, const DecodedInstruction *instruction)
 {
+    LOGGER_TRACE_DEBUG(cpu->logger, "(0x%04X) - (NOT IMPLEMENTED).", instruction->opcode);
+}
+
+bool KeyPressed(CPUState *cpu, uint16_t key_bit)
+{
+    return cpu->keys & key_bit;
+}
+
+bool PushStack(CPUState *cpu, uint16_t pc)
+{
+    if (cpu->stack_pointer == cpu->stack + CH8_STACK_DEPTH)
+    {
+        return false;
+    }
     *(cpu->stack_pointer) = pc;
     cpu->stack_pointer++;
+    return true;
 }
 
-uint16_t PopStack(CPUState *cpu)
+bool PopStack(CPUState *cpu, uint16_t *pc)
 {
+    if (cpu->stack_pointer == cpu->stack)
+    {
+        return false;
+    }
     cpu->stack_pointer--;
-    return *(cpu->stack_pointer);
+    *pc = *(cpu->stack_pointer);
+    return true;
+}
+
+// Stalls on 'instruction' the way FX0A waits for a key: PC goes back to it, so every execution
+// mode stops making progress without having to leave its dispatch loop. Logged once.
+void StackFault(CPUState *cpu, const DecodedInstruction *instruction, const char *reason)
+{
+    cpu->program_counter = (cpu->program_counter - 2) & (cpu->memory_size - 1);
+    if (!cpu->stack_fault)
+    {
+        cpu->stack_fault = true;
+        logger_LogError(cpu->logger, "(0x%04X) at 0x%04X - %s Stopping.", instruction->opcode, cpu->program_counter, reason);
+    }
 }
@@ -0,0 +1,270 @@
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "core/display.h"
+
+// RGBA8 pixels read as little-endian words: alpha is the top byte. One color per combination
+// of plane bits.
+#define PIXEL_OFF (0xFF000000u)
+#define PIXEL_PLANE0 (0xFFFFFFFFu)
+#define PIXEL_PLANE1 (0xFF0066FFu)
+#define PIXEL_BOTH_PLANES (0xFF002266u)
+#define RGBA_ROW_SIZE (CH8_DISPLAY_HIRES_WIDTH * CH8_INTERNAL_DISPLAY_CHANNELS)
+
+static uint64_t SpreadLoresRows(uint64_t rows);
+static void CopyPlanes(uint64_t dst[][CH8_DISPLAY_ROW_WORDS][CH8_DISPLAY_HIRES_HEIGHT],
+                       const uint64_t src[][CH8_DISPLAY_ROW_WORDS][CH8_DISPLAY_HIRES_HEIGHT],
+                       uint8_t plane_mask, bool hires);
+static void ExpandWordRGBA(uint64_t plane0, uint64_t plane1, uint8_t *rgba);
+static void ExpandLoresWordRGBA(uint64_t plane0, uint64_t plane1, uint8_t *rgba);
+#if defined(__SSE2__)
+static __m128i CombinePlanesRGBA(__m128i lit0, __m128i lit1);
+#else
+static void StorePixelRGBA(uint8_t color, uint8_t *out);
+#endif
+
+void core_InitializeDisplay(Display *display)
+{
+    memset(display->planes, 0, sizeof(display->planes));
+    memset(display->frames, 0, sizeof(display->frames));
+    display->dirty_rows = 0;
+    display->hires = false;
+    display->selected_planes = 1;
+    display->plane_mask = 1;
+    display->generation = 0;
+    display->back_frame = 0;
+    atomic_init(&display->published_frame, 1);
+    display->front_frame = 2;
+}
+
+void core_PublishDisplay(Display *display)
+{
+    DisplayFrame *frame = &display->frames[display->back_frame];
+    CopyPlanes(frame->planes, display->planes, display->plane_mask, display->hires);
+    frame->generation = ++display->generation;
+    frame->dirty_rows = display->dirty_rows;
+    frame->hires = display->hires;
+    frame->plane_mask = display->plane_mask;
+    display->dirty_rows = 0;
+
+    // Release makes the copy visible before the index, acquire hands back a frame the
+    // renderer is done reading.
+    uint8_t previous = atomic_exchange_explicit(&display->published_frame,
+                                                display->back_frame | CH8_DISPLAY_FRAME_FRESH,
+                                                memory_order_acq_rel);
+    display->back_frame = previous & CH8_DISPLAY_FRAME_INDEX_MASK;
+}
+
+const DisplayFrame *core_AcquireDisplayFrame(Display *display, bool *is_new)
+{
+    bool fresh = atomic_load_explicit(&display->published_frame, memory_order_relaxed) & CH8_DISPLAY_FRAME_FRESH;
+    if (fresh)
+    {
+        uint8_t previous = atomic_exchange_explicit(&display->published_frame, display->front_frame,
+                                                    memory_order_acq_rel);
+        display->front_frame = previous & CH8_DISPLAY_FRAME_INDEX_MASK;
+    }
+
+    if (is_new != NULL)
+        *is_new = fresh;
+    return &display->frames[display->front_frame];
+}
+
+uint64_t core_TakeDisplayFrameChanges(const DisplayFrame *frame, DisplayFrame *seen)
+{
+    if (frame->generation == seen->generation)
+        return 0;
+
+    uint64_t changed = 0;
+    if (frame->hires != seen->hires || frame->plane_mask != seen->plane_mask)
+    {
+        // Every RGBA row is redrawn at the new scale or with the new colors.
+        changed = UINT64_MAX;
+    }
+    else
+    {
+        if (frame->generation == seen->generation + 1)
+        {
+            changed = frame->dirty_rows;
+        }
+        else
+        {
+            size_t height = frame->hires ? CH8_DISPLAY_HIRES_HEIGHT : CH8_DISPLAY_HEIGHT;
+            size_t words = frame->hires ? CH8_DISPLAY_ROW_WORDS : 1;
+            for (size_t plane = 0; plane < CH8_DISPLAY_PLANE_COUNT; plane++)
+            {
+                if (!(frame->plane_mask & (1u << plane)))
+                    continue;
+                for (size_t word = 0; word < words; word++)
+                {
+                    for (size_t y = 0; y < height; y++)
+                    {
+                        if (frame->planes[plane][word][y] != seen->planes[plane][word][y])
+                            changed |= 1ull << y;
+                    }
+                }
+            }
+        }
+
+        if (!frame->hires)
+            changed = SpreadLoresRows(changed);
+    }
+
+    CopyPlanes(seen->planes, frame->planes, frame->plane_mask, frame->hires);
+    seen->generation = frame->generation;
+    seen->dirty_rows = frame->dirty_rows;
+    seen->hires = frame->hires;
+    seen->plane_mask = frame->plane_mask;
+    return changed;
+}
+
+void core_ExpandDisplayRGBA(const uint64_t planes[][CH8_DISPLAY_ROW_WORDS][CH8_DISPLAY_HIRES_HEIGHT],
+                            uint8_t plane_mask, bool hires, uint8_t *rgba)
+{
+    core_ExpandDisplayRowsRGBA(planes, plane_mask, hires, 0, CH8_DISPLAY_HIRES_HEIGHT, rgba);
+}
+
+void core_ExpandDisplayRowsRGBA(const uint64_t planes[][CH8_DISPLAY_ROW_WORDS][CH8_DISPLAY_HIRES_HEIGHT],
+                                uint8_t plane_mask, bool hires, size_t first_row, size_t row_count, uint8_t *rgba)
+{
+    // Planes outside the mask read as blank, whatever the buffer holds.
+    uint64_t plane0_mask = plane_mask & 0x1 ? UINT64_MAX : 0;
+    uint64_t plane1_mask = plane_mask & 0x2 ? UINT64_MAX : 0;
+    uint8_t *out = rgba + first_row * RGBA_ROW_SIZE;
+    for (size_t y = first_row; y < first_row + row_count; y++, out += RGBA_ROW_SIZE)
+    {
+        if (hires)
+        {
+            for (size_t word = 0; word < CH8_DISPLAY_ROW_WORDS; word++)
+                ExpandWordRGBA(planes[0][word][y] & plane0_mask, planes[1][word][y] & plane1_mask,
+                               out + word * 64 * CH8_INTERNAL_DISPLAY_CHANNELS);
+        }
+        else if (y % 2 == 1 && y != first_row)
+        {
+            // Second RGBA row of a lores row, which was just expanded.
+            memcpy(out, out - RGBA_ROW_SIZE, RGBA_ROW_SIZE);
+        }
+        else
+        {
+            ExpandLoresWordRGBA(planes[0][0][y / 2] & plane0_mask, planes[1][0][y / 2] & plane1_mask, out);
+        }
+    }
+}
+
+// Maps bit y of a lores row mask to bits 2y and 2y + 1.
+uint64_t SpreadLoresRows(uint64_t rows)
+{
+    rows &= 0xFFFFFFFFull;
+    rows = (rows | (rows << 16)) & 0x0000FFFF0000FFFFull;
+    rows = (rows | (rows << 8)) & 0x00FF00FF00FF00FFull;
+    rows = (rows | (rows << 4)) & 0x0F0F0F0F0F0F0F0Full;
+    rows = (rows | (rows << 2)) & 0x3333333333333333ull;
+    rows = (rows | (rows << 1)) & 0x5555555555555555ull;
+    return rows | (rows << 1);
+}
+
+// Copies the planes in 'plane_mask'. Lores screens only copy lores rows; readers never look
+// past the resolution.
+void CopyPlanes(uint64_t dst[][CH8_DISPLAY_ROW_WORDS][CH8_DISPLAY_HIRES_HEIGHT],
+                const uint64_t src[][CH8_DISPLAY_ROW_WORDS][CH8_DISPLAY_HIRES_HEIGHT],
+                uint8_t plane_mask, bool hires)
+{
+    for (size_t plane = 0; plane < CH8_DISPLAY_PLANE_COUNT; plane++)
+    {
+        if (!(plane_mask & (1u << plane)))
+            continue;
+        if (hires)
+            memcpy(dst[plane], src[plane], CH8_DISPLAY_HIRES_ROWS_SIZE);
+        else
+            memcpy(dst[plane], src[plane], CH8_DISPLAY_LORES_ROWS_SIZE);
+    }
+}
+
+void ExpandWordRGBA(uint64_t plane0, uint64_t plane1, uint8_t *rgba)
+{
+#if defined(__SSE2__)
+    // Each byte of a word covers 8 pixels, or 32 bytes of output. Broadcast it, isolate one bit
+    // per 32-bit lane and compare, giving all-ones for lit pixels. Then pick colors from both planes.
+    const __m128i high_bits = _mm_set_epi32(0x10, 0x20, 0x40, 0x80);
+    const __m128i low_bits = _mm_set_epi32(0x01, 0x02, 0x04, 0x08);
+    __m128i *out = (__m128i *)rgba;
+    for (int shift = 56; shift >= 0; shift -= 8)
+    {
+        __m128i pixels0 = _mm_set1_epi32((int)((plane0 >> shift) & 0xFF));
+        __m128i pixels1 = _mm_set1_epi32((int)((plane1 >> shift) & 0xFF));
+        __m128i high0 = _mm_cmpeq_epi32(_mm_and_si128(pixels0, high_bits), high_bits);
+        __m128i high1 = _mm_cmpeq_epi32(_mm_and_si128(pixels1, high_bits), high_bits);
+        __m128i low0 = _mm_cmpeq_epi32(_mm_and_si128(pixels0, low_bits), low_bits);
+        __m128i low1 = _mm_cmpeq_epi32(_mm_and_si128(pixels1, low_bits), low_bits);
+        _mm_storeu_si128(out++, CombinePlanesRGBA(high0, high1));
+        _mm_storeu_si128(out++, CombinePlanesRGBA(low0, low1));
+    }
+#else
+    for (size_t x = 0; x < 64; x++)
+    {
+        uint64_t bit = CH8_DISPLAY_PIXEL_BIT(x);
+        uint8_t color = (plane0 & bit ? 1 : 0) | (plane1 & bit ? 2 : 0);
+        StorePixelRGBA(color, rgba + x * CH8_INTERNAL_DISPLAY_CHANNELS);
+    }
+#endif
+}
+
+void ExpandLoresWordRGBA(uint64_t plane0, uint64_t plane1, uint8_t *rgba)
+{
+#if defined(__SSE2__)
+    // Same as ExpandWordRGBA with every bit tested by two lanes, so a byte makes 16 pixels.
+    const __m128i bits[4] = {
+        _mm_set_epi32(0x40, 0x40, 0x80, 0x80),
+        _mm_set_epi32(0x10, 0x10, 0x20, 0x20),
+        _mm_set_epi32(0x04, 0x04, 0x08, 0x08),
+        _mm_set_epi32(0x01, 0x01, 0x02, 0x02),
+    };
+    __m128i *out = (__m128i *)rgba;
+    for (int shift = 56; shift >= 0; shift -= 8)
+    {
+        __m128i pixels0 = _mm_set1_epi32((int)((plane0 >> shift) & 0xFF));
+        __m128i pixels1 = _mm_set1_epi32((int)((plane1 >> shift) & 0xFF));
+        for (size_t i = 0; i < 4; i++)
+        {
+            __m128i lit0 = _mm_cmpeq_epi32(_mm_and_si128(pixels0, bits[i]), bits[i]);
+            __m128i lit1 = _mm_cmpeq_epi32(_mm_and_si128(pixels1, bits[i]), bits[i]);
+            _mm_storeu_si128(out++, CombinePlanesRGBA(lit0, lit1));
+        }
+    }
+#else
+    for (size_t x = 0; x < CH8_DISPLAY_HIRES_WIDTH; x++)
+    {
+        uint64_t bit = CH8_DISPLAY_PIXEL_BIT(x / 2);
+        uint8_t color = (plane0 & bit ? 1 : 0) | (plane1 & bit ? 2 : 0);
+        StorePixelRGBA(color, rgba + x * CH8_INTERNAL_DISPLAY_CHANNELS);
+    }
+#endif
+}
+
+#if defined(__SSE2__)
+// Picks a color per lane from the all-ones masks of lit pixels, without branching. Each color is
+// the background XORed with the terms of the planes lit in that lane.
+__m128i CombinePlanesRGBA(__m128i lit0, __m128i lit1)
+{
+    const __m128i background = _mm_set1_epi32((int)PIXEL_OFF);
+    const __m128i plane0_term = _mm_set1_epi32((int)(PIXEL_PLANE0 ^ PIXEL_OFF));
+    const __m128i plane1_term = _mm_set1_epi32((int)(PIXEL_PLANE1 ^ PIXEL_OFF));
+    const __m128i both_term = _mm_set1_epi32((int)(PIXEL_BOTH_PLANES ^ PIXEL_PLANE1 ^ PIXEL_PLANE0 ^ PIXEL_OFF));
+    __m128i pixels = _mm_xor_si128(background, _mm_and_si128(lit0, plane0_term));
+    pixels = _mm_xor_si128(pixels, _mm_and_si128(lit1, plane1_term));
+    return _mm_xor_si128(pixels, _mm_and_si128(_mm_and_si128(lit0, lit1), both_term));
+}
+#else
+void StorePixelRGBA(uint8_t color, uint8_t *out)
+{
+    static const uint32_t palette[4] = {PIXEL_OFF, PIXEL_PLANE0, PIXEL_PLANE1, PIXEL_BOTH_PLANES};
+    uint32_t pixel = palette[color];
+    out[0] = pixel;
+    out[1] = pixel >> 8;
+    out[2] = pixel >> 16;
+    out[3] = pixel >> 24;
+}
+#endif
@@ -0,0 +1,539 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+
+#include "core/jit.h"
+#include "core/cpu.h"
+
+#if defined(__x86_64__) && (defined(__linux__) || defined(__APPLE__))
+#define CH8_JIT_SUPPORTED
+#endif
+
+#ifdef CH8_JIT_SUPPORTED
+
+#include <sys/mman.h>
+
+// Upper bound of native code emitted for one block. Each instruction emits at most 32 bytes.
+#define MAX_BLOCK_CODE_SIZE (CH8_JIT_MAX_BLOCK_INSTRUCTIONS * 32 + 64)
+// Granularity of the map used to skip invalidation of writes that never touch compiled code.
+#define CODE_PAGE_SIZE (64)
+
+// Offsets into CPUState addressed relative to RBX, which holds the CPUState pointer in a block.
+#define V_OFFSET(idx) ((int32_t)(offsetof(CPUState, variable_registers) + (idx)))
+#define PC_OFFSET ((int32_t)offsetof(CPUState, program_counter))
+#define I_OFFSET ((int32_t)offsetof(CPUState, index_register))
+#define DELAY_TIMER_OFFSET ((int32_t)offsetof(CPUState, delay_timer))
+#define SOUND_TIMER_OFFSET ((int32_t)offsetof(CPUState, sound_timer))
+#define DECODED_OFFSET(address) ((int32_t)(offsetof(CPUState, decode_cache) + ((address) >> 1) * sizeof(DecodedInstruction)))
+
+// x86-64 register numbers used in ModRM.reg.
+#define REG_AL (0)
+#define REG_CL (1)
+#define REG_SI (6)
+
+typedef struct Emitter
+{
+    uint8_t *start;
+    uint8_t *cursor;
+    // Memory size - 1. Stored PCs wrap around the end of memory, as in the interpreter.
+    uint16_t address_mask;
+} Emitter;
+
+static JitBlock *CompileBlock(JitContext *ctx, CPUState *cpu, uint16_t start_address);
+static bool EmitInstruction(Emitter *e, const DecodedInstruction *instruction, uint16_t address);
+static void EmitCallHandler(Emitter *e, uint16_t address);
+static void EmitSkip(Emitter *e, uint8_t jcc, uint16_t address);
+static void EmitStorePC(Emitter *e, uint16_t pc);
+static void EmitRbxDisp32(Emitter *e, uint8_t reg, int32_t disp);
+static void Emit8(Emitter *e, uint8_t byte);
+static void Emit16(Emitter *e, uint16_t word);
+static void Emit32(Emitter *e, uint32_t dword);
+static void MarkCodePages(JitContext *ctx, uint16_t start_address, uint16_t end_address);
+static bool TouchesCodePages(JitContext *ctx, uint16_t address, size_t size);
+
+bool jit_IsSupported()
+{
+    return true;
+}
+
+JitContext *jit_CreateContext(size_t memory_size)
+{
+    JitContext *ctx = calloc(1, sizeof(JitContext));
+
+    // Mapped writable while compiling and executable otherwise. Never both at once.
+    ctx->code_buffer_size = CH8_JIT_CODE_BUFFER_SIZE;
+    ctx->code_buffer = mmap(NULL, ctx->code_buffer_size, PROT_READ | PROT_EXEC,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ctx->code_buffer == MAP_FAILED)
+    {
+        free(ctx);
+        return NULL;
+    }
+
+    ctx->blocks_count = memory_size / 2;
+    ctx->blocks = calloc(ctx->blocks_count, sizeof(JitBlock));
+    ctx->code_pages = calloc(memory_size / CODE_PAGE_SIZE, sizeof(uint8_t));
+    ctx->code_pages_count = memory_size / CODE_PAGE_SIZE;
+
+    return ctx;
+}
+
+void jit_DestroyContext(JitContext *ctx)
+{
+    munmap(ctx->code_buffer, ctx->code_buffer_size);
+    free(ctx->code_pages);
+    free(ctx->blocks);
+    free(ctx);
+}
+
+uint32_t jit_RunBlock(JitContext *ctx, CPUState *cpu, uint64_t max_cycles)
+{
+    uint16_t pc = cpu->program_counter;
+    // Blocks only start at even addresses. Odd addresses are left to the interpreter.
+    if ((pc & 0x1) || (size_t)(pc >> 1) >= ctx->blocks_count)
+        return 0;
+
+    JitBlock *block = &ctx->blocks[pc >> 1];
+    if (block->code == NULL)
+    {
+        if (block->invalidations >= CH8_JIT_MAX_INVALIDATIONS || CompileBlock(ctx, cpu, pc) == NULL)
+            return 0;
+    }
+
+    // Spinning in place until the budget runs out leaves the exact same state as doing nothing.
+    if (block->idle_loop)
+        return max_cycles > UINT32_MAX ? UINT32_MAX : (uint32_t)max_cycles;
+
+    // Running the block would overshoot the budget. Let the interpreter single-step instead.
+    if (block->cycles > max_cycles)
+        return 0;
+
+    block->code(cpu);
+    return block->cycles;
+}
+
+void jit_Invalidate(JitContext *ctx, uint16_t address, size_t size)
+{
+    if (!TouchesCodePages(ctx, address, size))
+        return;
+
+    // A block overlapping the range starts at most one block length before 'address'.
+    size_t max_block_size = CH8_JIT_MAX_BLOCK_INSTRUCTIONS * 2;
+    size_t first = address > max_block_size ? (address - max_block_size) >> 1 : 0;
+    size_t last = (address + size + 1) >> 1;
+    if (last > ctx->blocks_count)
+        last = ctx->blocks_count;
+
+    for (size_t i = first; i < last; i++)
+    {
+        JitBlock *block = &ctx->blocks[i];
+        if (block->code != NULL && block->end_address > address)
+        {
+            // The code itself stays in the buffer until the next flush.
+            block->code = NULL;
+            if (block->invalidations < CH8_JIT_MAX_INVALIDATIONS)
+                block->invalidations++;
+            ctx->blocks_invalidated++;
+        }
+    }
+}
+
+void jit_Flush(JitContext *ctx)
+{
+    memset(ctx->blocks, 0, ctx->blocks_count * sizeof(JitBlock));
+    memset(ctx->code_pages, 0, ctx->code_pages_count);
+    ctx->code_buffer_used = 0;
+    ctx->flushes++;
+}
+
+JitBlock *CompileBlock(JitContext *ctx, CPUState *cpu, uint16_t start_address)
+{
+    // Two bytes are needed for at least one instruction.
+    if ((size_t)start_address + 1 >= cpu->memory_size)
+        return NULL;
+
+    if (ctx->code_buffer_size - ctx->code_buffer_used < MAX_BLOCK_CODE_SIZE)
+        jit_Flush(ctx);
+
+    if (mprotect(ctx->code_buffer, ctx->code_buffer_size, PROT_READ | PROT_WRITE) != 0)
+        return NULL;
+
+    Emitter e = {
+        .start = ctx->code_buffer + ctx->code_buffer_used,
+        .cursor = ctx->code_buffer + ctx->code_buffer_used,
+        .address_mask = cpu->memory_size - 1,
+    };
+
+    // push rbx; mov rbx, rdi
+    // RBX holds the CPUState pointer for the whole block since it survives handler calls.
+    Emit8(&e, 0x53);
+    Emit8(&e, 0x48);
+    Emit8(&e, 0x89);
+    Emit8(&e, 0xFB);
+
+    uint16_t address = start_address;
+    uint32_t cycles = 0;
+    bool terminated = false;
+    while (!terminated && cycles < CH8_JIT_MAX_BLOCK_INSTRUCTIONS && (size_t)address + 1 < cpu->memory_size)
+    {
+        DecodedInstruction instruction;
+        core_DecodeInstruction((cpu->memory[address] << 8) | cpu->memory[address + 1], &instruction);
+        terminated = EmitInstruction(&e, &instruction, address);
+        address += 2;
+        cycles++;
+    }
+
+    // Fell off the end of the block without a jump. Continue with the next instruction.
+    if (!terminated)
+        EmitStorePC(&e, address);
+
+    // pop rbx; ret
+    Emit8(&e, 0x5B);
+    Emit8(&e, 0xC3);
+
+    if (mprotect(ctx->code_buffer, ctx->code_buffer_size, PROT_READ | PROT_EXEC) != 0)
+        return NULL;
+
+    // Keep blocks 16-byte aligned.
+    size_t code_size = (size_t)(e.cursor - e.start);
+    ctx->code_buffer_used += (code_size + 15) & ~(size_t)15;
+
+    JitBlock *block = &ctx->blocks[start_address >> 1];
+    block->code = (void (*)(CPUState *))e.start;
+    block->start_address = start_address;
+    block->end_address = address;
+    block->cycles = cycles;
+    block->idle_loop = cycles == 1 && cpu->memory[start_address] == (0x10 | (start_address >> 8)) &&
+                       cpu->memory[start_address + 1] == (start_address & 0xFF);
+    ctx->blocks_compiled++;
+    MarkCodePages(ctx, start_address, address);
+
+    return block;
+}
+
+// Returns true if the instruction ends the block.
+bool EmitInstruction(Emitter *e, const DecodedInstruction *instruction, uint16_t address)
+{
+    uint8_t x = instruction->x;
+    uint8_t y = instruction->y;
+
+    switch (instruction->opcode & 0xF000)
+    {
+    // 0x1NNN - Jump to NNN.
+    case 0x1000:
+        EmitStorePC(e, instruction->nnn);
+        return true;
+    // 0x3XNN - Skip if VX == NN.
+    case 0x3000:
+        // cmp byte [VX], NN
+        Emit8(e, 0x80);
+        EmitRbxDisp32(e, 7, V_OFFSET(x));
+        Emit8(e, instruction->nn);
+        EmitSkip(e, 0x75, address);
+        return true;
+    // 0x4XNN - Skip if VX != NN.
+    case 0x4000:
+        // cmp byte [VX], NN
+        Emit8(e, 0x80);
+        EmitRbxDisp32(e, 7, V_OFFSET(x));
+        Emit8(e, instruction->nn);
+        EmitSkip(e, 0x74, address);
+        return true;
+    // 0x5XY0 - Skip if VX == VY.
+    // 0x9XY0 - Skip if VX != VY.
+    case 0x5000:
+    case 0x9000:
+        // mov al, [VX]; cmp al, [VY]
+        Emit8(e, 0x8A);
+        EmitRbxDisp32(e, REG_AL, V_OFFSET(x));
+        Emit8(e, 0x3A);
+        EmitRbxDisp32(e, REG_AL, V_OFFSET(y));
+        EmitSkip(e, (instruction->opcode & 0xF000) == 0x5000 ? 0x75 : 0x74, address);
+        return true;
+    // 0x6XNN - Set VX to NN.
+    case 0x6000:
+        // mov byte [VX], NN
+        Emit8(e, 0xC6);
+        EmitRbxDisp32(e, 0, V_OFFSET(x));
+        Emit8(e, instruction->nn);
+        return false;
+    // 0x7XNN - Add NN to VX.
+    case 0x7000:
+        // add byte [VX], NN
+        Emit8(e, 0x80);
+        EmitRbxDisp32(e, 0, V_OFFSET(x));
+        Emit8(e, instruction->nn);
+        return false;
+    case 0x8000:
+    {
+        switch (instruction->opcode & 0x000F)
+        {
+        // 0x8XY0-0x8XY3 - Set VX to VY, VX | VY, VX & VY or VX ^ VY.
+        case 0x0000:
+        case 0x0001:
+        case 0x0002:
+        case 0x0003:
+        {
+            static const uint8_t opcodes[4] = {0x88 /* mov */, 0x08 /* or */, 0x20 /* and */, 0x30 /* xor */};
+            // mov al, [VY]; op [VX], al
+            Emit8(e, 0x8A);
+            EmitRbxDisp32(e, REG_AL, V_OFFSET(y));
+            Emit8(e, opcodes[instruction->opcode & 0x000F]);
+            EmitRbxDisp32(e, REG_AL, V_OFFSET(x));
+            return false;
+        }
+        // 0x8XY4 - Add VY to VX. VF set on carry.
+        // 0x8XY5 - Subtract VY from VX. VF set if no borrow.
+        // 0x8XY7 - Set VX to VY - VX. VF set if no borrow.
+        case 0x0004:
+        case 0x0005:
+        case 0x0007:
+        {
+            uint8_t n = instruction->opcode & 0x000F;
+            // mov al, [first]; add/sub al, [second]
+            Emit8(e, 0x8A);
+            EmitRbxDisp32(e, REG_AL, V_OFFSET(n == 0x7 ? y : x));
+            Emit8(e, n == 0x4 ? 0x02 : 0x2A);
+            EmitRbxDisp32(e, REG_AL, V_OFFSET(n == 0x7 ? x : y));
+            // setc cl / setnc cl
+            Emit8(e, 0x0F);
+            Emit8(e, n == 0x4 ? 0x92 : 0x93);
+            Emit8(e, 0xC1);
+            // Same store order as the interpreter, which matters when X is F.
+            if (n == 0x4)
+            {
+                // mov [VF], cl; mov [VX], al
+                Emit8(e, 0x88);
+                EmitRbxDisp32(e, REG_CL, V_OFFSET(0xF));
+                Emit8(e, 0x88);
+                EmitRbxDisp32(e, REG_AL, V_OFFSET(x));
+            }
+            else
+            {
+                // mov [VX], al; mov [VF], cl
+                Emit8(e, 0x88);
+                EmitRbxDisp32(e, REG_AL, V_OFFSET(x));
+                Emit8(e, 0x88);
+                EmitRbxDisp32(e, REG_CL, V_OFFSET(0xF));
+            }
+            return false;
+        }
+        // 0x8XY6 - Right-shift VX by 1. VF set to the bit shifted out.
+        // 0x8XYE - Left-shift VX by 1. VF set to the bit shifted out.
+        case 0x0006:
+        case 0x000E:
+        {
+            bool right = (instruction->opcode & 0x000F) == 0x6;
+            // mov cl, [VX]
+            Emit8(e, 0x8A);
+            EmitRbxDisp32(e, REG_CL, V_OFFSET(x));
+            if (right)
+            {
+                // and cl, 1
+                Emit8(e, 0x80);
+                Emit8(e, 0xE1);
+                Emit8(e, 0x01);
+            }
+            else
+            {
+                // shr cl, 7
+                Emit8(e, 0xC0);
+                Emit8(e, 0xE9);
+                Emit8(e, 0x07);
+            }
+            // mov [VF], cl
+            Emit8(e, 0x88);
+            EmitRbxDisp32(e, REG_CL, V_OFFSET(0xF));
+            // VF is written first, so reload VX in case X is F.
+            // mov al, [VX]; shr/shl al, 1; mov [VX], al
+            Emit8(e, 0x8A);
+            EmitRbxDisp32(e, REG_AL, V_OFFSET(x));
+            Emit8(e, 0xD0);
+            Emit8(e, right ? 0xE8 : 0xE0);
+            Emit8(e, 0x88);
+            EmitRbxDisp32(e, REG_AL, V_OFFSET(x));
+            return false;
+        }
+        default:
+            EmitCallHandler(e, address);
+            return false;
+        }
+    }
+    // 0xANNN - Set I to NNN.
+    case 0xA000:
+        // mov word [I], NNN
+        Emit8(e, 0x66);
+        Emit8(e, 0xC7);
+        EmitRbxDisp32(e, 0, I_OFFSET);
+        Emit16(e, instruction->nnn);
+        return false;
+    case 0xF000:
+    {
+        switch (instruction->opcode & 0x00FF)
+        {
+        // 0xFX07 - Set VX to delay timer.
+        case 0x0007:
+            Emit8(e, 0x8A);
+            EmitRbxDisp32(e, REG_AL, DELAY_TIMER_OFFSET);
+            Emit8(e, 0x88);
+            EmitRbxDisp32(e, REG_AL, V_OFFSET(x));
+            return false;
+        // 0xFX15 - Set delay timer to VX.
+        // 0xFX18 - Set sound timer to VX.
+        case 0x0015:
+        case 0x0018:
+            Emit8(e, 0x8A);
+            EmitRbxDisp32(e, REG_AL, V_OFFSET(x));
+            Emit8(e, 0x88);
+            EmitRbxDisp32(e, REG_AL, (instruction->opcode & 0x00FF) == 0x15 ? DELAY_TIMER_OFFSET : SOUND_TIMER_OFFSET);
+            return false;
+        // 0xFX1E - Add VX to I.
+        case 0x001E:
+            // movzx eax, byte [VX]; add word [I], ax
+            Emit8(e, 0x0F);
+            Emit8(e, 0xB6);
+            EmitRbxDisp32(e, REG_AL, V_OFFSET(x));
+            Emit8(e, 0x66);
+            Emit8(e, 0x01);
+            EmitRbxDisp32(e, REG_AL, I_OFFSET);
+            return false;
+        // 0xFX0A may rewind PC. 0xFX33 and 0xFX55 may overwrite this very block.
+        case 0x000A:
+        case 0x0033:
+        case 0x0055:
+            EmitCallHandler(e, address);
+            return true;
+        default:
+            EmitCallHandler(e, address);
+            return false;
+        }
+    }
+    // 0x2NNN, 0xBNNN and 0xEX9E/0xEXA1 set PC. 0x00EE too.
+    case 0x2000:
+    case 0xB000:
+    case 0xE000:
+        EmitCallHandler(e, address);
+        return true;
+    case 0x0000:
+        EmitCallHandler(e, address);
+        return instruction->opcode == 0x00EE;
+    // 0xCXNN and 0xDXYN.
+    default:
+        EmitCallHandler(e, address);
+        return false;
+    }
+}
+
+void EmitCallHandler(Emitter *e, uint16_t address)
+{
+    // Handlers expect PC to point at the next instruction.
+    EmitStorePC(e, address + 2);
+    // lea rsi, [rbx + &decode_cache[address / 2]]
+    // Undecoded entries point at the interpreter's decode stub, so this always works.
+    Emit8(e, 0x48);
+    Emit8(e, 0x8D);
+    EmitRbxDisp32(e, REG_SI, DECODED_OFFSET(address));
+    // mov rdi, rbx
+    Emit8(e, 0x48);
+    Emit8(e, 0x89);
+    Emit8(e, 0xDF);
+    // call [rsi]
+    Emit8(e, 0xFF);
+    Emit8(e, 0x16);
+}
+
+void EmitSkip(Emitter *e, uint8_t jcc, uint16_t address)
+{
+    // Flags are set by the caller. mov doesn't touch them.
+    // mov word [PC], address + 2; jcc +9; mov word [PC], address + 4
+    EmitStorePC(e, address + 2);
+    Emit8(e, jcc);
+    Emit8(e, 9);
+    EmitStorePC(e, address + 4);
+}
+
+void EmitStorePC(Emitter *e, uint16_t pc)
+{
+    // mov word [PC], imm16 (9 bytes)
+    Emit8(e, 0x66);
+    Emit8(e, 0xC7);
+    EmitRbxDisp32(e, 0, PC_OFFSET);
+    Emit16(e, pc & e->address_mask);
+}
+
+void EmitRbxDisp32(Emitter *e, uint8_t reg, int32_t disp)
+{
+    // ModRM with mod = 10 (disp32) and rm = 011 (rbx).
+    Emit8(e, 0x80 | (reg << 3) | 0x03);
+    Emit32(e, (uint32_t)disp);
+}
+
+void Emit8(Emitter *e, uint8_t byte)
+{
+    *e->cursor++ = byte;
+}
+
+void Emit16(Emitter *e, uint16_t word)
+{
+    memcpy(e->cursor, &word, sizeof(word));
+    e->cursor += sizeof(word);
+}
+
+void Emit32(Emitter *e, uint32_t dword)
+{
+    memcpy(e->cursor, &dword, sizeof(dword));
+    e->cursor += sizeof(dword);
+}
+
+void MarkCodePages(JitContext *ctx, uint16_t start_address, uint16_t end_address)
+{
+    for (size_t page = start_address / CODE_PAGE_SIZE; page <= (size_t)(end_address - 1) / CODE_PAGE_SIZE && page < ctx->code_pages_count; page++)
+    {
+        ctx->code_pages[page] = 1;
+    }
+}
+
+bool TouchesCodePages(JitContext *ctx, uint16_t address, size_t size)
+{
+    if (size == 0)
+        return false;
+
+    for (size_t page = address / CODE_PAGE_SIZE; page <= (address + size - 1) / CODE_PAGE_SIZE && page < ctx->code_pages_count; page++)
+    {
+        if (ctx->code_pages[page])
+            return true;
+    }
+
+    return false;
+}
+
+#else
+
+bool jit_IsSupported()
+{
+    return false;
+}
+
+JitContext *jit_CreateContext(size_t memory_size)
+{
+    return NULL;
+}
+
+void jit_DestroyContext(JitContext *ctx)
+{
+}
+
+uint32_t jit_RunBlock(JitContext *ctx, CPUState *cpu, uint64_t max_cycles)
+{
+    return 0;
+}
+
+void jit_Invalidate(JitContext *ctx, uint16_t address, size_t size)
+{
+}
+
+void jit_Flush(JitContext *ctx)
+{
+}
+
+#endif
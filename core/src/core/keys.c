@@ -21,22 +21,134 @@ static uint16_t KeyBitMap[16] = {
     CH8_IO_KEYF_BIT,
 };
 
+static void PushInputEdge(InputChannel *input, uint16_t keys);
+static void SignalInputChannel(InputChannel *input);
+
+void core_InitializeInputChannel(InputChannel *input)
+{
+    atomic_init(&input->keys, 0);
+    atomic_init(&input->edge_head, 0);
+    atomic_init(&input->edge_tail, 0);
+    atomic_init(&input->waiters, 0);
+    pthread_mutex_init(&input->lock, NULL);
+    pthread_cond_init(&input->changed, NULL);
+    input->interrupted = false;
+}
+
+void core_DestroyInputChannel(InputChannel *input)
+{
+    pthread_cond_destroy(&input->changed);
+    pthread_mutex_destroy(&input->lock);
+}
+
+void core_PressInputKey(InputChannel *input, uint16_t key_bit)
+{
+    uint16_t keys = atomic_fetch_or(&input->keys, key_bit);
+    if ((keys & key_bit) == 0)
+    {
+        PushInputEdge(input, keys | key_bit);
+        SignalInputChannel(input);
+    }
+}
+
+void core_ReleaseInputKey(InputChannel *input, uint16_t key_bit)
+{
+    uint16_t keys = atomic_fetch_and(&input->keys, (uint16_t)~key_bit);
+    if ((keys & key_bit) != 0)
+    {
+        PushInputEdge(input, keys & ~key_bit);
+        SignalInputChannel(input);
+    }
+}
+
+uint16_t core_GetInputKeys(InputChannel *input)
+{
+    return atomic_load_explicit(&input->keys, memory_order_relaxed);
+}
+
+uint16_t core_PollInputKeys(InputChannel *input)
+{
+    uint32_t tail = atomic_load_explicit(&input->edge_tail, memory_order_relaxed);
+    if (tail == atomic_load_explicit(&input->edge_head, memory_order_acquire))
+    {
+        return atomic_load_explicit(&input->keys, memory_order_relaxed);
+    }
+
+    uint16_t keys = input->edges[tail % CH8_INPUT_EDGE_CAPACITY];
+    atomic_store_explicit(&input->edge_tail, tail + 1, memory_order_release);
+    return keys;
+}
+
+void core_WaitInputChannel(InputChannel *input, uint16_t keys)
+{
+    pthread_mutex_lock(&input->lock);
+    // Seq-cst against the update in core_PressInputKey and core_ReleaseInputKey: either the
+    // update is seen below, or the updater sees a waiter and signals under the lock.
+    atomic_fetch_add(&input->waiters, 1);
+    while (!input->interrupted && atomic_load(&input->keys) == keys &&
+           atomic_load(&input->edge_head) == atomic_load_explicit(&input->edge_tail, memory_order_relaxed))
+    {
+        pthread_cond_wait(&input->changed, &input->lock);
+    }
+    atomic_fetch_sub(&input->waiters, 1);
+    pthread_mutex_unlock(&input->lock);
+}
+
+void core_InterruptInputChannel(InputChannel *input)
+{
+    pthread_mutex_lock(&input->lock);
+    input->interrupted = true;
+    pthread_cond_broadcast(&input->changed);
+    pthread_mutex_unlock(&input->lock);
+}
+
+void core_ResumeInputChannel(InputChannel *input)
+{
+    pthread_mutex_lock(&input->lock);
+    input->interrupted = false;
+    pthread_mutex_unlock(&input->lock);
+}
+
+// Drops the edge if the queue is full. The CPU then catches up from 'keys' once it drains.
+void PushInputEdge(InputChannel *input, uint16_t keys)
+{
+    uint32_t head = atomic_load_explicit(&input->edge_head, memory_order_relaxed);
+    if (head - atomic_load_explicit(&input->edge_tail, memory_order_acquire) >= CH8_INPUT_EDGE_CAPACITY)
+    {
+        return;
+    }
+
+    input->edges[head % CH8_INPUT_EDGE_CAPACITY] = keys;
+    atomic_store(&input->edge_head, head + 1);
+}
+
+// Only takes the lock when the CPU thread is blocked, so key updates stay lock-free otherwise.
+void SignalInputChannel(InputChannel *input)
+{
+    if (atomic_load(&input->waiters) == 0)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&input->lock);
+    pthread_cond_broadcast(&input->changed);
+    pthread_mutex_unlock(&input->lock);
+}
+
 uint16_t MapKeyBit(uint8_t key)
 {
     assert(key < 16);
     return KeyBitMap[key];
 }
 
-uint8_t MapBitKey(uint16_t bit)
+uint8_t MapBitKey(uint16_t bits)
 {
-    for(uint8_t i = 0; i < 16; i++)
+    // Key N is bit N, so the lowest key is the number of trailing zeroes.
+    if (bits == 0)
     {
-        if(KeyBitMap[i] == bit)
-        {
-            return i;
-        }
+        // Invalid return. No key.
+        return 0xFF;
     }
 
-    // Invalid return. No match.
-    return 0xFF;
+    return (uint8_t)__builtin_ctz(bits);
 }
@@ -0,0 +1,144 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "core/movie.h"
+#include "core/cpu.h"
+#include "memory/endian.h"
+
+static bool ReadEvent(FILE *file_pointer, uint64_t *cycle, uint16_t *keys);
+static uint64_t HashBytes(const void *data, size_t size);
+
+Movie *core_CreateMovieRecorder(const char *filename, const CPUState *cpu)
+{
+    FILE *file_pointer = fopen(filename, "wb");
+    if (file_pointer == NULL)
+    {
+        logger_LogError(cpu->logger, "Failed to create movie %s.", filename);
+        return NULL;
+    }
+
+    Movie *movie = calloc(1, sizeof(Movie));
+    movie->file = file_pointer;
+    movie->recording = true;
+    movie->header.machine = cpu->machine;
+    movie->header.clock_frequency = cpu->clock_target_frequency;
+    movie->header.seed = cpu->random_seed;
+    movie->header.program_hash = core_HashProgramMovie(cpu);
+    movie->header.start_cycle = cpu->cycles;
+    movie->next_cycle = UINT64_MAX;
+
+    uint8_t header[CH8_MOVIE_HEADER_SIZE];
+    size_t offset = 0;
+    memcpy(header, CH8_MOVIE_MAGIC, 4);
+    offset += 4;
+    WriteLittleEndian(header, &offset, CH8_MOVIE_VERSION, 2);
+    WriteLittleEndian(header, &offset, movie->header.machine, 1);
+    WriteLittleEndian(header, &offset, movie->header.clock_frequency, 4);
+    WriteLittleEndian(header, &offset, movie->header.seed, 8);
+    WriteLittleEndian(header, &offset, movie->header.program_hash, 8);
+    WriteLittleEndian(header, &offset, movie->header.start_cycle, 8);
+    fwrite(header, 1, offset, file_pointer);
+
+    return movie;
+}
+
+Movie *core_OpenMovie(const char *filename)
+{
+    FILE *file_pointer = fopen(filename, "rb");
+    if (file_pointer == NULL)
+    {
+        return NULL;
+    }
+
+    uint8_t header[CH8_MOVIE_HEADER_SIZE];
+    size_t offset = 4;
+    if (fread(header, 1, sizeof(header), file_pointer) != sizeof(header) ||
+        memcmp(header, CH8_MOVIE_MAGIC, 4) != 0 ||
+        ReadLittleEndian(header, &offset, 2) != CH8_MOVIE_VERSION)
+    {
+        fclose(file_pointer);
+        return NULL;
+    }
+
+    Movie *movie = calloc(1, sizeof(Movie));
+    movie->file = file_pointer;
+    movie->recording = false;
+    movie->header.machine = ReadLittleEndian(header, &offset, 1);
+    movie->header.clock_frequency = ReadLittleEndian(header, &offset, 4);
+    movie->header.seed = ReadLittleEndian(header, &offset, 8);
+    movie->header.program_hash = ReadLittleEndian(header, &offset, 8);
+    movie->header.start_cycle = ReadLittleEndian(header, &offset, 8);
+
+    // Events are fixed size, so the end is the last one.
+    movie->end_cycle = movie->header.start_cycle;
+    if (fseek(file_pointer, -CH8_MOVIE_EVENT_SIZE, SEEK_END) == 0 && ftell(file_pointer) >= CH8_MOVIE_HEADER_SIZE)
+    {
+        uint16_t keys;
+        ReadEvent(file_pointer, &movie->end_cycle, &keys);
+    }
+    fseek(file_pointer, CH8_MOVIE_HEADER_SIZE, SEEK_SET);
+
+    core_AdvanceMovie(movie);
+    return movie;
+}
+
+void core_DestroyMovie(Movie *movie)
+{
+    fclose(movie->file);
+    free(movie);
+}
+
+uint64_t core_HashProgramMovie(const CPUState *cpu)
+{
+    return HashBytes(cpu->memory + CH8_PROGRAM_START_ADDRESS, cpu->memory_size - CH8_PROGRAM_START_ADDRESS);
+}
+
+uint64_t core_HashDisplayCPU(const CPUState *cpu)
+{
+    return HashBytes(cpu->display.planes, sizeof(cpu->display.planes));
+}
+
+// FNV-1a.
+uint64_t HashBytes(const void *data, size_t size)
+{
+    const uint8_t *bytes = data;
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+void core_AdvanceMovie(Movie *movie)
+{
+    if (!ReadEvent(movie->file, &movie->next_cycle, &movie->next_keys))
+    {
+        movie->next_cycle = UINT64_MAX;
+    }
+}
+
+void core_WriteMovieEvent(Movie *movie, uint64_t cycle, uint16_t keys)
+{
+    uint8_t event[CH8_MOVIE_EVENT_SIZE];
+    size_t offset = 0;
+    WriteLittleEndian(event, &offset, cycle, 8);
+    WriteLittleEndian(event, &offset, keys, 2);
+    fwrite(event, 1, offset, movie->file);
+    movie->recorded_keys = keys;
+}
+
+bool ReadEvent(FILE *file_pointer, uint64_t *cycle, uint16_t *keys)
+{
+    uint8_t event[CH8_MOVIE_EVENT_SIZE];
+    if (fread(event, 1, sizeof(event), file_pointer) != sizeof(event))
+    {
+        return false;
+    }
+
+    size_t offset = 0;
+    *cycle = ReadLittleEndian(event, &offset, 8);
+    *keys = ReadLittleEndian(event, &offset, 2);
+    return true;
+}
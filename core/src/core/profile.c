@@ -0,0 +1,90 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "core/profile.h"
+#include "core/cpu.h"
+#include "core/memory.h"
+
+void core_ResetProfile(CPUProfile *profile)
+{
+    memset(profile, 0, sizeof(CPUProfile));
+}
+
+size_t core_GetProfileHotAddresses(const CPUProfile *profile, const CPUState *cpu, ProfileHotAddress *hot, size_t max_hot)
+{
+    size_t n_hot = 0;
+    uint64_t previous = UINT64_MAX;
+    size_t previous_slot = CH8_PROFILE_ADDRESS_SLOTS;
+    for (; n_hot < max_hot; n_hot++)
+    {
+        // Next slot in (count descending, address ascending) order. Callers ask for a handful,
+        // so repeated scans beat sorting the whole table.
+        size_t best = CH8_PROFILE_ADDRESS_SLOTS;
+        for (size_t slot = 0; slot < CH8_PROFILE_ADDRESS_SLOTS; slot++)
+        {
+            uint64_t count = profile->address_counts[slot];
+            bool after_previous = count < previous || (count == previous && slot > previous_slot);
+            if (count > 0 && after_previous && (best == CH8_PROFILE_ADDRESS_SLOTS || count > profile->address_counts[best]))
+                best = slot;
+        }
+        if (best == CH8_PROFILE_ADDRESS_SLOTS)
+            break;
+
+        previous = profile->address_counts[best];
+        previous_slot = best;
+
+        DecodedInstruction instruction;
+        uint16_t address = best << 1;
+        core_DecodeInstruction(PEEK_16BIT(cpu->memory, address, cpu->memory_size - 1), &instruction);
+        hot[n_hot] = (ProfileHotAddress){
+            .address = address,
+            .opcode = instruction.opcode,
+            .op = instruction.op,
+            .count = previous,
+        };
+    }
+
+    return n_hot;
+}
+
+void core_PrintProfile(const CPUProfile *profile, const CPUState *cpu, size_t top_n, FILE *out)
+{
+    fprintf(out, "Instructions: %llu\n", (unsigned long long)profile->instructions);
+    if (profile->instructions == 0)
+    {
+        return;
+    }
+
+    fprintf(out, "\nOpcode mix:\n");
+    bool printed[OP_COUNT] = {0};
+    for (;;)
+    {
+        // Print in descending order of count. OP_COUNT is small, so selection is fine.
+        int best = -1;
+        for (int op = 0; op < OP_COUNT; op++)
+        {
+            if (!printed[op] && profile->op_counts[op] > 0 && (best < 0 || profile->op_counts[op] > profile->op_counts[best]))
+                best = op;
+        }
+        if (best < 0)
+            break;
+
+        printed[best] = true;
+        fprintf(out, "  %-16s %12llu %6.2f%%\n", core_GetInstructionOpName(best), (unsigned long long)profile->op_counts[best],
+                100.0 * profile->op_counts[best] / profile->instructions);
+    }
+
+    ProfileHotAddress *hot = calloc(top_n, sizeof(ProfileHotAddress));
+    size_t n_hot = core_GetProfileHotAddresses(profile, cpu, hot, top_n);
+    fprintf(out, "\nHottest addresses:\n");
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i < n_hot; i++)
+    {
+        // The cumulative share shows how much of the run a handful of loops covers.
+        cumulative += hot[i].count;
+        fprintf(out, "  0x%03X  %04X %-8s %12llu %6.2f%% %6.2f%%\n", hot[i].address, hot[i].opcode,
+                core_GetInstructionOpName(hot[i].op), (unsigned long long)hot[i].count,
+                100.0 * hot[i].count / profile->instructions, 100.0 * cumulative / profile->instructions);
+    }
+    free(hot);
+}
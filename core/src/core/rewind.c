@@ -0,0 +1,199 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "core/rewind.h"
+#include "memory/endian.h"
+
+// Shorter runs of equal bytes stay inside a literal. See CH8_REWIND_MAX_RECORD_SIZE.
+#define REWIND_MIN_SKIP (8)
+
+static const uint8_t zero_state[CH8_STATE_SIZE];
+
+static size_t EncodeDelta(const uint8_t *base, const uint8_t *state, size_t state_size, uint8_t *out);
+static void DecodeDelta(const uint8_t *base, const uint8_t *delta, size_t delta_size, size_t state_size, uint8_t *state);
+static size_t ReserveFrame(RewindBuffer *rewind);
+static void EvictOldestFrame(RewindBuffer *rewind);
+static RewindEntry *GetEntry(RewindBuffer *rewind, size_t index);
+
+RewindBuffer *core_CreateRewindBuffer(size_t buffer_size, size_t max_frames, uint32_t keyframe_interval)
+{
+    if (buffer_size < CH8_REWIND_MAX_RECORD_SIZE || max_frames == 0)
+    {
+        return NULL;
+    }
+
+    RewindBuffer *rewind = calloc(1, sizeof(RewindBuffer));
+    rewind->data = malloc(buffer_size);
+    rewind->data_size = buffer_size;
+    rewind->entries = calloc(max_frames, sizeof(RewindEntry));
+    rewind->max_entries = max_frames;
+    rewind->keyframe_interval = keyframe_interval > 0 ? keyframe_interval : 1;
+    return rewind;
+}
+
+void core_DestroyRewindBuffer(RewindBuffer *rewind)
+{
+    free(rewind->entries);
+    free(rewind->data);
+    free(rewind);
+}
+
+void core_PushRewindFrame(RewindBuffer *rewind, const CPUState *cpu)
+{
+    size_t state_size = core_SaveState(cpu, rewind->state, sizeof(rewind->state));
+
+    size_t offset = ReserveFrame(rewind);
+
+    // Start a new keyframe on schedule, when eviction took the current one, or when the machine
+    // and with it the state size changed.
+    bool keyframe = rewind->frames_since_keyframe == 0 ||
+                    rewind->frames_since_keyframe >= rewind->keyframe_interval ||
+                    rewind->entries_count < rewind->frames_since_keyframe ||
+                    rewind->keyframe_state_size != state_size;
+    if (keyframe)
+    {
+        rewind->frames_since_keyframe = 0;
+        memcpy(rewind->keyframe_state, rewind->state, state_size);
+        rewind->keyframe_state_size = state_size;
+    }
+
+    const uint8_t *base = keyframe ? zero_state : rewind->keyframe_state;
+    RewindEntry *entry = GetEntry(rewind, rewind->entries_count++);
+    entry->offset = offset;
+    entry->size = EncodeDelta(base, rewind->state, state_size, rewind->data + offset);
+    entry->state_size = state_size;
+    entry->keyframe_distance = rewind->frames_since_keyframe++;
+    rewind->head = offset + entry->size;
+}
+
+size_t core_GetRewindFrameCount(const RewindBuffer *rewind)
+{
+    return rewind->entries_count;
+}
+
+bool core_RewindCPU(RewindBuffer *rewind, CPUState *cpu, size_t frames)
+{
+    if (rewind->entries_count == 0)
+    {
+        return false;
+    }
+
+    size_t index = frames < rewind->entries_count ? rewind->entries_count - 1 - frames : 0;
+    const RewindEntry *entry = GetEntry(rewind, index);
+    const RewindEntry *keyframe = GetEntry(rewind, index - entry->keyframe_distance);
+
+    // A keyframe is encoded against zeroes, so it must not be applied on top of itself.
+    // Decode into scratch: if the load fails, recording goes on against the current keyframe.
+    const uint8_t *base = entry == keyframe ? zero_state : rewind->seek_keyframe_state;
+    DecodeDelta(zero_state, rewind->data + keyframe->offset, keyframe->size, keyframe->state_size, rewind->seek_keyframe_state);
+    DecodeDelta(base, rewind->data + entry->offset, entry->size, entry->state_size, rewind->state);
+    if (!core_LoadState(cpu, rewind->state, entry->state_size))
+    {
+        return false;
+    }
+    memcpy(rewind->keyframe_state, rewind->seek_keyframe_state, keyframe->state_size);
+    rewind->keyframe_state_size = keyframe->state_size;
+
+    // Recording continues from the restored frame, against the same keyframe.
+    rewind->entries_count = index + 1;
+    rewind->head = entry->offset + entry->size;
+    rewind->frames_since_keyframe = entry->keyframe_distance + 1;
+    return true;
+}
+
+size_t EncodeDelta(const uint8_t *base, const uint8_t *state, size_t state_size, uint8_t *out)
+{
+    size_t out_size = 0;
+    size_t previous_end = 0;
+    size_t i = 0;
+    for (;;)
+    {
+        while (i < state_size && base[i] == state[i])
+            i++;
+        if (i == state_size)
+            break;
+
+        // Extend the literal until REWIND_MIN_SKIP equal bytes in a row, or the end.
+        size_t start = i;
+        size_t end = i + 1;
+        for (size_t equal = 0; i < state_size && equal < REWIND_MIN_SKIP; i++)
+        {
+            if (base[i] == state[i])
+            {
+                equal++;
+            }
+            else
+            {
+                equal = 0;
+                end = i + 1;
+            }
+        }
+        i = end;
+
+        // States are larger than 64 KiB on XO-CHIP, so both fields take 32 bits.
+        WriteLittleEndian(out, &out_size, start - previous_end, 4);
+        WriteLittleEndian(out, &out_size, end - start, 4);
+        for (size_t j = start; j < end; j++)
+            out[out_size++] = base[j] ^ state[j];
+        previous_end = end;
+    }
+
+    return out_size;
+}
+
+void DecodeDelta(const uint8_t *base, const uint8_t *delta, size_t delta_size, size_t state_size, uint8_t *state)
+{
+    memcpy(state, base, state_size);
+
+    size_t position = 0;
+    for (size_t i = 0; i < delta_size;)
+    {
+        position += ReadLittleEndian(delta, &i, 4);
+        size_t length = ReadLittleEndian(delta, &i, 4);
+        for (size_t j = 0; j < length; j++)
+            state[position++] ^= delta[i++];
+    }
+}
+
+// Frees room for a frame of up to CH8_REWIND_MAX_RECORD_SIZE bytes and returns its offset.
+// Live frames lie between 'head' and the end of the oldest frame, wrapping around the end
+// of 'data', so the oldest frames are always the first in the way.
+size_t ReserveFrame(RewindBuffer *rewind)
+{
+    if (rewind->entries_count == rewind->max_entries)
+    {
+        EvictOldestFrame(rewind);
+    }
+
+    size_t offset = rewind->head;
+    if (offset + CH8_REWIND_MAX_RECORD_SIZE > rewind->data_size)
+    {
+        // Too close to the end. Drop what's stored past the head and wrap around.
+        while (rewind->entries_count > 0 && GetEntry(rewind, 0)->offset >= offset)
+            EvictOldestFrame(rewind);
+        offset = 0;
+    }
+
+    while (rewind->entries_count > 0 && GetEntry(rewind, 0)->offset >= offset &&
+           GetEntry(rewind, 0)->offset < offset + CH8_REWIND_MAX_RECORD_SIZE)
+    {
+        EvictOldestFrame(rewind);
+    }
+
+    return offset;
+}
+
+// Drops the oldest frame, and any deltas left without their keyframe.
+void EvictOldestFrame(RewindBuffer *rewind)
+{
+    do
+    {
+        rewind->first_entry = (rewind->first_entry + 1) % rewind->max_entries;
+        rewind->entries_count--;
+    } while (rewind->entries_count > 0 && GetEntry(rewind, 0)->keyframe_distance != 0);
+}
+
+RewindEntry *GetEntry(RewindBuffer *rewind, size_t index)
+{
+    return &rewind->entries[(rewind->first_entry + index) % rewind->max_entries];
+}
@@ -0,0 +1,154 @@
+#include <string.h>
+
+#include "core/state.h"
+#include "core/cpu.h"
+#include "memory/endian.h"
+
+size_t core_SaveState(const CPUState *cpu, uint8_t *buffer, size_t buffer_size)
+{
+    if (buffer_size < CH8_STATE_SIZE_FOR_MEMORY(cpu->memory_size))
+    {
+        return 0;
+    }
+
+    size_t offset = 0;
+    memcpy(buffer, CH8_STATE_MAGIC, 4);
+    offset += 4;
+    WriteLittleEndian(buffer, &offset, CH8_STATE_VERSION, 2);
+    WriteLittleEndian(buffer, &offset, cpu->machine, 1);
+
+    memcpy(buffer + offset, cpu->memory, cpu->memory_size);
+    offset += cpu->memory_size;
+
+    memcpy(buffer + offset, cpu->variable_registers, CH8_VREG_COUNT);
+    offset += CH8_VREG_COUNT;
+    WriteLittleEndian(buffer, &offset, cpu->program_counter, 2);
+    WriteLittleEndian(buffer, &offset, cpu->index_register, 2);
+
+    for (size_t i = 0; i < CH8_STACK_DEPTH; i++)
+        WriteLittleEndian(buffer, &offset, cpu->stack[i], 2);
+    WriteLittleEndian(buffer, &offset, cpu->stack_pointer - cpu->stack, 1);
+
+    WriteLittleEndian(buffer, &offset, cpu->delay_timer, 1);
+    WriteLittleEndian(buffer, &offset, cpu->sound_timer, 1);
+
+    WriteLittleEndian(buffer, &offset, cpu->clock_target_frequency, 4);
+    WriteLittleEndian(buffer, &offset, cpu->cycles_per_timer_tick, 8);
+    WriteLittleEndian(buffer, &offset, cpu->cycles, 8);
+    WriteLittleEndian(buffer, &offset, cpu->next_timer_tick_cycle, 8);
+
+    for (size_t i = 0; i < 4; i++)
+        WriteLittleEndian(buffer, &offset, cpu->random_state.s[i], 8);
+
+    WriteLittleEndian(buffer, &offset, cpu->display.hires, 1);
+    WriteLittleEndian(buffer, &offset, cpu->display.selected_planes, 1);
+    WriteLittleEndian(buffer, &offset, cpu->display.plane_mask, 1);
+    for (size_t plane = 0; plane < CH8_DISPLAY_PLANE_COUNT; plane++)
+        for (size_t y = 0; y < CH8_DISPLAY_HIRES_HEIGHT; y++)
+            for (size_t word = 0; word < CH8_DISPLAY_ROW_WORDS; word++)
+                WriteLittleEndian(buffer, &offset, cpu->display.planes[plane][word][y], 8);
+
+    memcpy(buffer + offset, cpu->audio_pattern, CH8_AUDIO_PATTERN_SIZE);
+    offset += CH8_AUDIO_PATTERN_SIZE;
+    WriteLittleEndian(buffer, &offset, cpu->audio_pitch, 1);
+
+    return offset;
+}
+
+bool core_LoadState(CPUState *cpu, const uint8_t *buffer, size_t buffer_size)
+{
+    size_t offset = 0;
+    if (buffer_size < CH8_STATE_SIZE_FOR_MEMORY(CH8_MEM_SIZE) || memcmp(buffer, CH8_STATE_MAGIC, 4) != 0)
+    {
+        logger_LogError(cpu->logger, "Not a CHIP-8 save state.");
+        return false;
+    }
+    offset += 4;
+    if (ReadLittleEndian(buffer, &offset, 2) != CH8_STATE_VERSION)
+    {
+        logger_LogError(cpu->logger, "Unsupported save state version. Expected %d.", CH8_STATE_VERSION);
+        return false;
+    }
+    // Validate everything that could corrupt the CPU before changing it.
+    uint8_t machine = buffer[offset];
+    if (machine >= CPU_MACHINE_COUNT)
+    {
+        logger_LogError(cpu->logger, "Save state is of unknown machine %d.", machine);
+        return false;
+    }
+    offset += 1;
+    size_t memory_size = machine == CPU_MACHINE_XOCHIP ? CH8_XO_MEM_SIZE : CH8_MEM_SIZE;
+    if (buffer_size < CH8_STATE_SIZE_FOR_MEMORY(memory_size))
+    {
+        logger_LogError(cpu->logger, "Save state is truncated.");
+        return false;
+    }
+    size_t stack_depth_offset = offset + memory_size + CH8_VREG_COUNT + 4 + CH8_STACK_DEPTH * 2;
+    if (buffer[stack_depth_offset] > CH8_STACK_DEPTH)
+    {
+        logger_LogError(cpu->logger, "Save state has a stack depth of %d.", buffer[stack_depth_offset]);
+        return false;
+    }
+    // Pacing divides by the frequency. The scheduler runs up to the next timer tick, so it must
+    // lie ahead and ticks must advance.
+    size_t clock_offset = stack_depth_offset + 1 + 2;
+    uint32_t clock_target_frequency = ReadLittleEndian(buffer, &clock_offset, 4);
+    uint64_t cycles_per_timer_tick = ReadLittleEndian(buffer, &clock_offset, 8);
+    uint64_t cycles = ReadLittleEndian(buffer, &clock_offset, 8);
+    uint64_t next_timer_tick_cycle = ReadLittleEndian(buffer, &clock_offset, 8);
+    if (clock_target_frequency == 0 || cycles_per_timer_tick == 0 || next_timer_tick_cycle <= cycles)
+    {
+        logger_LogError(cpu->logger, "Save state has an invalid clock.");
+        return false;
+    }
+
+    cpu->machine = machine;
+    cpu->memory_size = memory_size;
+
+    // Memory past 'memory_size' isn't addressable, so what it holds doesn't matter.
+    memcpy(cpu->memory, buffer + offset, memory_size);
+    offset += memory_size;
+    // Decoded instructions and compiled blocks belong to the previous image, and maybe machine.
+    core_FlushDecodedCPU(cpu);
+
+    memcpy(cpu->variable_registers, buffer + offset, CH8_VREG_COUNT);
+    offset += CH8_VREG_COUNT;
+    // PC and return addresses always lie inside memory. See ExecuteNextCPU.
+    cpu->program_counter = ReadLittleEndian(buffer, &offset, 2) & (memory_size - 1);
+    // Re-learned the next time FX0A, 2NNN or 00EE executes.
+    cpu->waiting_for_key = false;
+    cpu->stack_fault = false;
+    cpu->index_register = ReadLittleEndian(buffer, &offset, 2);
+
+    for (size_t i = 0; i < CH8_STACK_DEPTH; i++)
+        cpu->stack[i] = ReadLittleEndian(buffer, &offset, 2) & (memory_size - 1);
+    cpu->stack_pointer = cpu->stack + ReadLittleEndian(buffer, &offset, 1);
+
+    cpu->delay_timer = ReadLittleEndian(buffer, &offset, 1);
+    cpu->sound_timer = ReadLittleEndian(buffer, &offset, 1);
+
+    cpu->clock_target_frequency = ReadLittleEndian(buffer, &offset, 4);
+    cpu->cycles_per_timer_tick = ReadLittleEndian(buffer, &offset, 8);
+    cpu->cycles = ReadLittleEndian(buffer, &offset, 8);
+    cpu->next_timer_tick_cycle = ReadLittleEndian(buffer, &offset, 8);
+
+    for (size_t i = 0; i < 4; i++)
+        cpu->random_state.s[i] = ReadLittleEndian(buffer, &offset, 8);
+
+    cpu->display.hires = ReadLittleEndian(buffer, &offset, 1) != 0;
+    cpu->display.selected_planes = ReadLittleEndian(buffer, &offset, 1) & CH8_DISPLAY_ALL_PLANES;
+    cpu->display.plane_mask = ReadLittleEndian(buffer, &offset, 1) & CH8_DISPLAY_ALL_PLANES;
+    for (size_t plane = 0; plane < CH8_DISPLAY_PLANE_COUNT; plane++)
+        for (size_t y = 0; y < CH8_DISPLAY_HIRES_HEIGHT; y++)
+            for (size_t word = 0; word < CH8_DISPLAY_ROW_WORDS; word++)
+                cpu->display.planes[plane][word][y] = ReadLittleEndian(buffer, &offset, 8);
+    cpu->display.dirty_rows = UINT64_MAX;
+    core_PublishDisplay(&cpu->display);
+
+    memcpy(cpu->audio_pattern, buffer + offset, CH8_AUDIO_PATTERN_SIZE);
+    offset += CH8_AUDIO_PATTERN_SIZE;
+    cpu->audio_pitch = ReadLittleEndian(buffer, &offset, 1);
+    cpu->audio_pattern_dirty = true;
+
+    return true;
+}
@@ -0,0 +1,104 @@
+#include <string.h>
+
+#include "core/trace.h"
+#include "memory/endian.h"
+
+void core_WriteTraceHeader(TraceWriter *writer)
+{
+    uint8_t header[6];
+    size_t offset = 0;
+    memcpy(header, CH8_TRACE_MAGIC, 4);
+    offset += 4;
+    WriteLittleEndian(header, &offset, CH8_TRACE_VERSION, 2);
+    logger_WriteTrace(writer, header, offset);
+}
+
+void core_WriteTraceRecord(TraceWriter *writer, const CPUTraceRecord *record)
+{
+    uint8_t *buffer = logger_ReserveTrace(writer, CH8_TRACE_RECORD_MAX_SIZE);
+    if (buffer == NULL)
+    {
+        return;
+    }
+
+    size_t offset = 0;
+    WriteLittleEndian(buffer, &offset, (uint32_t)record->cycle, 4);
+    WriteLittleEndian(buffer, &offset, record->address, 2);
+    WriteLittleEndian(buffer, &offset, record->opcode, 2);
+    WriteLittleEndian(buffer, &offset, record->changed, 4);
+
+    for (uint32_t changed = record->changed & CH8_TRACE_CHANGED_VREGS; changed != 0; changed &= changed - 1)
+    {
+        buffer[offset++] = record->variable_registers[__builtin_ctz(changed)];
+    }
+    if (record->changed & CH8_TRACE_CHANGED_I)
+        WriteLittleEndian(buffer, &offset, record->index_register, 2);
+    if (record->changed & CH8_TRACE_CHANGED_DELAY_TIMER)
+        buffer[offset++] = record->delay_timer;
+    if (record->changed & CH8_TRACE_CHANGED_SOUND_TIMER)
+        buffer[offset++] = record->sound_timer;
+    if (record->changed & CH8_TRACE_CHANGED_STACK)
+        buffer[offset++] = record->stack_depth;
+
+    logger_CommitTrace(writer, offset);
+}
+
+bool core_ReadTraceHeader(FILE *file_pointer)
+{
+    uint8_t header[6];
+    if (fread(header, 1, sizeof(header), file_pointer) != sizeof(header) || memcmp(header, CH8_TRACE_MAGIC, 4) != 0)
+    {
+        return false;
+    }
+
+    size_t offset = 4;
+    return ReadLittleEndian(header, &offset, 2) == CH8_TRACE_VERSION;
+}
+
+bool core_ReadTraceRecord(FILE *file_pointer, CPUTraceRecord *record)
+{
+    uint8_t buffer[CH8_TRACE_RECORD_MAX_SIZE];
+    if (fread(buffer, 1, CH8_TRACE_RECORD_HEADER_SIZE, file_pointer) != CH8_TRACE_RECORD_HEADER_SIZE)
+    {
+        return false;
+    }
+
+    size_t offset = 0;
+    uint32_t cycle = ReadLittleEndian(buffer, &offset, 4);
+    record->address = ReadLittleEndian(buffer, &offset, 2);
+    record->opcode = ReadLittleEndian(buffer, &offset, 2);
+    record->changed = ReadLittleEndian(buffer, &offset, 4);
+
+    // Unwrap the 32-bit cycle against the previous record.
+    uint64_t unwrapped = (record->cycle & ~(uint64_t)UINT32_MAX) | cycle;
+    if (unwrapped < record->cycle)
+    {
+        unwrapped += (uint64_t)UINT32_MAX + 1;
+    }
+    record->cycle = unwrapped;
+
+    size_t payload_size = __builtin_popcount(record->changed & (CH8_TRACE_CHANGED_VREGS | CH8_TRACE_CHANGED_DELAY_TIMER |
+                                                                  CH8_TRACE_CHANGED_SOUND_TIMER | CH8_TRACE_CHANGED_STACK));
+    if (record->changed & CH8_TRACE_CHANGED_I)
+        payload_size += 2;
+    if (fread(buffer, 1, payload_size, file_pointer) != payload_size)
+    {
+        return false;
+    }
+
+    offset = 0;
+    for (uint32_t changed = record->changed & CH8_TRACE_CHANGED_VREGS; changed != 0; changed &= changed - 1)
+    {
+        record->variable_registers[__builtin_ctz(changed)] = buffer[offset++];
+    }
+    if (record->changed & CH8_TRACE_CHANGED_I)
+        record->index_register = ReadLittleEndian(buffer, &offset, 2);
+    if (record->changed & CH8_TRACE_CHANGED_DELAY_TIMER)
+        record->delay_timer = buffer[offset++];
+    if (record->changed & CH8_TRACE_CHANGED_SOUND_TIMER)
+        record->sound_timer = buffer[offset++];
+    if (record->changed & CH8_TRACE_CHANGED_STACK)
+        record->stack_depth = buffer[offset++];
+
+    return true;
+}
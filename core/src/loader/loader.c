@@ -7,19 +7,7 @@
 #include "loader/loader.h"
 #include "loader/convert.h"
 
-static Logger *logger;
-
-void core_InitializeLoader(LogLevel log_level)
-{
-    logger = logger_Initialize(LOGS_BASE_PATH "loader.log", log_level);
-}
-
-void core_DestroyLoader()
-{
-    logger_Destroy(logger);
-}
-
-uint32_t core_LoadElf32File(const char *filename, uint8_t *region, size_t region_size)
+uint32_t core_LoadElf32File(const Logger *logger, const char *filename, uint8_t *region, size_t region_size)
 {
     FILE *fp;
     Elf32_Ehdr eh;
@@ -102,7 +90,7 @@ uint32_t core_LoadElf32File(const char *filename, uint8_t *region, size_t region
     return eh.e_entry;
 }
 
-uint16_t core_LoadBinary16File(const char *filename, uint8_t *region, uint16_t offset, size_t region_size)
+size_t core_LoadBinary16File(const Logger *logger, const char *filename, uint8_t *region, uint16_t offset, size_t region_size)
 {
     FILE *fp;
 
@@ -125,15 +113,14 @@ uint16_t core_LoadBinary16File(const char *filename, uint8_t *region, uint16_t o
         raise(SIGABRT);
     }
 
-    uint8_t file_buffer[size];
     fread(&region[offset], size, 1, fp);
 
     fclose(fp);
 
-    return offset + (uint16_t)size;
+    return offset + size;
 }
 
-uint16_t core_LoadBinary16Data(uint8_t *region, uint16_t offset, size_t region_size, uint8_t *data, size_t data_size)
+size_t core_LoadBinary16Data(const Logger *logger, uint8_t *region, uint16_t offset, size_t region_size, uint8_t *data, size_t data_size)
 {
     if (offset + data_size > region_size)
     {
@@ -145,5 +132,5 @@ uint16_t core_LoadBinary16Data(uint8_t *region, uint16_t offset, size_t region_s
     memcpy(&region[offset], data, data_size);
     logger_LogInfo(logger, "Loaded 16-bit binary data of size %zx starting at offset 0x%04X.", data_size, offset);
 
-    return offset + (uint16_t)data_size;
+    return offset + data_size;
 }
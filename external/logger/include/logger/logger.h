@@ -2,6 +2,8 @@
 #define LOGGER_H
 
 #include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
 #include <pthread.h>
 
 #ifdef CH8_LOGS_DIR
@@ -12,6 +14,10 @@
 
 #define MAX_FILENAME_SIZE 256
 
+// Records are formatted on the caller's thread into fixed-size slots. Longer messages are truncated.
+#define LOGGER_ASYNC_MESSAGE_SIZE (256)
+#define LOGGER_ASYNC_DEFAULT_CAPACITY (4096)
+
 typedef enum LogLevel
 {
     LOG_LEVEL_NONE = 0,
@@ -23,6 +29,22 @@ typedef enum LogLevel
     LOG_LEVEL_FULL = 15
 } LogLevel;
 
+// What a producer does when the asynchronous ring buffer is full.
+typedef enum LoggerOverflowPolicy
+{
+    // Discard the record and count it in LoggerAsyncStats.records_dropped. Never blocks.
+    LOGGER_OVERFLOW_DROP = 0,
+    // Wait for the writer thread to free a slot.
+    LOGGER_OVERFLOW_BLOCK = 1
+} LoggerOverflowPolicy;
+
+typedef struct LoggerAsyncStats
+{
+    uint64_t records_written;
+    uint64_t records_dropped;
+    uint64_t batches_written;
+} LoggerAsyncStats;
+
 typedef struct Logger
 {
     FILE *file_pointer;
@@ -32,6 +54,9 @@ typedef struct Logger
 
 Logger *logger_Initialize(char *filename, LogLevel log_level);
 
+// All logging functions accept a NULL logger and treat it as LOG_LEVEL_NONE.
+// This lets headless components run without opening a log file.
+
 int logger_SetLogLevel(Logger *logger, LogLevel log_level);
 
 int logger_LogError(const Logger *logger, const char *format, ...);
@@ -44,7 +69,40 @@ int logger_LogDebug(const Logger *logger, const char *format, ...);
 
 int logger_LogTrace(const Logger *logger, const char *format, ...);
 
+// Logging on hot paths, such as once per emulated instruction. Compiled out entirely
+// unless built with CH8_TRACE. Arguments are still type-checked but never evaluated.
+#ifdef CH8_TRACE
+#define LOGGER_TRACE_ENABLED (1)
+#define LOGGER_TRACE_DEBUG(logger, ...) logger_LogDebug((logger), __VA_ARGS__)
+#else
+#define LOGGER_TRACE_ENABLED (0)
+#define LOGGER_TRACE_DEBUG(logger, ...)            \
+    do                                             \
+    {                                              \
+        if (0)                                     \
+            logger_LogDebug((logger), __VA_ARGS__); \
+    } while (0)
+#endif
+
 void logger_Destroy(Logger *logger);
 
+/// @brief Moves file I/O for all loggers onto a background writer thread.
+/// @details Producers format into a lock-free multi-producer ring buffer. The writer drains
+/// it in batches and flushes each log file once per batch. Until this is called, and after
+/// logger_StopAsync, records are written synchronously on the caller's thread.
+/// @param capacity number of record slots. Rounded up to a power of two. LOGGER_ASYNC_DEFAULT_CAPACITY if 0.
+/// @param policy what producers do when the buffer is full.
+/// @return true if the writer thread was started or is already running.
+bool logger_StartAsync(size_t capacity, LoggerOverflowPolicy policy);
+
+/// @brief Writes all pending records, then stops the writer thread.
+void logger_StopAsync();
+
+/// @brief Blocks until every record logged before the call has been written to file.
+void logger_FlushAsync();
+
+/// @brief Returns counters of the asynchronous backend since logger_StartAsync.
+LoggerAsyncStats logger_GetAsyncStats();
+
 
 #endif
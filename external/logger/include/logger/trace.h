@@ -0,0 +1,87 @@
+#ifndef LOGGER_TRACE_H
+#define LOGGER_TRACE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+// Small enough to stay in L2 while records are appended.
+#define TRACE_DEFAULT_BUFFER_SIZE (64 * 1024)
+
+// Buffered sink for fixed-layout binary records. Producers append raw bytes and the
+// buffer is written out in one fwrite once full, so a record costs a memcpy.
+// Not thread-safe. Give each producing thread its own writer.
+typedef struct TraceWriter
+{
+    FILE *file_pointer;
+    uint8_t *buffer;
+    size_t buffer_size;
+    size_t buffer_used;
+    // Runtime gate. Records written while disabled are discarded.
+    bool enabled;
+    uint64_t bytes_written;
+} TraceWriter;
+
+/// @brief Opens 'filename' for writing and creates an enabled trace writer.
+/// @param filename file to write trace to. Truncated if it exists.
+/// @param buffer_size bytes buffered before writing to file. TRACE_DEFAULT_BUFFER_SIZE if 0.
+/// @return handle to writer, or NULL if the file can't be opened.
+TraceWriter *logger_CreateTraceWriter(const char *filename, size_t buffer_size);
+
+/// @brief Writes buffered records to file.
+void logger_FlushTraceWriter(TraceWriter *writer);
+
+/// @brief Flushes, closes the file and frees the writer. Accepts NULL.
+void logger_DestroyTraceWriter(TraceWriter *writer);
+
+/// @brief Enables or disables recording without closing the file.
+void logger_SetTraceEnabled(TraceWriter *writer, bool enabled);
+
+/// @brief Appends 'size' bytes to the trace. Kept inline so the common case is a bounds check and a memcpy.
+/// @param writer writer to append to.
+/// @param data record to append. Must be smaller than the writer's buffer.
+/// @param size size of record in bytes.
+static inline void logger_WriteTrace(TraceWriter *writer, const void *data, size_t size)
+{
+    if (!writer->enabled)
+    {
+        return;
+    }
+
+    if (writer->buffer_used + size > writer->buffer_size)
+    {
+        logger_FlushTraceWriter(writer);
+    }
+
+    memcpy(writer->buffer + writer->buffer_used, data, size);
+    writer->buffer_used += size;
+}
+
+/// @brief Returns space for a record of up to 'max_size' bytes directly in the writer's buffer.
+/// @details Lets producers encode in place instead of into a temporary. Must be followed by
+/// logger_CommitTrace before the next write.
+/// @return pointer to at least 'max_size' bytes, or NULL if the writer is disabled.
+static inline uint8_t *logger_ReserveTrace(TraceWriter *writer, size_t max_size)
+{
+    if (!writer->enabled)
+    {
+        return NULL;
+    }
+
+    if (writer->buffer_used + max_size > writer->buffer_size)
+    {
+        logger_FlushTraceWriter(writer);
+    }
+
+    return writer->buffer + writer->buffer_used;
+}
+
+/// @brief Appends the first 'size' bytes of the space returned by logger_ReserveTrace.
+static inline void logger_CommitTrace(TraceWriter *writer, size_t size)
+{
+    writer->buffer_used += size;
+}
+
+#endif
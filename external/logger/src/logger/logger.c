@@ -4,16 +4,67 @@
 #include <time.h>
 #include <stdlib.h>
 #include <signal.h>
+#include <sched.h>
+#include <stdatomic.h>
 
 #include "logger/logger.h"
 
+// Records drained by the writer thread before the touched files are flushed.
+#define ASYNC_BATCH_SIZE (256)
+// Upper bound on how long the writer sleeps if a wake-up is missed.
+#define ASYNC_IDLE_WAIT_NS (50 * 1000 * 1000)
+
+// One slot of the ring buffer. 'sequence' hands the slot back and forth between producers and the writer:
+// it equals the enqueue position when free, and position + 1 once the record is committed.
+typedef struct AsyncRecord
+{
+    atomic_size_t sequence;
+    const Logger *logger;
+    const char *log_level;
+    time_t timestamp;
+    char message[LOGGER_ASYNC_MESSAGE_SIZE];
+} AsyncRecord;
+
+// Bounded multi-producer single-consumer queue with per-slot sequence numbers.
+typedef struct AsyncBackend
+{
+    atomic_bool enabled;
+    atomic_bool running;
+    // Producers inside LogWrite that may still enqueue. The ring isn't freed until it drops to 0.
+    atomic_size_t producers;
+    LoggerOverflowPolicy policy;
+    AsyncRecord *records;
+    size_t mask;
+    atomic_size_t enqueue_position;
+    // Only touched by the writer thread.
+    size_t dequeue_position;
+    // Every record before this position has been written and flushed.
+    atomic_size_t written_position;
+    pthread_t thread_id;
+    atomic_bool writer_sleeping;
+    pthread_mutex_t wake_mutex;
+    pthread_cond_t wake_cond;
+    atomic_uint_least64_t records_written;
+    atomic_uint_least64_t records_dropped;
+    atomic_uint_least64_t batches_written;
+} AsyncBackend;
+
 static int LogWrite(const Logger *logger, const char *log_level, const char *format, va_list args);
+static void WriteHeader(FILE *file_pointer, time_t timestamp, const char *log_level);
+static int AsyncEnqueue(const Logger *logger, const char *log_level, const char *format, va_list args);
+static size_t AsyncWriteBatch();
+static void AsyncWakeWriter();
+static void *RunAsyncWriter(void *vargp);
 static pthread_mutex_t _mutex = PTHREAD_MUTEX_INITIALIZER;
+static AsyncBackend _async = {
+    .wake_mutex = PTHREAD_MUTEX_INITIALIZER,
+    .wake_cond = PTHREAD_COND_INITIALIZER,
+};
 
 Logger *logger_Initialize(char *filename, LogLevel log_level)
 {
     Logger *logger = calloc(1, sizeof(Logger));
-    logger->filename = realloc(logger->filename, strlen(filename));
+    logger->filename = malloc(strlen(filename) + 1);
     strcpy(logger->filename, filename);
     logger->log_level = log_level;
 
@@ -34,7 +85,7 @@ int logger_SetLogLevel(Logger *logger, LogLevel log_level)
 
 int logger_LogError(const Logger *logger, const char *format, ...)
 {
-    if (logger->log_level < LOG_LEVEL_ERROR)
+    if (logger == NULL || logger->log_level < LOG_LEVEL_ERROR)
     {
         return 0;
     }
@@ -49,7 +100,7 @@ int logger_LogError(const Logger *logger, const char *format, ...)
 
 int logger_LogEvent(const Logger *logger, const char *format, ...)
 {
-    if (logger->log_level < LOG_LEVEL_EVENT)
+    if (logger == NULL || logger->log_level < LOG_LEVEL_EVENT)
     {
         return 0;
     }
@@ -64,7 +115,7 @@ int logger_LogEvent(const Logger *logger, const char *format, ...)
 
 int logger_LogInfo(const Logger *logger, const char *format, ...)
 {
-    if (logger->log_level < LOG_LEVEL_INFO)
+    if (logger == NULL || logger->log_level < LOG_LEVEL_INFO)
     {
         return 0;
     }
@@ -79,7 +130,7 @@ int logger_LogInfo(const Logger *logger, const char *format, ...)
 
 int logger_LogDebug(const Logger *logger, const char *format, ...)
 {
-    if (logger->log_level < LOG_LEVEL_DEBUG)
+    if (logger == NULL || logger->log_level < LOG_LEVEL_DEBUG)
     {
         return 0;
     }
@@ -94,7 +145,7 @@ int logger_LogDebug(const Logger *logger, const char *format, ...)
 
 int logger_LogTrace(const Logger *logger, const char *format, ...)
 {
-    if (logger->log_level < LOG_LEVEL_TRACE)
+    if (logger == NULL || logger->log_level < LOG_LEVEL_TRACE)
     {
         return 0;
     }
@@ -109,6 +160,14 @@ int logger_LogTrace(const Logger *logger, const char *format, ...)
 
 void logger_Destroy(Logger *logger)
 {
+    if (logger == NULL)
+    {
+        return;
+    }
+
+    // Pending records still point at this logger.
+    logger_FlushAsync();
+
     if(fclose(logger->file_pointer))
     {
         printf("Internal log error: Can't close file '%s'.\n", logger->filename);
@@ -118,18 +177,297 @@ void logger_Destroy(Logger *logger)
     free(logger);
 }
 
+bool logger_StartAsync(size_t capacity, LoggerOverflowPolicy policy)
+{
+    if (atomic_load(&_async.enabled))
+    {
+        return true;
+    }
+
+    if (capacity == 0)
+    {
+        capacity = LOGGER_ASYNC_DEFAULT_CAPACITY;
+    }
+    size_t rounded_capacity = 1;
+    while (rounded_capacity < capacity)
+    {
+        rounded_capacity <<= 1;
+    }
+
+    _async.records = calloc(rounded_capacity, sizeof(AsyncRecord));
+    if (_async.records == NULL)
+    {
+        return false;
+    }
+    for (size_t i = 0; i < rounded_capacity; i++)
+    {
+        atomic_init(&_async.records[i].sequence, i);
+    }
+    _async.mask = rounded_capacity - 1;
+    _async.policy = policy;
+    _async.dequeue_position = 0;
+    atomic_store(&_async.enqueue_position, 0);
+    atomic_store(&_async.written_position, 0);
+    atomic_store(&_async.records_written, 0);
+    atomic_store(&_async.records_dropped, 0);
+    atomic_store(&_async.batches_written, 0);
+    atomic_store(&_async.running, true);
+
+    if (pthread_create(&_async.thread_id, NULL, RunAsyncWriter, NULL) != 0)
+    {
+        atomic_store(&_async.running, false);
+        free(_async.records);
+        _async.records = NULL;
+        return false;
+    }
+
+    atomic_store(&_async.enabled, true);
+    return true;
+}
+
+void logger_StopAsync()
+{
+    if (!atomic_load(&_async.enabled))
+    {
+        return;
+    }
+
+    // New records go straight to file. Producers that saw 'enabled' before it was cleared may
+    // still claim a slot, so wait them out while the writer keeps draining.
+    atomic_store(&_async.enabled, false);
+    while (atomic_load(&_async.producers) != 0)
+    {
+        AsyncWakeWriter();
+        sched_yield();
+    }
+
+    // Nothing can be enqueued anymore. The writer drains what is queued before it exits.
+    atomic_store(&_async.running, false);
+    AsyncWakeWriter();
+    pthread_join(_async.thread_id, NULL);
+
+    free(_async.records);
+    _async.records = NULL;
+}
+
+void logger_FlushAsync()
+{
+    if (!atomic_load(&_async.enabled))
+    {
+        return;
+    }
+
+    size_t target = atomic_load(&_async.enqueue_position);
+    while (atomic_load_explicit(&_async.written_position, memory_order_acquire) < target)
+    {
+        AsyncWakeWriter();
+        sched_yield();
+    }
+}
+
+LoggerAsyncStats logger_GetAsyncStats()
+{
+    LoggerAsyncStats stats = {
+        .records_written = atomic_load_explicit(&_async.records_written, memory_order_relaxed),
+        .records_dropped = atomic_load_explicit(&_async.records_dropped, memory_order_relaxed),
+        .batches_written = atomic_load_explicit(&_async.batches_written, memory_order_relaxed),
+    };
+    return stats;
+}
+
+static void WriteHeader(FILE *file_pointer, time_t timestamp, const char *log_level)
+{
+    struct tm timer_fmt;
+    gmtime_r(&timestamp, &timer_fmt);
+
+    fprintf(file_pointer, "[UTC: %02d-%02d-%04d %02d-%02d-%02d] - %s: ", timer_fmt.tm_mday, (timer_fmt.tm_mon + 1), (timer_fmt.tm_year + 1900),
+            timer_fmt.tm_hour, timer_fmt.tm_min, timer_fmt.tm_sec, log_level);
+}
+
+static int AsyncEnqueue(const Logger *logger, const char *log_level, const char *format, va_list args)
+{
+    AsyncRecord *record;
+    size_t position = atomic_load_explicit(&_async.enqueue_position, memory_order_relaxed);
+    for (;;)
+    {
+        record = &_async.records[position & _async.mask];
+        size_t sequence = atomic_load_explicit(&record->sequence, memory_order_acquire);
+        intptr_t difference = (intptr_t)sequence - (intptr_t)position;
+        if (difference == 0)
+        {
+            // Slot is free. Claim it.
+            if (atomic_compare_exchange_weak_explicit(&_async.enqueue_position, &position, position + 1,
+                                                      memory_order_relaxed, memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if (difference < 0)
+        {
+            // Buffer is full. The slot still holds a record from one lap ago.
+            if (_async.policy == LOGGER_OVERFLOW_DROP)
+            {
+                atomic_fetch_add_explicit(&_async.records_dropped, 1, memory_order_relaxed);
+                return -1;
+            }
+
+            AsyncWakeWriter();
+            sched_yield();
+            position = atomic_load_explicit(&_async.enqueue_position, memory_order_relaxed);
+        }
+        else
+        {
+            // Another producer claimed this slot first.
+            position = atomic_load_explicit(&_async.enqueue_position, memory_order_relaxed);
+        }
+    }
+
+    record->logger = logger;
+    record->log_level = log_level;
+    time(&record->timestamp);
+    vsnprintf(record->message, sizeof(record->message), format, args);
+    atomic_store_explicit(&record->sequence, position + 1, memory_order_release);
+
+    // Pairs with the fence in RunAsyncWriter so either we see it sleeping or it sees our record.
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&_async.writer_sleeping, memory_order_relaxed))
+    {
+        AsyncWakeWriter();
+    }
+
+    return 0;
+}
+
+static size_t AsyncWriteBatch()
+{
+    // Files written in this batch. Each is flushed once at the end instead of once per record.
+    FILE *touched[16];
+    size_t touched_count = 0;
+
+    size_t count = 0;
+    for (; count < ASYNC_BATCH_SIZE; count++)
+    {
+        size_t position = _async.dequeue_position;
+        AsyncRecord *record = &_async.records[position & _async.mask];
+        if (atomic_load_explicit(&record->sequence, memory_order_acquire) != position + 1)
+        {
+            break;
+        }
+
+        FILE *file_pointer = record->logger->file_pointer;
+        WriteHeader(file_pointer, record->timestamp, record->log_level);
+        fputs(record->message, file_pointer);
+        fputc('\n', file_pointer);
+
+        size_t i = 0;
+        while (i < touched_count && touched[i] != file_pointer)
+        {
+            i++;
+        }
+        if (i == touched_count)
+        {
+            if (touched_count == sizeof(touched) / sizeof(touched[0]))
+            {
+                fflush(touched[--touched_count]);
+            }
+            touched[touched_count++] = file_pointer;
+        }
+
+        // Hand the slot back to producers for the next lap.
+        atomic_store_explicit(&record->sequence, position + _async.mask + 1, memory_order_release);
+        _async.dequeue_position = position + 1;
+    }
+
+    if (count == 0)
+    {
+        return 0;
+    }
+
+    for (size_t i = 0; i < touched_count; i++)
+    {
+        fflush(touched[i]);
+    }
+
+    atomic_store_explicit(&_async.written_position, _async.dequeue_position, memory_order_release);
+    atomic_fetch_add_explicit(&_async.records_written, count, memory_order_relaxed);
+    atomic_fetch_add_explicit(&_async.batches_written, 1, memory_order_relaxed);
+    return count;
+}
+
+static void AsyncWakeWriter()
+{
+    pthread_mutex_lock(&_async.wake_mutex);
+    pthread_cond_signal(&_async.wake_cond);
+    pthread_mutex_unlock(&_async.wake_mutex);
+}
+
+static void *RunAsyncWriter(void *vargp)
+{
+    (void)vargp;
+
+    for (;;)
+    {
+        if (AsyncWriteBatch() > 0)
+        {
+            continue;
+        }
+
+        if (!atomic_load(&_async.running))
+        {
+            // Wait out producers that claimed a slot but haven't committed it yet.
+            if (_async.dequeue_position == atomic_load(&_async.enqueue_position))
+            {
+                break;
+            }
+            sched_yield();
+            continue;
+        }
+
+        pthread_mutex_lock(&_async.wake_mutex);
+        atomic_store(&_async.writer_sleeping, true);
+        atomic_thread_fence(memory_order_seq_cst);
+
+        // Re-check after announcing we sleep, so a record committed in between isn't left waiting.
+        AsyncRecord *next = &_async.records[_async.dequeue_position & _async.mask];
+        bool pending = atomic_load_explicit(&next->sequence, memory_order_acquire) == _async.dequeue_position + 1;
+        if (!pending && atomic_load(&_async.running))
+        {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_nsec += ASYNC_IDLE_WAIT_NS;
+            if (deadline.tv_nsec >= 1000000000)
+            {
+                deadline.tv_sec += 1;
+                deadline.tv_nsec -= 1000000000;
+            }
+            pthread_cond_timedwait(&_async.wake_cond, &_async.wake_mutex, &deadline);
+        }
+
+        atomic_store(&_async.writer_sleeping, false);
+        pthread_mutex_unlock(&_async.wake_mutex);
+    }
+
+    return NULL;
+}
+
 static int LogWrite(const Logger *logger, const char *log_level, const char *format, va_list args)
 {
+    // Announce ourselves before checking 'enabled'. Both are sequentially consistent, so
+    // logger_StopAsync either sees us here or we see it disabled.
+    atomic_fetch_add(&_async.producers, 1);
+    if (atomic_load(&_async.enabled))
+    {
+        int rc = AsyncEnqueue(logger, log_level, format, args);
+        atomic_fetch_sub(&_async.producers, 1);
+        return rc;
+    }
+    atomic_fetch_sub(&_async.producers, 1);
+
     pthread_mutex_lock(&_mutex);
-    int rc = 0;
 
-    struct tm *timer_fmt;
     time_t timer;
     time(&timer);
-    timer_fmt = gmtime(&timer);
-
-    fprintf(logger->file_pointer, "[UTC: %02d-%02d-%04d %02d-%02d-%02d] - %s: ", timer_fmt->tm_mday, (timer_fmt->tm_mon + 1), (timer_fmt->tm_year + 1900),
-                timer_fmt->tm_hour, timer_fmt->tm_min, timer_fmt->tm_sec, log_level);
+    WriteHeader(logger->file_pointer, timer, log_level);
     vfprintf(logger->file_pointer, format, args);
     fprintf(logger->file_pointer, "\n");
 
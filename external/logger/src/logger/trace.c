@@ -0,0 +1,59 @@
+#include <stdlib.h>
+
+#include "logger/trace.h"
+
+TraceWriter *logger_CreateTraceWriter(const char *filename, size_t buffer_size)
+{
+    FILE *file_pointer = fopen(filename, "wb");
+    if (file_pointer == NULL)
+    {
+        printf("Internal log error: Can't open trace file '%s'.\n", filename);
+        return NULL;
+    }
+
+    TraceWriter *writer = calloc(1, sizeof(TraceWriter));
+    writer->file_pointer = file_pointer;
+    writer->buffer_size = buffer_size > 0 ? buffer_size : TRACE_DEFAULT_BUFFER_SIZE;
+    writer->buffer = malloc(writer->buffer_size);
+    writer->enabled = true;
+
+    return writer;
+}
+
+void logger_FlushTraceWriter(TraceWriter *writer)
+{
+    if (writer->buffer_used == 0)
+    {
+        return;
+    }
+
+    if (fwrite(writer->buffer, 1, writer->buffer_used, writer->file_pointer) != writer->buffer_used)
+    {
+        printf("Internal log error: Failed to write trace. Disabling trace.\n");
+        writer->enabled = false;
+    }
+    else
+    {
+        writer->bytes_written += writer->buffer_used;
+    }
+
+    writer->buffer_used = 0;
+}
+
+void logger_DestroyTraceWriter(TraceWriter *writer)
+{
+    if (writer == NULL)
+    {
+        return;
+    }
+
+    logger_FlushTraceWriter(writer);
+    fclose(writer->file_pointer);
+    free(writer->buffer);
+    free(writer);
+}
+
+void logger_SetTraceEnabled(TraceWriter *writer, bool enabled)
+{
+    writer->enabled = enabled;
+}
@@ -3,6 +3,7 @@
 
 #include <logger/logger.h>
 #include <core/display.h>
+#include <core/keys.h>
 
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
@@ -19,6 +20,13 @@
 #define WINDOW_WIDTH (800)
 #define WINDOW_HEIGHT (600)
 #define MAX_FRAMES_IN_FLIGHT (2)
+// Pixel format of headless render targets and of the frames gio_ReadbackFrame returns.
+#define HEADLESS_IMAGE_FORMAT (VK_FORMAT_R8G8B8A8_UNORM)
+#define HEADLESS_IMAGE_CHANNELS (4)
+// Number of recent frames and input events that frame metrics are computed over.
+#define FRAME_METRICS_HISTORY (256)
+// Longest gio_Draw waits for the previous frame to reach the screen when present wait is used.
+#define PRESENT_WAIT_TIMEOUT_NS (100000000)
 
 // Calls VK-function and checks VkResult. Raises SIGABRT if error.
 #define CALL_VK(func, logger_ptr, fmt, ...)        \
@@ -37,6 +45,37 @@
         raise(SIGABRT);                                    \
     } while (false)
 
+typedef enum GraphioPresentMode
+{
+    // Queues frames and presents one per vblank. Always supported. Never tears.
+    GRAPHIO_PRESENT_MODE_FIFO = 0,
+    // Replaces the queued frame and presents it at vblank. Falls back to FIFO where unsupported.
+    GRAPHIO_PRESENT_MODE_MAILBOX = 1,
+    // Presents at once and may tear. Lowest latency. Falls back to FIFO where unsupported.
+    GRAPHIO_PRESENT_MODE_IMMEDIATE = 2,
+} GraphioPresentMode;
+
+// Frame pacing statistics over the last FRAME_METRICS_HISTORY samples. Times are in seconds.
+typedef struct FrameMetrics
+{
+    // Frames drawn since the context was created.
+    uint64_t frames;
+    // Time between the starts of consecutive gio_Draw calls.
+    double frame_time_p50;
+    double frame_time_p95;
+    double frame_time_p99;
+    double frame_time_max;
+    // Time from a key event to the first frame drawn after it reaching the screen.
+    // Measured to present completion when 'present_wait' is set, else to vkQueuePresentKHR returning.
+    uint64_t input_latency_samples;
+    double input_latency_p50;
+    double input_latency_p95;
+    double input_latency_p99;
+    double input_latency_max;
+    // VK_KHR_present_wait is in use, both for pacing and for latency measurement.
+    bool present_wait;
+} FrameMetrics;
+
 typedef struct SwapChainSupportDetails
 {
     VkSurfaceCapabilitiesKHR capabilities;
@@ -46,11 +85,43 @@ typedef struct SwapChainSupportDetails
     VkPresentModeKHR *present_modes;
 } SwapChainSupportDetails;
 
+// Display texture owned by one frame in flight. Only written once that frame's fence has
+// signalled, so uploads never wait on the GPU and never race a frame still sampling it.
+typedef struct FrameTexture
+{
+    VkImage image;
+    VkDeviceMemory imageMemory;
+    VkImageView imageView;
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingBufferMemory;
+    void *pStagingBufferMemory;
+    // Display frame the image currently holds. Used to skip or narrow uploads.
+    DisplayFrame frame;
+} FrameTexture;
+
+// Offscreen render target of a headless context, one per frame in flight. Stands in for a
+// swapchain image. Each rendered frame is copied to a persistently mapped readback buffer in
+// the same submission, so reading it back only needs the frame's fence.
+typedef struct OffscreenTarget
+{
+    VkImage image;
+    VkDeviceMemory imageMemory;
+    VkImageView imageView;
+    VkFramebuffer framebuffer;
+    VkBuffer readbackBuffer;
+    VkDeviceMemory readbackBufferMemory;
+    void *pReadbackBufferMemory;
+    // Number of the frame last submitted to this target. 0 if none was.
+    uint64_t frameNumber;
+} OffscreenTarget;
+
 typedef struct GraphioContext
 {
     // Reference to logger in application.
     // We do not need to free this logger as we do not own it.
     Logger *logger;
+    // Renders to offscreen targets. There is no window, surface or swapchain.
+    bool headless;
     GLFWwindow *window;
     VkInstance instance;
     bool enable_validation_layers;
@@ -64,7 +135,7 @@ typedef struct GraphioContext
     VkSurfaceKHR surface;
 
     Display *display;
-    uint16_t *keys;
+    InputChannel *input;
 
     VkSwapchainKHR swapChain;
     VkImage *swapChainImages;
@@ -76,6 +147,31 @@ typedef struct GraphioContext
     VkFramebuffer *swapChainFramebuffers;
     uint32_t swapChainFramebuffers_count;
 
+    // Headless only.
+    OffscreenTarget offscreenTargets[MAX_FRAMES_IN_FLIGHT];
+    uint64_t framesSubmitted;
+
+    // Frame pacing
+    GraphioPresentMode presentMode;
+    // VK_KHR_present_id and VK_KHR_present_wait are enabled on the device.
+    bool presentWaitSupported;
+    PFN_vkWaitForPresentKHR pfnWaitForPresentKHR;
+    // Id of the last present on the current swapchain. 0 if none.
+    uint64_t presentId;
+
+    // Frame metrics. Sample rings are indexed by sample count modulo FRAME_METRICS_HISTORY.
+    uint64_t framesDrawn;
+    double lastDrawTime;
+    uint64_t frameTimeSamples;
+    double frameTimes[FRAME_METRICS_HISTORY];
+    // Time of the first key event not yet drawn. 0 if none.
+    double pendingInputTime;
+    // Present carrying the input sampled at 'latencyInputTime', not yet complete. 0 if none.
+    uint64_t latencyPresentId;
+    double latencyInputTime;
+    uint64_t inputLatencySamples;
+    double inputLatencies[FRAME_METRICS_HISTORY];
+
     VkRenderPass renderPass;
     VkPipelineLayout pipelineLayout;
     VkPipeline graphicsPipeline;
@@ -83,13 +179,9 @@ typedef struct GraphioContext
     VkCommandPool commandPool;
     VkCommandBuffer *commandBuffers;
 
-    VkImage textureImage;
-    VkImageView textureImageView;
-    VkDeviceMemory textureImageMemory;
+    // One texture per frame in flight, indexed by 'currentFrame'.
+    FrameTexture textures[MAX_FRAMES_IN_FLIGHT];
     VkSampler textureSampler;
-    VkBuffer textureStagingBuffer;
-    VkDeviceMemory textureStagingBufferMemory;
-    void *pTextureStagingBufferMemory;
 
     VkDescriptorSetLayout descriptorSetLayout;
     VkDescriptorPool descriptorPool;
@@ -103,7 +195,25 @@ typedef struct GraphioContext
     bool frameBufferResized;
 } GraphioContext;
 
-GraphioContext *gio_CreateGraphioContext(Logger *logger, Display *display, uint16_t *keys);
+/// @brief Creates a windowed context presenting 'display'.
+/// @param logger logger to report to. Not owned.
+/// @param display display to render.
+/// @param input channel keyboard input is delivered to, such as CPUState.input.
+/// @param present_mode requested present mode. FIFO is used if the surface doesn't support it.
+/// @return handle to the created context.
+GraphioContext *gio_CreateGraphioContext(Logger *logger, Display *display, InputChannel *input, GraphioPresentMode present_mode);
+
+/// @brief Creates a context that renders offscreen, without GLFW, a window or a surface.
+/// @details Runs the same texture upload, pipeline and shaders as the windowed context, so it
+/// can be tested and benchmarked on machines without a display, for example with lavapipe.
+/// gio_Draw submits a frame without presenting it. Frames are read back with gio_ReadbackFrame.
+/// Validation layers are skipped rather than required if they are not installed.
+/// @param logger logger to report to. Not owned.
+/// @param display display to render.
+/// @param width width of the render target in pixels.
+/// @param height height of the render target in pixels.
+/// @return handle to the created context.
+GraphioContext *gio_CreateHeadlessGraphioContext(Logger *logger, Display *display, uint32_t width, uint32_t height);
 
 void gio_DestroyGraphioContext(GraphioContext *ctx);
 
@@ -111,17 +221,36 @@ void gio_Draw(GraphioContext *ctx);
 
 void gio_UpdateFPS(GraphioContext *ctx, double fps);
 
+/// @brief Switches the present mode, recreating the swapchain. No-op for headless contexts.
+/// @details FIFO is used if the surface doesn't support 'present_mode'.
+void gio_SetPresentMode(GraphioContext *ctx, GraphioPresentMode present_mode);
+
+/// @brief Computes frame time and input latency percentiles over recent frames.
+/// @details Cheap enough to call once a second, not every frame: it sorts up to
+/// FRAME_METRICS_HISTORY samples. Percentiles are 0 until there are samples.
+void gio_GetFrameMetrics(const GraphioContext *ctx, FrameMetrics *metrics);
+
 double gio_GetCurrentTime();
 
 void gio_StopGraphioContext(GraphioContext *ctx);
 
+/// @brief Returns the newest frame a headless context has finished rendering.
+/// @details Never waits unless 'wait' is set, so polling it after each gio_Draw doesn't stall
+/// the submitting thread. Frames are read straight from mapped memory without a copy.
+/// @param ctx headless context.
+/// @param wait wait for the last submitted frame instead of returning the newest finished one.
+/// @param frame_number set to the number of the returned frame, counting gio_Draw calls from 1. May be NULL.
+/// @return 'swapChainExtent' sized HEADLESS_IMAGE_FORMAT pixels, rows tightly packed.
+/// Valid until the next gio_Draw. NULL if no frame has finished yet.
+const uint8_t *gio_ReadbackFrame(GraphioContext *ctx, bool wait, uint64_t *frame_number);
+
 /// @brief Stores the given pixel buffer in file 'filename' as PNG.
 /// @param filename file to store png in.
 /// @param pixel_buffer buffer to write to file.
 /// @param width width of buffer.
 /// @param height height of buffer.
 /// @param channels number of channels per pixel.
-void gio_SavePixelBufferPNG(const char *filename, uint8_t *pixel_buffer, uint8_t width, uint8_t height, uint8_t channels);
+void gio_SavePixelBufferPNG(const char *filename, const uint8_t *pixel_buffer, uint32_t width, uint32_t height, uint8_t channels);
 
 
 #endif
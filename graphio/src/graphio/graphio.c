@@ -6,6 +6,7 @@
 #include "stb/stb_image_write.h"
 
 #include <maths/maths.h>
+#include <timing/timing.h>
 #include <core/keys.h>
 
 #include "graphio/graphio.h"
@@ -18,12 +19,17 @@
 
 static const uint32_t device_extensions_count = 1;
 static const char *device_extensions[1] = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+// Enabled on top of 'device_extensions' when the device supports both.
+static const uint32_t present_wait_extensions_count = 2;
+static const char *present_wait_extensions[2] = {VK_KHR_PRESENT_ID_EXTENSION_NAME, VK_KHR_PRESENT_WAIT_EXTENSION_NAME};
 
 static const uint32_t validation_layers_count = 1;
 static const char *validation_layers[1] = {"VK_LAYER_KHRONOS_validation"};
 
+static GraphioContext *CreateContext(Logger *logger, Display *display, InputChannel *input);
 static void InitGLFW(GraphioContext *ctx);
 static void InitVulkan(GraphioContext *ctx);
+static void InitVulkanHeadless(GraphioContext *ctx);
 
 static void CreateInstance(GraphioContext *ctx);
 static void SetupDebugMessenger(GraphioContext *ctx);
@@ -45,6 +51,13 @@ static void CreateDescriptorSets(GraphioContext *ctx);
 static void CreateCommandBuffers(GraphioContext *ctx);
 static void CreateSyncObjects(GraphioContext *ctx);
 
+// Headless
+static void CreateOffscreenTargets(GraphioContext *ctx);
+static void CreateOffscreenFramebuffers(GraphioContext *ctx);
+static void DestroyOffscreenTargets(GraphioContext *ctx);
+static void DrawOffscreen(GraphioContext *ctx);
+static void RecordReadback(GraphioContext *ctx, VkCommandBuffer commandBuffer, OffscreenTarget *target);
+
 // Debug/Extensions
 
 static bool CheckValidationLayerSupport(GraphioContext *ctx);
@@ -59,18 +72,28 @@ static void CleanUpSwapchain(GraphioContext *ctx);
 static void RecreateSwapChain(GraphioContext *ctx);
 static SwapChainSupportDetails QuerySwapChainSupport(GraphioContext *ctx);
 static VkSurfaceFormatKHR ChooseSwapSurfaceFormat(SwapChainSupportDetails *support);
-static VkPresentModeKHR ChooseSwapPresentMode(SwapChainSupportDetails *support);
+static VkPresentModeKHR ChooseSwapPresentMode(GraphioContext *ctx, SwapChainSupportDetails *support);
 static VkExtent2D ChooseSwapExtent(GraphioContext *ctx, SwapChainSupportDetails *support);
 static void DestroySwapChainSupportDetails(SwapChainSupportDetails details);
 
+// Frame pacing
+static bool CheckPresentWaitSupport(GraphioContext *ctx);
+static void RecordFrameTime(GraphioContext *ctx);
+static void RecordInputLatency(GraphioContext *ctx, double latency);
+static void PollInputLatency(GraphioContext *ctx);
+static void SummarizeSamples(const double *samples, uint64_t samples_count, double *p50, double *p95, double *p99, double *max);
+static int CompareDoubles(const void *a, const void *b);
+
 // Image/Imageview
 
 static VkImageView CreateImageView(GraphioContext *ctx, VkImage image, VkFormat format, VkImageAspectFlags aspectFlags);
 static void CreateImage(GraphioContext *ctx, uint32_t width, uint32_t height, VkFormat format,
                         VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties,
                         VkImage *image, VkDeviceMemory *imageMemory);
-static void CopyBufferToImage(GraphioContext *ctx, VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
-static void TransitionImageLayout(GraphioContext *ctx, VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout);
+static void CopyBufferToImage(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize buffer_offset, VkImage image,
+                              uint32_t y, uint32_t width, uint32_t height);
+static void TransitionImageLayout(GraphioContext *ctx, VkCommandBuffer commandBuffer, VkImage image, VkFormat format,
+                                  VkImageLayout oldLayout, VkImageLayout newLayout);
 
 // Memory/Buffers
 
@@ -89,7 +112,7 @@ static VkCommandBuffer BeginSingleTimeCommands(GraphioContext *ctx);
 static void EndSingleTimeCommands(GraphioContext *ctx, VkCommandBuffer commandBuffer);
 
 // Textures
-static void UpdateTexture(GraphioContext *ctx);
+static void UpdateTexture(GraphioContext *ctx, VkCommandBuffer commandBuffer);
 
 // Keys
 
@@ -105,32 +128,26 @@ static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(VkDebugUtilsMessageSeverityF
 
 // Public
 
-GraphioContext *gio_CreateGraphioContext(Logger *logger, Display *display, uint16_t *keys)
+GraphioContext *gio_CreateGraphioContext(Logger *logger, Display *display, InputChannel *input, GraphioPresentMode present_mode)
 {
-    GraphioContext *ctx = calloc(1, sizeof(GraphioContext));
-    ctx->logger = logger;
+    GraphioContext *ctx = CreateContext(logger, display, input);
+    ctx->presentMode = present_mode;
 
-#ifdef NDEBUG
-    ctx->enable_validation_layers = false;
-#else
-    ctx->enable_validation_layers = true;
-#endif
+    InitGLFW(ctx);
+    InitVulkan(ctx);
 
-    ctx->commandBuffers = realloc(ctx->commandBuffers, sizeof(VkCommandBuffer) * MAX_FRAMES_IN_FLIGHT);
-    ctx->physicalDevice = VK_NULL_HANDLE;
-    ctx->imageAvailableSemaphores = realloc(ctx->imageAvailableSemaphores, sizeof(VkSemaphore) * MAX_FRAMES_IN_FLIGHT);
-    ctx->renderFinishedSemaphores = realloc(ctx->renderFinishedSemaphores, sizeof(VkSemaphore) * MAX_FRAMES_IN_FLIGHT);
-    ctx->inFlightFences = realloc(ctx->inFlightFences, sizeof(VkFence) * MAX_FRAMES_IN_FLIGHT);
-    ctx->currentFrame = 0;
-    ctx->graphicsQueueFamilyIdx = UINT32_MAX;
-    ctx->presentQueueFamilyIdx = UINT32_MAX;
-    ctx->descriptorSets = realloc(ctx->descriptorSets, sizeof(VkDescriptorSet) * MAX_FRAMES_IN_FLIGHT);
+    return ctx;
+}
 
-    ctx->display = display;
-    ctx->keys = keys;
+GraphioContext *gio_CreateHeadlessGraphioContext(Logger *logger, Display *display, uint32_t width, uint32_t height)
+{
+    GraphioContext *ctx = CreateContext(logger, display, NULL);
+    ctx->headless = true;
+    // Nothing to present to, so the extent and format are ours to pick.
+    ctx->swapChainExtent = (VkExtent2D){width, height};
+    ctx->swapChainImageFormat = HEADLESS_IMAGE_FORMAT;
 
-    InitGLFW(ctx);
-    InitVulkan(ctx);
+    InitVulkanHeadless(ctx);
 
     return ctx;
 }
@@ -146,19 +163,30 @@ void gio_DestroyGraphioContext(GraphioContext *ctx)
 
     vkDestroyCommandPool(ctx->device, ctx->commandPool, NULL);
 
-    CleanUpSwapchain(ctx);
+    if (ctx->headless)
+    {
+        DestroyOffscreenTargets(ctx);
+    }
+    else
+    {
+        CleanUpSwapchain(ctx);
+    }
 
     vkDestroyDescriptorPool(ctx->device, ctx->descriptorPool, NULL);
     vkDestroyDescriptorSetLayout(ctx->device, ctx->descriptorSetLayout, NULL);
 
     vkDestroySampler(ctx->device, ctx->textureSampler, NULL);
-    vkDestroyImageView(ctx->device, ctx->textureImageView, NULL);
-    vkDestroyImage(ctx->device, ctx->textureImage, NULL);
-    vkFreeMemory(ctx->device, ctx->textureImageMemory, NULL);
-    // Destroy texture staging buffer.
-    vkUnmapMemory(ctx->device, ctx->textureStagingBufferMemory);
-    vkDestroyBuffer(ctx->device, ctx->textureStagingBuffer, NULL);
-    vkFreeMemory(ctx->device, ctx->textureStagingBufferMemory, NULL);
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        FrameTexture *texture = &ctx->textures[i];
+        vkDestroyImageView(ctx->device, texture->imageView, NULL);
+        vkDestroyImage(ctx->device, texture->image, NULL);
+        vkFreeMemory(ctx->device, texture->imageMemory, NULL);
+        // Destroy texture staging buffer.
+        vkUnmapMemory(ctx->device, texture->stagingBufferMemory);
+        vkDestroyBuffer(ctx->device, texture->stagingBuffer, NULL);
+        vkFreeMemory(ctx->device, texture->stagingBufferMemory, NULL);
+    }
 
     vkDestroyPipeline(ctx->device, ctx->graphicsPipeline, NULL);
     vkDestroyPipelineLayout(ctx->device, ctx->pipelineLayout, NULL);
@@ -171,17 +199,40 @@ void gio_DestroyGraphioContext(GraphioContext *ctx)
         DestroyDebugUtilsMessengerEXT(ctx->instance, ctx->debugMessenger, NULL);
     }
 
-    vkDestroySurfaceKHR(ctx->instance, ctx->surface, NULL);
+    if (!ctx->headless)
+    {
+        vkDestroySurfaceKHR(ctx->instance, ctx->surface, NULL);
+    }
     vkDestroyInstance(ctx->instance, NULL);
-    glfwDestroyWindow(ctx->window);
 
-    glfwTerminate();
+    if (!ctx->headless)
+    {
+        glfwDestroyWindow(ctx->window);
+        glfwTerminate();
+    }
 
     free(ctx);
 }
 
 void gio_Draw(GraphioContext *ctx)
 {
+    if (ctx->headless)
+    {
+        DrawOffscreen(ctx);
+        return;
+    }
+
+    RecordFrameTime(ctx);
+
+    // With present wait, hold off until the previous frame is on screen. At most one frame is
+    // then queued ahead of the display, and the frame we're about to draw shows input as late as
+    // possible. Without it, FIFO may queue up to the swapchain length.
+    if (ctx->presentWaitSupported && ctx->presentId > 0)
+    {
+        ctx->pfnWaitForPresentKHR(ctx->device, ctx->swapChain, ctx->presentId, PRESENT_WAIT_TIMEOUT_NS);
+    }
+    PollInputLatency(ctx);
+
     vkWaitForFences(ctx->device, 1, &ctx->inFlightFences[ctx->currentFrame], VK_TRUE, UINT64_MAX);
 
     uint32_t imageIndex;
@@ -200,9 +251,6 @@ void gio_Draw(GraphioContext *ctx)
 
     vkResetFences(ctx->device, 1, &ctx->inFlightFences[ctx->currentFrame]);
 
-    // DYNTEX: UpdateTexture
-    UpdateTexture(ctx);
-
     vkResetCommandBuffer(ctx->commandBuffers[ctx->currentFrame], /*VkCommandBufferResetFlagBits*/ 0);
     RecordCommandBuffer(ctx, imageIndex);
 
@@ -239,8 +287,41 @@ void gio_Draw(GraphioContext *ctx)
 
     presentInfo.pImageIndices = &imageIndex;
 
+    // Number the present, so we can wait for it and time when it reaches the screen.
+    uint64_t present_id = ctx->presentId + 1;
+    VkPresentIdKHR presentIdInfo = {
+        .sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR,
+        .swapchainCount = 1,
+        .pPresentIds = &present_id,
+    };
+    if (ctx->presentWaitSupported)
+    {
+        presentInfo.pNext = &presentIdInfo;
+    }
+
     result = vkQueuePresentKHR(ctx->presentQueue, &presentInfo);
 
+    if (ctx->presentWaitSupported)
+    {
+        ctx->presentId = present_id;
+    }
+
+    // This frame is the first to be drawn after the pending input. Inputs arriving while an
+    // earlier sample is still in flight are not sampled.
+    if (ctx->pendingInputTime > 0)
+    {
+        if (!ctx->presentWaitSupported)
+        {
+            RecordInputLatency(ctx, GetMonotonicTime() - ctx->pendingInputTime);
+        }
+        else if (ctx->latencyPresentId == 0)
+        {
+            ctx->latencyPresentId = present_id;
+            ctx->latencyInputTime = ctx->pendingInputTime;
+        }
+        ctx->pendingInputTime = 0;
+    }
+
     if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || ctx->frameBufferResized)
     {
         ctx->frameBufferResized = false;
@@ -256,6 +337,12 @@ void gio_Draw(GraphioContext *ctx)
 
 void gio_UpdateFPS(GraphioContext *ctx, double fps)
 {
+    // Headless contexts have no window title to write to.
+    if (ctx->headless)
+    {
+        return;
+    }
+
     char title[256];
     title[255] = '\0';
 
@@ -273,13 +360,109 @@ void gio_StopGraphioContext(GraphioContext *ctx)
     CALL_VK(vkDeviceWaitIdle(ctx->device), ctx->logger, "Failed while waiting for device to go idle.");
 }
 
-void gio_SavePixelBufferPNG(const char *filename, uint8_t *pixel_buffer, uint8_t width, uint8_t height, uint8_t channels)
+const uint8_t *gio_ReadbackFrame(GraphioContext *ctx, bool wait, uint64_t *frame_number)
+{
+    if (!ctx->headless)
+    {
+        return NULL;
+    }
+
+    OffscreenTarget *newest = NULL;
+    uint32_t newest_idx = 0;
+    for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        OffscreenTarget *target = &ctx->offscreenTargets[i];
+        if (target->frameNumber == 0 || (newest != NULL && target->frameNumber < newest->frameNumber))
+        {
+            continue;
+        }
+
+        // A target's fence is only reset when the target is reused, so a signalled fence
+        // means its readback buffer holds 'frameNumber'.
+        if (wait || vkGetFenceStatus(ctx->device, ctx->inFlightFences[i]) == VK_SUCCESS)
+        {
+            newest = target;
+            newest_idx = i;
+        }
+    }
+
+    if (newest == NULL)
+    {
+        return NULL;
+    }
+
+    if (wait)
+    {
+        CALL_VK(vkWaitForFences(ctx->device, 1, &ctx->inFlightFences[newest_idx], VK_TRUE, UINT64_MAX),
+                ctx->logger, "Failed to wait for frame %lu.", (unsigned long)newest->frameNumber);
+    }
+
+    if (frame_number != NULL)
+    {
+        *frame_number = newest->frameNumber;
+    }
+    return newest->pReadbackBufferMemory;
+}
+
+void gio_SetPresentMode(GraphioContext *ctx, GraphioPresentMode present_mode)
+{
+    if (ctx->headless || ctx->presentMode == present_mode)
+    {
+        return;
+    }
+
+    ctx->presentMode = present_mode;
+    RecreateSwapChain(ctx);
+}
+
+void gio_GetFrameMetrics(const GraphioContext *ctx, FrameMetrics *metrics)
+{
+    metrics->frames = ctx->framesDrawn;
+    SummarizeSamples(ctx->frameTimes, ctx->frameTimeSamples,
+                     &metrics->frame_time_p50, &metrics->frame_time_p95,
+                     &metrics->frame_time_p99, &metrics->frame_time_max);
+    metrics->input_latency_samples = ctx->inputLatencySamples;
+    SummarizeSamples(ctx->inputLatencies, ctx->inputLatencySamples,
+                     &metrics->input_latency_p50, &metrics->input_latency_p95,
+                     &metrics->input_latency_p99, &metrics->input_latency_max);
+    metrics->present_wait = ctx->presentWaitSupported;
+}
+
+void gio_SavePixelBufferPNG(const char *filename, const uint8_t *pixel_buffer, uint32_t width, uint32_t height, uint8_t channels)
 {
     stbi_write_png(filename, width, height, channels, pixel_buffer, width * channels);
 }
 
 // Private
 
+// Allocates a context and sets up everything shared by windowed and headless contexts.
+GraphioContext *CreateContext(Logger *logger, Display *display, InputChannel *input)
+{
+    GraphioContext *ctx = calloc(1, sizeof(GraphioContext));
+    ctx->logger = logger;
+
+#ifdef NDEBUG
+    ctx->enable_validation_layers = false;
+#else
+    ctx->enable_validation_layers = true;
+#endif
+
+    ctx->commandBuffers = realloc(ctx->commandBuffers, sizeof(VkCommandBuffer) * MAX_FRAMES_IN_FLIGHT);
+    ctx->physicalDevice = VK_NULL_HANDLE;
+    ctx->imageAvailableSemaphores = realloc(ctx->imageAvailableSemaphores, sizeof(VkSemaphore) * MAX_FRAMES_IN_FLIGHT);
+    ctx->renderFinishedSemaphores = realloc(ctx->renderFinishedSemaphores, sizeof(VkSemaphore) * MAX_FRAMES_IN_FLIGHT);
+    ctx->inFlightFences = realloc(ctx->inFlightFences, sizeof(VkFence) * MAX_FRAMES_IN_FLIGHT);
+    ctx->currentFrame = 0;
+    ctx->graphicsQueueFamilyIdx = UINT32_MAX;
+    ctx->presentQueueFamilyIdx = UINT32_MAX;
+    ctx->descriptorSets = realloc(ctx->descriptorSets, sizeof(VkDescriptorSet) * MAX_FRAMES_IN_FLIGHT);
+
+    ctx->display = display;
+    ctx->input = input;
+
+    return ctx;
+}
+
 void InitGLFW(GraphioContext *ctx)
 {
     glfwInit();
@@ -295,6 +478,38 @@ void InitGLFW(GraphioContext *ctx)
     glfwSetKeyCallback(ctx->window, glfwKeyCallback);
 }
 
+// Same as InitVulkan, with offscreen targets in place of the surface and swapchain.
+void InitVulkanHeadless(GraphioContext *ctx)
+{
+    // CI machines rarely have the validation layers installed. Don't fail over it.
+    if (ctx->enable_validation_layers && !CheckValidationLayerSupport(ctx))
+    {
+        logger_LogInfo(ctx->logger, "Validation layers not available. Running headless without them.");
+        ctx->enable_validation_layers = false;
+    }
+
+    CreateInstance(ctx);
+    if (ctx->enable_validation_layers)
+    {
+        SetupDebugMessenger(ctx);
+    }
+    SelectPhysicalDevice(ctx);
+    CreateLogicalDevice(ctx);
+    CreateOffscreenTargets(ctx);
+    CreateRenderPass(ctx);
+    CreateDescriptorSetLayout(ctx);
+    CreateGraphicsPipeline(ctx);
+    CreateOffscreenFramebuffers(ctx);
+    CreateCommandPool(ctx);
+    CreateTextureImage(ctx);
+    CreateTextureImageView(ctx);
+    CreateTextureSampler(ctx);
+    CreateDescriptorPool(ctx);
+    CreateDescriptorSets(ctx);
+    CreateCommandBuffers(ctx);
+    CreateSyncObjects(ctx);
+}
+
 void InitVulkan(GraphioContext *ctx)
 {
     CreateInstance(ctx);
@@ -327,7 +542,8 @@ void CreateInstance(GraphioContext *ctx)
 
     VkApplicationInfo appInfo = {
         .sType = VK_STRUCTURE_TYPE_APPLICATION_INFO,
-        .apiVersion = VK_API_VERSION_1_0,
+        // 1.1 for vkGetPhysicalDeviceFeatures2, used to query present wait support.
+        .apiVersion = VK_API_VERSION_1_1,
     };
 
     uint32_t extensions_count;
@@ -412,6 +628,17 @@ void CreateLogicalDevice(GraphioContext *ctx)
             ctx->graphicsQueueFamilyIdx = i;
         }
 
+        // Without a surface there is nothing to present, so any graphics queue will do.
+        if (ctx->headless)
+        {
+            if (ctx->graphicsQueueFamilyIdx != UINT32_MAX)
+            {
+                ctx->presentQueueFamilyIdx = ctx->graphicsQueueFamilyIdx;
+                break;
+            }
+            continue;
+        }
+
         VkBool32 present_support = false;
         CALL_VK(vkGetPhysicalDeviceSurfaceSupportKHR(ctx->physicalDevice, i, ctx->surface, &present_support),
                 ctx->logger, "Failed to get physical device surface support.");
@@ -446,18 +673,48 @@ void CreateLogicalDevice(GraphioContext *ctx)
     VkPhysicalDeviceFeatures device_features = {};
     device_features.samplerAnisotropy = VK_TRUE;
 
+    // Present wait is optional. Enable it with its features when the device has it.
+    const char *extensions[3];
+    uint32_t extensions_count = 0;
+    if (!ctx->headless)
+    {
+        for (uint32_t i = 0; i < device_extensions_count; i++)
+            extensions[extensions_count++] = device_extensions[i];
+    }
+
+    ctx->presentWaitSupported = !ctx->headless && CheckPresentWaitSupport(ctx);
+    VkPhysicalDevicePresentWaitFeaturesKHR present_wait_features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR,
+        .presentWait = VK_TRUE,
+    };
+    VkPhysicalDevicePresentIdFeaturesKHR present_id_features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR,
+        .pNext = &present_wait_features,
+        .presentId = VK_TRUE,
+    };
+    if (ctx->presentWaitSupported)
+    {
+        for (uint32_t i = 0; i < present_wait_extensions_count; i++)
+            extensions[extensions_count++] = present_wait_extensions[i];
+    }
+
     // We now create the DeviceCreateInfo and prepare to create the logical device.
     VkDeviceCreateInfo device_create_info = {
         .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
         // Set the queue-family create info's so vulkan can create the queue's.
-        .queueCreateInfoCount = 2,
+        // Headless contexts only create the graphics queue.
+        .queueCreateInfoCount = ctx->headless ? 1 : 2,
         .pQueueCreateInfos = queue_create_infos,
         // Set device-features because it's required. Won't be used for now.
         .pEnabledFeatures = &device_features,
         // Set enabled extensions for device.
-        .enabledExtensionCount = device_extensions_count,
-        .ppEnabledExtensionNames = device_extensions,
+        .enabledExtensionCount = extensions_count,
+        .ppEnabledExtensionNames = extensions,
     };
+    if (ctx->presentWaitSupported)
+    {
+        device_create_info.pNext = &present_id_features;
+    }
     if (ctx->enable_validation_layers)
     {
         device_create_info.enabledLayerCount = validation_layers_count;
@@ -474,6 +731,13 @@ void CreateLogicalDevice(GraphioContext *ctx)
     // After we created the logical device, we can fetch the actual queues.
     vkGetDeviceQueue(ctx->device, ctx->graphicsQueueFamilyIdx, 0, &ctx->graphicsQueue);
     vkGetDeviceQueue(ctx->device, ctx->presentQueueFamilyIdx, 0, &ctx->presentQueue);
+
+    if (ctx->presentWaitSupported)
+    {
+        ctx->pfnWaitForPresentKHR = (PFN_vkWaitForPresentKHR)vkGetDeviceProcAddr(ctx->device, "vkWaitForPresentKHR");
+        ctx->presentWaitSupported = ctx->pfnWaitForPresentKHR != NULL;
+    }
+    logger_LogInfo(ctx->logger, "Present wait %s.", ctx->presentWaitSupported ? "enabled" : "not supported");
 }
 
 void CreateSwapChain(GraphioContext *ctx)
@@ -482,7 +746,7 @@ void CreateSwapChain(GraphioContext *ctx)
     SwapChainSupportDetails swap_chain_support = QuerySwapChainSupport(ctx);
 
     VkSurfaceFormatKHR surface_format = ChooseSwapSurfaceFormat(&swap_chain_support);
-    VkPresentModeKHR present_mode = ChooseSwapPresentMode(&swap_chain_support);
+    VkPresentModeKHR present_mode = ChooseSwapPresentMode(ctx, &swap_chain_support);
     VkExtent2D extent = ChooseSwapExtent(ctx, &swap_chain_support);
 
     uint32_t image_count = swap_chain_support.capabilities.minImageCount + 1;
@@ -559,7 +823,8 @@ void CreateRenderPass(GraphioContext *ctx)
         .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
         .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
         .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-        .finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+        // Offscreen targets are copied out after the pass by RecordReadback.
+        .finalLayout = ctx->headless ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
     };
 
     VkAttachmentReference color_attachment_ref = {
@@ -804,45 +1069,58 @@ void CreateCommandPool(GraphioContext *ctx)
 
 void CreateTextureImage(GraphioContext *ctx)
 {
-    // Create and map texture staging buffer.
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    CreateBuffer(ctx, ctx->display->display_buffer_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                 VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-                 &ctx->textureStagingBuffer, &ctx->textureStagingBufferMemory);
-    CALL_VK(vkMapMemory(ctx->device, ctx->textureStagingBufferMemory, 0,
-                        ctx->display->display_buffer_size, 0,
-                        &ctx->pTextureStagingBufferMemory),
-            ctx->logger, "Failed to map memory for texture image staging buffer.");
-
-    // Create texture image.
-    CreateImage(ctx, (uint32_t)ctx->display->display_buffer_width,
-                (uint32_t)ctx->display->display_buffer_height,
-                VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL,
-                VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                &ctx->textureImage, &ctx->textureImageMemory);
-
-    // We do an initial load of texture data to the texture image.
-    memcpy(ctx->pTextureStagingBufferMemory, ctx->display->display_buffer,
-           (size_t)ctx->display->display_buffer_size);
-
-    // Transition the texture image to VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL.
-    TransitionImageLayout(ctx, ctx->textureImage, VK_FORMAT_R8G8B8A8_SRGB,
-                          VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-    // Copy buffer to image.
-    CopyBufferToImage(ctx, ctx->textureStagingBuffer, ctx->textureImage,
-                      (uint32_t)ctx->display->display_buffer_width,
-                      (uint32_t)ctx->display->display_buffer_height);
-    // Transition texture image from VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL 
-    // to VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL to prepare it for shader access.
-    TransitionImageLayout(ctx, ctx->textureImage, VK_FORMAT_R8G8B8A8_SRGB,
-                          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    // Every texture starts out with the same frame, uploaded in one batch at startup.
+    const DisplayFrame *frame = core_AcquireDisplayFrame(ctx->display, NULL);
+    VkCommandBuffer commandBuffer = BeginSingleTimeCommands(ctx);
+
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        FrameTexture *texture = &ctx->textures[i];
+
+        // Create and persistently map texture staging buffer.
+        CreateBuffer(ctx, ctx->display->display_buffer_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                     VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                     &texture->stagingBuffer, &texture->stagingBufferMemory);
+        CALL_VK(vkMapMemory(ctx->device, texture->stagingBufferMemory, 0,
+                            ctx->display->display_buffer_size, 0,
+                            &texture->pStagingBufferMemory),
+                ctx->logger, "Failed to map memory for texture image staging buffer.");
+
+        // Create texture image.
+        CreateImage(ctx, (uint32_t)ctx->display->display_buffer_width,
+                    (uint32_t)ctx->display->display_buffer_height,
+                    VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL,
+                    VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                    &texture->image, &texture->imageMemory);
+
+        // We do an initial load of texture data to the texture image.
+        core_TakeDisplayFrameChanges(frame, &texture->frame);
+        core_ExpandDisplayRGBA(frame->planes, frame->plane_mask, frame->hires, texture->pStagingBufferMemory);
+
+        // Transition the texture image to VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL.
+        TransitionImageLayout(ctx, commandBuffer, texture->image, VK_FORMAT_R8G8B8A8_SRGB,
+                              VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+        // Copy buffer to image.
+        CopyBufferToImage(commandBuffer, texture->stagingBuffer, 0, texture->image, 0,
+                          (uint32_t)ctx->display->display_buffer_width,
+                          (uint32_t)ctx->display->display_buffer_height);
+        // Transition texture image from VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
+        // to VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL to prepare it for shader access.
+        TransitionImageLayout(ctx, commandBuffer, texture->image, VK_FORMAT_R8G8B8A8_SRGB,
+                              VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    }
+
+    EndSingleTimeCommands(ctx, commandBuffer);
 }
 
 void CreateTextureImageView(GraphioContext *ctx)
 {
-    ctx->textureImageView = CreateImageView(ctx, ctx->textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT);
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        ctx->textures[i].imageView = CreateImageView(ctx, ctx->textures[i].image, VK_FORMAT_R8G8B8A8_SRGB,
+                                                     VK_IMAGE_ASPECT_COLOR_BIT);
+    }
 }
 
 void CreateTextureSampler(GraphioContext *ctx)
@@ -907,7 +1185,7 @@ void CreateDescriptorSets(GraphioContext *ctx)
     {
         VkDescriptorImageInfo imageInfo = {};
         imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        imageInfo.imageView = ctx->textureImageView;
+        imageInfo.imageView = ctx->textures[i].imageView;
         imageInfo.sampler = ctx->textureSampler;
 
         VkWriteDescriptorSet descriptorWrite[1] = {};
@@ -999,8 +1277,12 @@ bool CheckValidationLayerSupport(GraphioContext *ctx)
 char **GetRequiredExtensions(GraphioContext *ctx, uint32_t *count)
 {
     uint32_t glfwExtensionCount = 0;
-    const char **glfwExtensions;
-    glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    const char **glfwExtensions = NULL;
+    // Headless contexts need no surface extensions.
+    if (!ctx->headless)
+    {
+        glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    }
 
     char **extensions;
     if (ctx->enable_validation_layers)
@@ -1094,6 +1376,10 @@ void RecreateSwapChain(GraphioContext *ctx)
     CreateSwapChain(ctx);
     CreateImageViews(ctx);
     CreateFramebuffers(ctx);
+
+    // Present ids belong to the old swapchain. Nothing is left to wait for.
+    ctx->presentId = 0;
+    ctx->latencyPresentId = 0;
 }
 
 // Get details about Swapchain surface-support.
@@ -1137,14 +1423,30 @@ VkSurfaceFormatKHR ChooseSwapSurfaceFormat(SwapChainSupportDetails *support)
     return support->formats[0];
 }
 
-VkPresentModeKHR ChooseSwapPresentMode(SwapChainSupportDetails *support)
+VkPresentModeKHR ChooseSwapPresentMode(GraphioContext *ctx, SwapChainSupportDetails *support)
 {
+    VkPresentModeKHR requested;
+    switch (ctx->presentMode)
+    {
+    case GRAPHIO_PRESENT_MODE_MAILBOX:
+        requested = VK_PRESENT_MODE_MAILBOX_KHR;
+        break;
+    case GRAPHIO_PRESENT_MODE_IMMEDIATE:
+        requested = VK_PRESENT_MODE_IMMEDIATE_KHR;
+        break;
+    default:
+        requested = VK_PRESENT_MODE_FIFO_KHR;
+        break;
+    }
+
     for (uint32_t i = 0; i < support->present_modes_count; i++)
     {
-        if (support->present_modes[i] == VK_PRESENT_MODE_MAILBOX_KHR)
+        if (support->present_modes[i] == requested)
             return support->present_modes[i];
     }
 
+    // FIFO is the only mode every surface must support.
+    logger_LogInfo(ctx->logger, "Present mode %d not supported. Using FIFO.", (int)requested);
     return VK_PRESENT_MODE_FIFO_KHR;
 }
 
@@ -1241,12 +1543,12 @@ void CreateImage(GraphioContext *ctx, uint32_t width, uint32_t height, VkFormat
             ctx->logger, "Failed to bind texture image to texture image memory.");
 }
 
-void CopyBufferToImage(GraphioContext *ctx, VkBuffer buffer, VkImage image, uint32_t width, uint32_t height)
+// Records a copy of 'height' tightly packed rows from 'buffer' to rows [y, y + height) of 'image'.
+void CopyBufferToImage(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize buffer_offset, VkImage image,
+                       uint32_t y, uint32_t width, uint32_t height)
 {
-    VkCommandBuffer commandBuffer = BeginSingleTimeCommands(ctx);
-
     VkBufferImageCopy region = {};
-    region.bufferOffset = 0;
+    region.bufferOffset = buffer_offset;
     region.bufferRowLength = 0;
     region.bufferImageHeight = 0;
     region.imageSubresource = (VkImageSubresourceLayers){
@@ -1257,7 +1559,7 @@ void CopyBufferToImage(GraphioContext *ctx, VkBuffer buffer, VkImage image, uint
     };
     region.imageOffset = (VkOffset3D){
         .x = 0,
-        .y = 0,
+        .y = (int32_t)y,
         .z = 0,
     };
     region.imageExtent = (VkExtent3D){
@@ -1267,14 +1569,12 @@ void CopyBufferToImage(GraphioContext *ctx, VkBuffer buffer, VkImage image, uint
     };
 
     vkCmdCopyBufferToImage(commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-
-    EndSingleTimeCommands(ctx, commandBuffer);
 }
 
-void TransitionImageLayout(GraphioContext *ctx, VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout)
+// Records a layout transition barrier into 'commandBuffer'.
+void TransitionImageLayout(GraphioContext *ctx, VkCommandBuffer commandBuffer, VkImage image, VkFormat format,
+                           VkImageLayout oldLayout, VkImageLayout newLayout)
 {
-    VkCommandBuffer commandBuffer = BeginSingleTimeCommands(ctx);
-
     VkImageMemoryBarrier memoryBarrier = {};
     memoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
     memoryBarrier.oldLayout = oldLayout;
@@ -1309,6 +1609,16 @@ void TransitionImageLayout(GraphioContext *ctx, VkImage image, VkFormat format,
         // The destination is the transfer pseudo-stage.
         destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
     }
+    else if (oldLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL)
+    {
+        // Unlike from undefined, this keeps the contents, so a partial copy can update them.
+        // Wait for earlier draws to finish sampling before writing.
+        memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        memoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+        sourceStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    }
     else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
     {
         // Set transfer write in source stage.
@@ -1321,6 +1631,15 @@ void TransitionImageLayout(GraphioContext *ctx, VkImage image, VkFormat format,
         // Set destination stage to fragment shader.
         destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
     }
+    else if (oldLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL)
+    {
+        // Wait for the render pass to finish writing before copying out of the image.
+        memoryBarrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        memoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+        sourceStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    }
     else if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL)
     {
         memoryBarrier.srcAccessMask = 0;
@@ -1335,8 +1654,6 @@ void TransitionImageLayout(GraphioContext *ctx, VkImage image, VkFormat format,
     }
 
     vkCmdPipelineBarrier(commandBuffer, sourceStage, destinationStage, 0, 0, NULL, 0, NULL, 1, &memoryBarrier);
-
-    EndSingleTimeCommands(ctx, commandBuffer);
 }
 
 // Memory/Buffers
@@ -1429,6 +1746,9 @@ void RecordCommandBuffer(GraphioContext *ctx, uint32_t image_index)
     CALL_VK(vkBeginCommandBuffer(ctx->commandBuffers[ctx->currentFrame], &begin_info),
             ctx->logger, "Failed to being recording command buffer for image %i.", image_index);
 
+    // Texture uploads go in ahead of the render pass, in the same submission as the draw.
+    UpdateTexture(ctx, ctx->commandBuffers[ctx->currentFrame]);
+
     VkClearValue clearValues[1] = {};
     clearValues[0].color.float32[0] = 0.0f;
     clearValues[0].color.float32[1] = 0.0f;
@@ -1438,7 +1758,8 @@ void RecordCommandBuffer(GraphioContext *ctx, uint32_t image_index)
     VkRenderPassBeginInfo renderpass_begin_info = {
         .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
         .renderPass = ctx->renderPass,
-        .framebuffer = ctx->swapChainFramebuffers[image_index],
+        .framebuffer = ctx->headless ? ctx->offscreenTargets[image_index].framebuffer
+                                     : ctx->swapChainFramebuffers[image_index],
         .renderArea = {
             .offset = {0, 0},
             .extent = ctx->swapChainExtent,
@@ -1474,6 +1795,11 @@ void RecordCommandBuffer(GraphioContext *ctx, uint32_t image_index)
 
     vkCmdEndRenderPass(ctx->commandBuffers[ctx->currentFrame]);
 
+    if (ctx->headless)
+    {
+        RecordReadback(ctx, ctx->commandBuffers[ctx->currentFrame], &ctx->offscreenTargets[image_index]);
+    }
+
     // When we record commands, we are not able to error-check. When we here call
     // 'vkEndCommandBuffer', we are finally submitting the commands and can then error-check.
     // This means that no errors are caught until we are finished recording.
@@ -1517,19 +1843,285 @@ void EndSingleTimeCommands(GraphioContext *ctx, VkCommandBuffer commandBuffer)
 
 // Textures
 
-void UpdateTexture(GraphioContext *ctx)
+void UpdateTexture(GraphioContext *ctx, VkCommandBuffer commandBuffer)
 {
-    memcpy(ctx->pTextureStagingBufferMemory, ctx->display->display_buffer,
-           (size_t)ctx->display->display_buffer_size);
+    // This frame's fence has signalled, so the GPU is done with its staging buffer and image.
+    FrameTexture *texture = &ctx->textures[ctx->currentFrame];
 
-    // Transition the texture image to VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL.
-    TransitionImageLayout(ctx, ctx->textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-    // Copy buffer to image.
-    CopyBufferToImage(ctx, ctx->textureStagingBuffer, ctx->textureImage,
-                      (uint32_t)ctx->display->display_buffer_width,
-                      (uint32_t)ctx->display->display_buffer_height);
+    // Take the latest frame the CPU published. It can't change under us while we expand it.
+    const DisplayFrame *frame = core_AcquireDisplayFrame(ctx->display, NULL);
+    uint64_t changed_rows = core_TakeDisplayFrameChanges(frame, &texture->frame);
+    // Most frames draw nothing new. The texture still holds the right image then.
+    if (changed_rows == 0)
+    {
+        return;
+    }
+
+    // Upload the smallest band of rows covering every change.
+    uint32_t first_row = (uint32_t)__builtin_ctzll(changed_rows);
+    uint32_t row_count = 64 - (uint32_t)__builtin_clzll(changed_rows) - first_row;
+    VkDeviceSize row_size = ctx->display->display_buffer_width * ctx->display->display_buffer_channels;
+
+    // Expand straight into the mapped staging buffer. No intermediate RGBA copy is kept.
+    core_ExpandDisplayRowsRGBA(frame->planes, frame->plane_mask, frame->hires, first_row, row_count,
+                               texture->pStagingBufferMemory);
+
+    // Transition the texture image to VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, keeping the rows we don't upload.
+    TransitionImageLayout(ctx, commandBuffer, texture->image, VK_FORMAT_R8G8B8A8_SRGB,
+                          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+    // Copy the changed rows from buffer to image.
+    CopyBufferToImage(commandBuffer, texture->stagingBuffer, first_row * row_size, texture->image, first_row,
+                      (uint32_t)ctx->display->display_buffer_width, row_count);
     // Transition texture image from VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL to VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL to prepare it for shader access.
-    TransitionImageLayout(ctx, ctx->textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    TransitionImageLayout(ctx, commandBuffer, texture->image, VK_FORMAT_R8G8B8A8_SRGB,
+                          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+}
+
+// Headless
+
+void CreateOffscreenTargets(GraphioContext *ctx)
+{
+    VkDeviceSize frame_size = (VkDeviceSize)ctx->swapChainExtent.width * ctx->swapChainExtent.height * HEADLESS_IMAGE_CHANNELS;
+
+    for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        OffscreenTarget *target = &ctx->offscreenTargets[i];
+
+        CreateImage(ctx, ctx->swapChainExtent.width, ctx->swapChainExtent.height,
+                    ctx->swapChainImageFormat, VK_IMAGE_TILING_OPTIMAL,
+                    VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                    &target->image, &target->imageMemory);
+        target->imageView = CreateImageView(ctx, target->image, ctx->swapChainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT);
+
+        // Mapped once for the lifetime of the context. Host coherent, so no invalidation is needed
+        // once the fence has signalled.
+        CreateBuffer(ctx, frame_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                     VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                     &target->readbackBuffer, &target->readbackBufferMemory);
+        CALL_VK(vkMapMemory(ctx->device, target->readbackBufferMemory, 0, frame_size, 0,
+                            &target->pReadbackBufferMemory),
+                ctx->logger, "Failed to map memory for readback buffer %u.", i);
+
+        target->frameNumber = 0;
+    }
+}
+
+void CreateOffscreenFramebuffers(GraphioContext *ctx)
+{
+    for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        VkImageView attachments[] = {
+            ctx->offscreenTargets[i].imageView};
+
+        VkFramebufferCreateInfo framebufferInfo = {
+            .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+            .renderPass = ctx->renderPass,
+            .attachmentCount = 1,
+            .pAttachments = attachments,
+            .width = ctx->swapChainExtent.width,
+            .height = ctx->swapChainExtent.height,
+            .layers = 1,
+        };
+
+        CALL_VK(vkCreateFramebuffer(ctx->device, &framebufferInfo, NULL, &ctx->offscreenTargets[i].framebuffer),
+                ctx->logger, "Failed to create offscreen framebuffer %i", i);
+    }
+}
+
+void DestroyOffscreenTargets(GraphioContext *ctx)
+{
+    for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        OffscreenTarget *target = &ctx->offscreenTargets[i];
+        vkDestroyFramebuffer(ctx->device, target->framebuffer, NULL);
+        vkDestroyImageView(ctx->device, target->imageView, NULL);
+        vkDestroyImage(ctx->device, target->image, NULL);
+        vkFreeMemory(ctx->device, target->imageMemory, NULL);
+        vkUnmapMemory(ctx->device, target->readbackBufferMemory);
+        vkDestroyBuffer(ctx->device, target->readbackBuffer, NULL);
+        vkFreeMemory(ctx->device, target->readbackBufferMemory, NULL);
+    }
+}
+
+// gio_Draw for headless contexts. Renders into the offscreen target of the current frame and
+// submits without waiting for the result. Frame 'currentFrame' is signalled by its own fence,
+// which gio_ReadbackFrame polls.
+void DrawOffscreen(GraphioContext *ctx)
+{
+    RecordFrameTime(ctx);
+
+    // Only blocks if the GPU is MAX_FRAMES_IN_FLIGHT frames behind.
+    vkWaitForFences(ctx->device, 1, &ctx->inFlightFences[ctx->currentFrame], VK_TRUE, UINT64_MAX);
+    vkResetFences(ctx->device, 1, &ctx->inFlightFences[ctx->currentFrame]);
+
+    vkResetCommandBuffer(ctx->commandBuffers[ctx->currentFrame], /*VkCommandBufferResetFlagBits*/ 0);
+    RecordCommandBuffer(ctx, ctx->currentFrame);
+
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &ctx->commandBuffers[ctx->currentFrame];
+
+    if (vkQueueSubmit(ctx->graphicsQueue, 1, &submitInfo, ctx->inFlightFences[ctx->currentFrame]) != VK_SUCCESS)
+    {
+        PANIC(ctx->logger, "Failed to submit offscreen command buffer.");
+    }
+
+    ctx->offscreenTargets[ctx->currentFrame].frameNumber = ++ctx->framesSubmitted;
+    ctx->currentFrame = (ctx->currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+}
+
+// Records the copy of 'target' into its readback buffer, after the render pass.
+void RecordReadback(GraphioContext *ctx, VkCommandBuffer commandBuffer, OffscreenTarget *target)
+{
+    TransitionImageLayout(ctx, commandBuffer, target->image, ctx->swapChainImageFormat,
+                          VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+
+    VkBufferImageCopy region = {};
+    region.bufferOffset = 0;
+    // Tightly packed rows.
+    region.bufferRowLength = 0;
+    region.bufferImageHeight = 0;
+    region.imageSubresource = (VkImageSubresourceLayers){
+        .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+        .mipLevel = 0,
+        .baseArrayLayer = 0,
+        .layerCount = 1,
+    };
+    region.imageOffset = (VkOffset3D){0, 0, 0};
+    region.imageExtent = (VkExtent3D){
+        .width = ctx->swapChainExtent.width,
+        .height = ctx->swapChainExtent.height,
+        .depth = 1,
+    };
+    vkCmdCopyImageToBuffer(commandBuffer, target->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                           target->readbackBuffer, 1, &region);
+
+    // Make the copy visible to the host once the fence signals.
+    VkBufferMemoryBarrier bufferBarrier = {};
+    bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    bufferBarrier.buffer = target->readbackBuffer;
+    bufferBarrier.offset = 0;
+    bufferBarrier.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+                         0, 0, NULL, 1, &bufferBarrier, 0, NULL);
+}
+
+// Frame pacing
+
+bool CheckPresentWaitSupport(GraphioContext *ctx)
+{
+    // Feature queries need Vulkan 1.1 on the device as well as the instance.
+    VkPhysicalDeviceProperties properties = {};
+    vkGetPhysicalDeviceProperties(ctx->physicalDevice, &properties);
+    if (properties.apiVersion < VK_API_VERSION_1_1)
+    {
+        return false;
+    }
+
+    uint32_t available_count = 0;
+    CALL_VK(vkEnumerateDeviceExtensionProperties(ctx->physicalDevice, NULL, &available_count, NULL),
+            ctx->logger, "Failed to enumerate device extensions.");
+    VkExtensionProperties *available = calloc(available_count, sizeof(VkExtensionProperties));
+    CALL_VK(vkEnumerateDeviceExtensionProperties(ctx->physicalDevice, NULL, &available_count, available),
+            ctx->logger, "Failed to enumerate device extensions.");
+
+    uint32_t found = 0;
+    for (uint32_t i = 0; i < present_wait_extensions_count; i++)
+    {
+        for (uint32_t j = 0; j < available_count; j++)
+        {
+            if (strcmp(present_wait_extensions[i], available[j].extensionName) == 0)
+            {
+                found++;
+                break;
+            }
+        }
+    }
+    free(available);
+    if (found != present_wait_extensions_count)
+    {
+        return false;
+    }
+
+    // Having the extensions doesn't mean the features are usable, e.g. on some window systems.
+    VkPhysicalDevicePresentWaitFeaturesKHR present_wait_features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR,
+    };
+    VkPhysicalDevicePresentIdFeaturesKHR present_id_features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR,
+        .pNext = &present_wait_features,
+    };
+    VkPhysicalDeviceFeatures2 features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+        .pNext = &present_id_features,
+    };
+    vkGetPhysicalDeviceFeatures2(ctx->physicalDevice, &features);
+
+    return present_id_features.presentId && present_wait_features.presentWait;
+}
+
+void RecordFrameTime(GraphioContext *ctx)
+{
+    double now = GetMonotonicTime();
+    if (ctx->framesDrawn > 0)
+    {
+        ctx->frameTimes[ctx->frameTimeSamples++ % FRAME_METRICS_HISTORY] = now - ctx->lastDrawTime;
+    }
+    ctx->lastDrawTime = now;
+    ctx->framesDrawn++;
+}
+
+void RecordInputLatency(GraphioContext *ctx, double latency)
+{
+    ctx->inputLatencies[ctx->inputLatencySamples++ % FRAME_METRICS_HISTORY] = latency;
+}
+
+// Completes the pending input latency sample once its present has reached the screen.
+void PollInputLatency(GraphioContext *ctx)
+{
+    if (ctx->latencyPresentId == 0)
+    {
+        return;
+    }
+
+    if (ctx->pfnWaitForPresentKHR(ctx->device, ctx->swapChain, ctx->latencyPresentId, 0) == VK_SUCCESS)
+    {
+        RecordInputLatency(ctx, GetMonotonicTime() - ctx->latencyInputTime);
+        ctx->latencyPresentId = 0;
+    }
+}
+
+void SummarizeSamples(const double *samples, uint64_t samples_count, double *p50, double *p95, double *p99, double *max)
+{
+    size_t n = samples_count < FRAME_METRICS_HISTORY ? (size_t)samples_count : FRAME_METRICS_HISTORY;
+    if (n == 0)
+    {
+        *p50 = *p95 = *p99 = *max = 0;
+        return;
+    }
+
+    double sorted[FRAME_METRICS_HISTORY];
+    memcpy(sorted, samples, n * sizeof(double));
+    qsort(sorted, n, sizeof(double), CompareDoubles);
+
+    // Nearest-rank percentiles.
+    *p50 = sorted[(n - 1) * 50 / 100];
+    *p95 = sorted[(n - 1) * 95 / 100];
+    *p99 = sorted[(n - 1) * 99 / 100];
+    *max = sorted[n - 1];
+}
+
+int CompareDoubles(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
 }
 
 // Keys
@@ -1541,98 +2133,97 @@ void SetKeyPressed(GraphioContext *ctx, int key)
     case GLFW_KEY_1:
     {
         logger_LogDebug(ctx->logger, "Key 1 pressed.");
-        // Only one key should be pressed at a time.
-        *(ctx->keys) = CH8_IO_KEY1_BIT;
+        core_PressInputKey(ctx->input, CH8_IO_KEY1_BIT);
         break;
     }
     case GLFW_KEY_2:
     {
         logger_LogDebug(ctx->logger, "Key 2 pressed.");
-        *(ctx->keys) = CH8_IO_KEY2_BIT;
+        core_PressInputKey(ctx->input, CH8_IO_KEY2_BIT);
         break;
     }
     case GLFW_KEY_3:
     {
         logger_LogDebug(ctx->logger, "Key 3 pressed.");
-        *(ctx->keys) = CH8_IO_KEY3_BIT;
+        core_PressInputKey(ctx->input, CH8_IO_KEY3_BIT);
         break;
     }
     case GLFW_KEY_4:
     {
         logger_LogDebug(ctx->logger, "Key C pressed.");
-        *(ctx->keys) = CH8_IO_KEYC_BIT;
+        core_PressInputKey(ctx->input, CH8_IO_KEYC_BIT);
         break;
     }
     case GLFW_KEY_Q:
     {
         logger_LogDebug(ctx->logger, "Key 4 pressed.");
-        *(ctx->keys) = CH8_IO_KEY4_BIT;
+        core_PressInputKey(ctx->input, CH8_IO_KEY4_BIT);
         break;
     }
     case GLFW_KEY_W:
     {
         logger_LogDebug(ctx->logger, "Key 5 pressed.");
-        *(ctx->keys) = CH8_IO_KEY5_BIT;
+        core_PressInputKey(ctx->input, CH8_IO_KEY5_BIT);
         break;
     }
     case GLFW_KEY_E:
     {
         logger_LogDebug(ctx->logger, "Key 6 pressed.");
-        *(ctx->keys) = CH8_IO_KEY6_BIT;
+        core_PressInputKey(ctx->input, CH8_IO_KEY6_BIT);
         break;
     }
     case GLFW_KEY_R:
     {
         logger_LogDebug(ctx->logger, "Key D pressed.");
-        *(ctx->keys) = CH8_IO_KEYD_BIT;
+        core_PressInputKey(ctx->input, CH8_IO_KEYD_BIT);
         break;
     }
     case GLFW_KEY_A:
     {
         logger_LogDebug(ctx->logger, "Key 7 pressed.");
-        *(ctx->keys) = CH8_IO_KEY7_BIT;
+        core_PressInputKey(ctx->input, CH8_IO_KEY7_BIT);
         break;
     }
     case GLFW_KEY_S:
     {
         logger_LogDebug(ctx->logger, "Key 8 pressed.");
-        *(ctx->keys) = CH8_IO_KEY8_BIT;
+        core_PressInputKey(ctx->input, CH8_IO_KEY8_BIT);
         break;
     }
     case GLFW_KEY_D:
     {
         logger_LogDebug(ctx->logger, "Key 9 pressed.");
-        *(ctx->keys) = CH8_IO_KEY9_BIT;
+        core_PressInputKey(ctx->input, CH8_IO_KEY9_BIT);
         break;
     }
     case GLFW_KEY_F:
     {
         logger_LogDebug(ctx->logger, "Key E pressed.");
-        *(ctx->keys) = CH8_IO_KEYE_BIT;
+        core_PressInputKey(ctx->input, CH8_IO_KEYE_BIT);
         break;
     }
     case GLFW_KEY_Z:
     {
         logger_LogDebug(ctx->logger, "Key A pressed.");
-        *(ctx->keys) = CH8_IO_KEYA_BIT;
+        core_PressInputKey(ctx->input, CH8_IO_KEYA_BIT);
         break;
     }
     case GLFW_KEY_X:
     {
         logger_LogDebug(ctx->logger, "Key 0 pressed.");
-        *(ctx->keys) = CH8_IO_KEY0_BIT;
+        core_PressInputKey(ctx->input, CH8_IO_KEY0_BIT);
         break;
     }
     case GLFW_KEY_C:
     {
         logger_LogDebug(ctx->logger, "Key B pressed.");
-        *(ctx->keys) = CH8_IO_KEYB_BIT;
+        core_PressInputKey(ctx->input, CH8_IO_KEYB_BIT);
         break;
     }
     case GLFW_KEY_V:
     {
         logger_LogDebug(ctx->logger, "Key F pressed.");
-        *(ctx->keys) = CH8_IO_KEYF_BIT;
+        core_PressInputKey(ctx->input, CH8_IO_KEYF_BIT);
         break;
     }
     default:
@@ -1648,97 +2239,97 @@ void SetKeyReleased(GraphioContext *ctx, int key)
     case GLFW_KEY_1:
     {
         logger_LogDebug(ctx->logger, "Key 1 released.");
-        *(ctx->keys) ^= CH8_IO_KEY1_BIT;
+        core_ReleaseInputKey(ctx->input, CH8_IO_KEY1_BIT);
         break;
     }
     case GLFW_KEY_2:
     {
         logger_LogDebug(ctx->logger, "Key 2 released.");
-        *(ctx->keys) ^= CH8_IO_KEY2_BIT;
+        core_ReleaseInputKey(ctx->input, CH8_IO_KEY2_BIT);
         break;
     }
     case GLFW_KEY_3:
     {
         logger_LogDebug(ctx->logger, "Key 3 released.");
-        *(ctx->keys) ^= CH8_IO_KEY3_BIT;
+        core_ReleaseInputKey(ctx->input, CH8_IO_KEY3_BIT);
         break;
     }
     case GLFW_KEY_4:
     {
         logger_LogDebug(ctx->logger, "Key C released.");
-        *(ctx->keys) ^= CH8_IO_KEYC_BIT;
+        core_ReleaseInputKey(ctx->input, CH8_IO_KEYC_BIT);
         break;
     }
     case GLFW_KEY_Q:
     {
         logger_LogDebug(ctx->logger, "Key 4 released.");
-        *(ctx->keys) ^= CH8_IO_KEY4_BIT;
+        core_ReleaseInputKey(ctx->input, CH8_IO_KEY4_BIT);
         break;
     }
     case GLFW_KEY_W:
     {
         logger_LogDebug(ctx->logger, "Key 5 released.");
-        *(ctx->keys) ^= CH8_IO_KEY5_BIT;
+        core_ReleaseInputKey(ctx->input, CH8_IO_KEY5_BIT);
         break;
     }
     case GLFW_KEY_E:
     {
         logger_LogDebug(ctx->logger, "Key 6 released.");
-        *(ctx->keys) ^= CH8_IO_KEY6_BIT;
+        core_ReleaseInputKey(ctx->input, CH8_IO_KEY6_BIT);
         break;
     }
     case GLFW_KEY_R:
     {
         logger_LogDebug(ctx->logger, "Key D released.");
-        *(ctx->keys) ^= CH8_IO_KEYD_BIT;
+        core_ReleaseInputKey(ctx->input, CH8_IO_KEYD_BIT);
         break;
     }
     case GLFW_KEY_A:
     {
         logger_LogDebug(ctx->logger, "Key 7 released.");
-        *(ctx->keys) ^= CH8_IO_KEY7_BIT;
+        core_ReleaseInputKey(ctx->input, CH8_IO_KEY7_BIT);
         break;
     }
     case GLFW_KEY_S:
     {
         logger_LogDebug(ctx->logger, "Key 8 released.");
-        *(ctx->keys) ^= CH8_IO_KEY8_BIT;
+        core_ReleaseInputKey(ctx->input, CH8_IO_KEY8_BIT);
         break;
     }
     case GLFW_KEY_D:
     {
         logger_LogDebug(ctx->logger, "Key 9 released.");
-        *(ctx->keys) ^= CH8_IO_KEY9_BIT;
+        core_ReleaseInputKey(ctx->input, CH8_IO_KEY9_BIT);
         break;
     }
     case GLFW_KEY_F:
     {
         logger_LogDebug(ctx->logger, "Key E released.");
-        *(ctx->keys) ^= CH8_IO_KEYE_BIT;
+        core_ReleaseInputKey(ctx->input, CH8_IO_KEYE_BIT);
         break;
     }
     case GLFW_KEY_Z:
     {
         logger_LogDebug(ctx->logger, "Key A released.");
-        *(ctx->keys) ^= CH8_IO_KEYA_BIT;
+        core_ReleaseInputKey(ctx->input, CH8_IO_KEYA_BIT);
         break;
     }
     case GLFW_KEY_X:
     {
         logger_LogDebug(ctx->logger, "Key 0 released.");
-        *(ctx->keys) ^= CH8_IO_KEY0_BIT;
+        core_ReleaseInputKey(ctx->input, CH8_IO_KEY0_BIT);
         break;
     }
     case GLFW_KEY_C:
     {
         logger_LogDebug(ctx->logger, "Key B released.");
-        *(ctx->keys) ^= CH8_IO_KEYB_BIT;
+        core_ReleaseInputKey(ctx->input, CH8_IO_KEYB_BIT);
         break;
     }
     case GLFW_KEY_V:
     {
         logger_LogDebug(ctx->logger, "Key F released.");
-        *(ctx->keys) ^= CH8_IO_KEYF_BIT;
+        core_ReleaseInputKey(ctx->input, CH8_IO_KEYF_BIT);
         break;
     }
     default:
@@ -1753,6 +2344,12 @@ void glfwKeyCallback(GLFWwindow *window, int key, int scancode, int action, int
 {
     GraphioContext *ctx = glfwGetWindowUserPointer(window);
 
+    // Start of an input latency sample. Repeats are not new input.
+    if ((action == GLFW_PRESS || action == GLFW_RELEASE) && ctx->pendingInputTime == 0)
+    {
+        ctx->pendingInputTime = GetMonotonicTime();
+    }
+
     if (action == GLFW_PRESS)
     {
         SetKeyPressed(ctx, key);
@@ -0,0 +1,134 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+#include <core/keys.h>
+
+#include "test.h"
+
+// Long enough for a waiter to have blocked, not a correctness bound.
+#define WAITER_BLOCK_US (50 * 1000)
+
+static InputChannel input;
+static atomic_bool waiter_returned;
+
+static void TestShortPress();
+static void TestEdgeOverflow();
+static void TestInterruptWaiter();
+static void TestKeyWakesWaiter();
+static void *WaitForKeys(void *vargp);
+
+// Presses shorter than the CPU's polling interval are seen as two edges, and the channel
+// never blocks the CPU thread for good.
+int main()
+{
+    TestShortPress();
+    TestEdgeOverflow();
+    TestInterruptWaiter();
+    TestKeyWakesWaiter();
+
+    return TEST_RESULT();
+}
+
+void TestShortPress()
+{
+    printf("short press\n");
+    core_InitializeInputChannel(&input);
+
+    core_PressInputKey(&input, CH8_IO_KEY5_BIT);
+    core_ReleaseInputKey(&input, CH8_IO_KEY5_BIT);
+    CHECK(core_GetInputKeys(&input) == 0);
+    CHECK(core_PollInputKeys(&input) == CH8_IO_KEY5_BIT);
+    CHECK(core_PollInputKeys(&input) == 0);
+
+    // Chords keep the other held keys in each edge. Repeats of a held key add no edge.
+    core_PressInputKey(&input, CH8_IO_KEY1_BIT);
+    core_PressInputKey(&input, CH8_IO_KEY1_BIT);
+    core_PressInputKey(&input, CH8_IO_KEYA_BIT);
+    core_ReleaseInputKey(&input, CH8_IO_KEY1_BIT);
+    CHECK(core_PollInputKeys(&input) == CH8_IO_KEY1_BIT);
+    CHECK(core_PollInputKeys(&input) == (CH8_IO_KEY1_BIT | CH8_IO_KEYA_BIT));
+    CHECK(core_PollInputKeys(&input) == CH8_IO_KEYA_BIT);
+    // Nothing queued: the held keys.
+    CHECK(core_PollInputKeys(&input) == CH8_IO_KEYA_BIT);
+
+    core_DestroyInputChannel(&input);
+}
+
+void TestEdgeOverflow()
+{
+    printf("edge overflow\n");
+    core_InitializeInputChannel(&input);
+
+    // Fills the queue exactly, then the last press is dropped.
+    for (int i = 0; i < CH8_INPUT_EDGE_CAPACITY / 2; i++)
+    {
+        core_PressInputKey(&input, CH8_IO_KEY3_BIT);
+        core_ReleaseInputKey(&input, CH8_IO_KEY3_BIT);
+    }
+    core_PressInputKey(&input, CH8_IO_KEYF_BIT);
+
+    for (int i = 0; i < CH8_INPUT_EDGE_CAPACITY; i++)
+    {
+        CHECK(core_PollInputKeys(&input) == (i % 2 == 0 ? CH8_IO_KEY3_BIT : 0));
+    }
+    // Once drained, the CPU catches up from the held keys.
+    CHECK(core_PollInputKeys(&input) == CH8_IO_KEYF_BIT);
+
+    // And the queue takes edges again.
+    core_ReleaseInputKey(&input, CH8_IO_KEYF_BIT);
+    core_PressInputKey(&input, CH8_IO_KEY0_BIT);
+    CHECK(core_PollInputKeys(&input) == 0);
+    CHECK(core_PollInputKeys(&input) == CH8_IO_KEY0_BIT);
+
+    core_DestroyInputChannel(&input);
+}
+
+void TestInterruptWaiter()
+{
+    printf("interrupt waiter\n");
+    core_InitializeInputChannel(&input);
+    atomic_store(&waiter_returned, false);
+
+    pthread_t waiter;
+    pthread_create(&waiter, NULL, WaitForKeys, NULL);
+    usleep(WAITER_BLOCK_US);
+    CHECK(!atomic_load(&waiter_returned));
+
+    core_InterruptInputChannel(&input);
+    pthread_join(waiter, NULL);
+    CHECK(atomic_load(&waiter_returned));
+
+    // Until resumed, waiting returns at once.
+    core_WaitInputChannel(&input, 0);
+    core_ResumeInputChannel(&input);
+
+    core_DestroyInputChannel(&input);
+}
+
+void TestKeyWakesWaiter()
+{
+    printf("key wakes waiter\n");
+    core_InitializeInputChannel(&input);
+    atomic_store(&waiter_returned, false);
+
+    pthread_t waiter;
+    pthread_create(&waiter, NULL, WaitForKeys, NULL);
+    usleep(WAITER_BLOCK_US);
+    CHECK(!atomic_load(&waiter_returned));
+
+    core_PressInputKey(&input, CH8_IO_KEY7_BIT);
+    pthread_join(waiter, NULL);
+    CHECK(atomic_load(&waiter_returned));
+    CHECK(core_PollInputKeys(&input) == CH8_IO_KEY7_BIT);
+
+    core_DestroyInputChannel(&input);
+}
+
+void *WaitForKeys(void *vargp)
+{
+    (void)vargp;
+    core_WaitInputChannel(&input, 0);
+    atomic_store(&waiter_returned, true);
+    return NULL;
+}
@@ -0,0 +1,138 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+
+#include <logger/logger.h>
+
+#include "test.h"
+
+#define LOG_FILENAME CH8_TEST_OUTPUT_DIR "logger_test.log"
+#define PRODUCER_COUNT (8)
+#define RECORDS_PER_PRODUCER (5000)
+// Small enough that producers keep running into a full ring.
+#define RING_CAPACITY (64)
+
+static const char *const policy_names[] = {
+    [LOGGER_OVERFLOW_DROP] = "drop",
+    [LOGGER_OVERFLOW_BLOCK] = "block",
+};
+
+static Logger *logger;
+static atomic_ullong submitted;
+static atomic_bool producers_done;
+
+static void TestAllRecordsCounted(LoggerOverflowPolicy policy);
+static void TestStopWithProducers(LoggerOverflowPolicy policy);
+static void *ProduceCount(void *vargp);
+static void *ProduceUntilDone(void *vargp);
+static uint64_t CountLogLines();
+
+// Every record a producer submits to the asynchronous ring is either written or dropped, and
+// the ring can be stopped under producers that are still logging.
+int main()
+{
+    TestAllRecordsCounted(LOGGER_OVERFLOW_DROP);
+    TestAllRecordsCounted(LOGGER_OVERFLOW_BLOCK);
+    TestStopWithProducers(LOGGER_OVERFLOW_DROP);
+    TestStopWithProducers(LOGGER_OVERFLOW_BLOCK);
+
+    return TEST_RESULT();
+}
+
+void TestAllRecordsCounted(LoggerOverflowPolicy policy)
+{
+    printf("all records counted: %s\n", policy_names[policy]);
+    logger = logger_Initialize(LOG_FILENAME, LOG_LEVEL_INFO);
+    atomic_store(&submitted, 0);
+    CHECK(logger_StartAsync(RING_CAPACITY, policy));
+
+    pthread_t producers[PRODUCER_COUNT];
+    for (int i = 0; i < PRODUCER_COUNT; i++)
+        pthread_create(&producers[i], NULL, ProduceCount, NULL);
+    for (int i = 0; i < PRODUCER_COUNT; i++)
+        pthread_join(producers[i], NULL);
+
+    logger_FlushAsync();
+    LoggerAsyncStats stats = logger_GetAsyncStats();
+    CHECK(atomic_load(&submitted) == PRODUCER_COUNT * RECORDS_PER_PRODUCER);
+    CHECK(stats.records_written + stats.records_dropped == atomic_load(&submitted));
+    if (policy == LOGGER_OVERFLOW_BLOCK)
+        CHECK(stats.records_dropped == 0);
+
+    logger_StopAsync();
+    logger_Destroy(logger);
+    CHECK(CountLogLines() == stats.records_written);
+}
+
+void TestStopWithProducers(LoggerOverflowPolicy policy)
+{
+    printf("stop with producers: %s\n", policy_names[policy]);
+    logger = logger_Initialize(LOG_FILENAME, LOG_LEVEL_INFO);
+    atomic_store(&submitted, 0);
+    atomic_store(&producers_done, false);
+    CHECK(logger_StartAsync(RING_CAPACITY, policy));
+
+    pthread_t producers[PRODUCER_COUNT];
+    for (int i = 0; i < PRODUCER_COUNT; i++)
+        pthread_create(&producers[i], NULL, ProduceUntilDone, NULL);
+
+    // Stop only once the ring has filled, so producers are mid-record when it goes away.
+    while (atomic_load(&submitted) < 4 * RING_CAPACITY)
+        sched_yield();
+    logger_StopAsync();
+    uint64_t submitted_at_stop = atomic_load(&submitted);
+
+    // Producers fall back to writing synchronously. Let them log a while longer.
+    while (atomic_load(&submitted) < submitted_at_stop + 4 * RING_CAPACITY)
+        sched_yield();
+    atomic_store(&producers_done, true);
+    for (int i = 0; i < PRODUCER_COUNT; i++)
+        pthread_join(producers[i], NULL);
+
+    // Records that weren't dropped reached the file, through the ring or directly.
+    LoggerAsyncStats stats = logger_GetAsyncStats();
+    logger_Destroy(logger);
+    CHECK(CountLogLines() == atomic_load(&submitted) - stats.records_dropped);
+    if (policy == LOGGER_OVERFLOW_BLOCK)
+        CHECK(stats.records_dropped == 0);
+}
+
+void *ProduceCount(void *vargp)
+{
+    (void)vargp;
+    for (int i = 0; i < RECORDS_PER_PRODUCER; i++)
+    {
+        logger_LogInfo(logger, "Record %d.", i);
+        atomic_fetch_add(&submitted, 1);
+    }
+    return NULL;
+}
+
+void *ProduceUntilDone(void *vargp)
+{
+    (void)vargp;
+    for (int i = 0; !atomic_load(&producers_done); i++)
+    {
+        logger_LogInfo(logger, "Record %d.", i);
+        atomic_fetch_add(&submitted, 1);
+    }
+    return NULL;
+}
+
+uint64_t CountLogLines()
+{
+    FILE *file_pointer = fopen(LOG_FILENAME, "r");
+    if (file_pointer == NULL)
+    {
+        return 0;
+    }
+
+    uint64_t lines = 0;
+    for (int c; (c = fgetc(file_pointer)) != EOF;)
+    {
+        if (c == '\n')
+            lines++;
+    }
+    fclose(file_pointer);
+    return lines;
+}
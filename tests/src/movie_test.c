@@ -0,0 +1,123 @@
+#include <string.h>
+
+#include <core/cpu.h>
+#include <core/movie.h>
+#include <core/state.h>
+
+#include "test.h"
+
+#define MOVIE_FILE CH8_TEST_OUTPUT_DIR "movie_test.ch8m"
+#define START_CYCLE (10007)
+#define SLICE_COUNT (400)
+
+static uint8_t recorded[CH8_STATE_SIZE];
+static uint8_t replayed[CH8_STATE_SIZE];
+
+static size_t Record(const char *rom, CPUMachine machine, bool with_movie);
+static void TestReplay(const char *rom, size_t recorded_size, CPUExecMode mode);
+static void TestMismatch(const char *rom);
+
+// A movie replayed in any execution mode must end in the state the recording did, from a
+// recording that started after reset.
+int main()
+{
+    const char *rom = TEST_ROM("6-keypad.ch8");
+
+    for (CPUMachine machine = CPU_MACHINE_CHIP8; machine < CPU_MACHINE_COUNT; machine++)
+    {
+        size_t size = Record(rom, machine, false);
+        CHECK(size > 0);
+        memcpy(replayed, recorded, size);
+        // The input must matter, or the replays below prove nothing.
+        size = Record(rom, machine, true);
+        CHECK(memcmp(replayed, recorded, size) != 0);
+
+        for (CPUExecMode mode = CPU_EXEC_INTERPRETER; mode <= CPU_EXEC_THREADED; mode++)
+            TestReplay(rom, size, mode);
+    }
+    TestMismatch(rom);
+
+    remove(MOVIE_FILE);
+    return TEST_RESULT();
+}
+
+// Runs 'rom' with a fixed pattern of key presses and saves the final state into 'recorded'.
+// Keys are only pressed when 'with_movie' is set, and are then recorded into MOVIE_FILE.
+size_t Record(const char *rom, CPUMachine machine, bool with_movie)
+{
+    CPUState *cpu = CreateTestCPU(machine, CPU_EXEC_INTERPRETER, 11);
+    core_LoadProgramCPU(cpu, rom);
+    core_RunCPUUnthrottled(cpu, START_CYCLE);
+
+    Movie *movie = NULL;
+    if (with_movie)
+    {
+        movie = core_CreateMovieRecorder(MOVIE_FILE, cpu);
+        CHECK(movie != NULL);
+        CHECK(core_SetMovieCPU(cpu, movie));
+    }
+
+    // Odd slice lengths so key changes land between timer ticks and mid-FX0A waits.
+    uint32_t lcg = 1;
+    for (int slice = 0; slice < SLICE_COUNT; slice++)
+    {
+        lcg = lcg * 1103515245 + 12345;
+        if (with_movie)
+            core_SetKeysCPU(cpu, (lcg >> 8) % 4 == 0 ? 1u << ((lcg >> 16) % 16) : 0);
+        core_RunCPUUnthrottled(cpu, 97 + (lcg >> 20) % 3000);
+    }
+
+    if (with_movie)
+    {
+        core_SetMovieCPU(cpu, NULL);
+        core_DestroyMovie(movie);
+    }
+
+    size_t size = core_SaveState(cpu, recorded, sizeof(recorded));
+    core_DestroyCPU(cpu);
+    return size;
+}
+
+// Replays MOVIE_FILE the way ch8-replay does and compares the result with 'recorded'.
+void TestReplay(const char *rom, size_t recorded_size, CPUExecMode mode)
+{
+    Movie *movie = core_OpenMovie(MOVIE_FILE);
+    CHECK(movie != NULL);
+    if (movie == NULL)
+        return;
+    CHECK(movie->header.start_cycle == START_CYCLE);
+
+    CPUState *cpu = CreateTestCPU(movie->header.machine, mode, movie->header.seed);
+    if (cpu == NULL)
+    {
+        core_DestroyMovie(movie);
+        return;
+    }
+    printf("replay: machine %d, %s\n", movie->header.machine, test_mode_names[mode]);
+
+    core_LoadProgramCPU(cpu, rom);
+    core_RunCPUUnthrottled(cpu, movie->header.start_cycle);
+    CHECK(core_SetMovieCPU(cpu, movie));
+    core_RunCPUUnthrottled(cpu, movie->end_cycle - movie->header.start_cycle);
+    core_SetMovieCPU(cpu, NULL);
+
+    CHECK(core_SaveState(cpu, replayed, sizeof(replayed)) == recorded_size);
+    CHECK(memcmp(recorded, replayed, recorded_size) == 0);
+
+    core_DestroyCPU(cpu);
+    core_DestroyMovie(movie);
+}
+
+// A replay must refuse a CPU that didn't start where the recording did.
+void TestMismatch(const char *rom)
+{
+    Movie *movie = core_OpenMovie(MOVIE_FILE);
+    CPUState *cpu = CreateTestCPU(movie->header.machine, CPU_EXEC_INTERPRETER, movie->header.seed + 1);
+    core_LoadProgramCPU(cpu, rom);
+    core_RunCPUUnthrottled(cpu, movie->header.start_cycle);
+    CHECK(!core_SetMovieCPU(cpu, movie));
+    CHECK(cpu->movie == NULL);
+
+    core_DestroyCPU(cpu);
+    core_DestroyMovie(movie);
+}
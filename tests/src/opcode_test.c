@@ -0,0 +1,253 @@
+#include <string.h>
+
+#include <core/cpu.h>
+
+#include "test.h"
+
+#define SPRITE_ADDRESS (0x300)
+// Enough for every program below to reach its final self-jump.
+#define PROGRAM_CYCLES (64)
+
+static void WriteWords(CPUState *cpu, uint16_t address, const uint16_t *words, size_t count);
+static void RunProgram(CPUState *cpu, const uint16_t *program, size_t count);
+static void TestScroll(CPUMachine machine, CPUExecMode mode);
+static void TestLargeSprite(CPUMachine machine, CPUExecMode mode);
+static void TestLongIndex(CPUExecMode mode);
+static void TestPlanes(CPUExecMode mode);
+static void TestAudioPattern(CPUExecMode mode);
+static void TestStackFaults(CPUExecMode mode);
+
+#define RUN_PROGRAM(cpu, ...)                                           \
+    do                                                                  \
+    {                                                                   \
+        const uint16_t program[] = {__VA_ARGS__};                       \
+        RunProgram(cpu, program, sizeof(program) / sizeof(program[0])); \
+    } while (0)
+
+// The SUPER-CHIP and XO-CHIP instructions, run as small programs in every execution mode.
+// Both SUPER-CHIP features (scrolling, hires, DXY0) are checked on either machine, as they
+// differ in how sprites meet the edges.
+int main()
+{
+    for (CPUExecMode mode = CPU_EXEC_INTERPRETER; mode <= CPU_EXEC_THREADED; mode++)
+    {
+        for (CPUMachine machine = CPU_MACHINE_CHIP8; machine < CPU_MACHINE_COUNT; machine++)
+        {
+            TestScroll(machine, mode);
+            TestLargeSprite(machine, mode);
+        }
+        TestLongIndex(mode);
+        TestPlanes(mode);
+        TestAudioPattern(mode);
+        TestStackFaults(mode);
+    }
+
+    return TEST_RESULT();
+}
+
+// Writes 'words' big-endian at 'address', as instructions are stored.
+void WriteWords(CPUState *cpu, uint16_t address, const uint16_t *words, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        cpu->memory[address + 2 * i] = words[i] >> 8;
+        cpu->memory[address + 2 * i + 1] = words[i] & 0xFF;
+    }
+    core_InvalidateDecodedCPU(cpu, address, 2 * count);
+}
+
+// Runs 'program' from CH8_PROGRAM_START_ADDRESS, followed by a jump to itself.
+void RunProgram(CPUState *cpu, const uint16_t *program, size_t count)
+{
+    uint16_t end = CH8_PROGRAM_START_ADDRESS + 2 * count;
+    uint16_t loop = 0x1000 | end;
+    WriteWords(cpu, CH8_PROGRAM_START_ADDRESS, program, count);
+    WriteWords(cpu, end, &loop, 1);
+    cpu->program_counter = CH8_PROGRAM_START_ADDRESS;
+    core_RunCPUUnthrottled(cpu, PROGRAM_CYCLES);
+    CHECK(cpu->program_counter == end);
+}
+
+// 00CN, 00FB and 00FC in lores and hires, where scrolling right carries into the second word.
+void TestScroll(CPUMachine machine, CPUExecMode mode)
+{
+    CPUState *cpu = CreateTestCPU(machine, mode, 1);
+    if (cpu == NULL)
+        return;
+    printf("scroll: machine %d, %s\n", machine, test_mode_names[mode]);
+    cpu->memory[SPRITE_ADDRESS] = 0xFF;
+
+    // One 8 pixel row at (0, 0), scrolled down 3 and right 4.
+    RUN_PROGRAM(cpu, 0xA300, 0x6000, 0x6100, 0xD011, 0x00C3, 0x00FB);
+    uint64_t (*rows)[CH8_DISPLAY_HIRES_HEIGHT] = cpu->display.planes[0];
+    CHECK(rows[0][0] == 0);
+    CHECK(rows[0][3] == 0x0FF0000000000000ULL);
+    RUN_PROGRAM(cpu, 0x00FC, 0x00FC);
+    CHECK(rows[0][3] == 0xF000000000000000ULL);
+
+    // Hires: a row at x = 60 straddles both words and moves wholly into the second.
+    RUN_PROGRAM(cpu, 0x00FF, 0xA300, 0x603C, 0x6100, 0xD011);
+    CHECK(cpu->display.hires);
+    CHECK(rows[0][0] == 0x0FULL && rows[1][0] == 0xF000000000000000ULL);
+    RUN_PROGRAM(cpu, 0x00FB, 0x00CF, 0x00C2);
+    CHECK(rows[0][17] == 0 && rows[1][17] == 0xFF00000000000000ULL);
+    CHECK(rows[1][0] == 0);
+
+    // 00FE goes back to lores, clearing the screen.
+    RUN_PROGRAM(cpu, 0x00FE);
+    CHECK(!cpu->display.hires);
+    CHECK(rows[1][17] == 0);
+
+    core_DestroyCPU(cpu);
+}
+
+// DXY0 in hires at the bottom right corner: clipped by SUPER-CHIP, wrapped by XO-CHIP.
+void TestLargeSprite(CPUMachine machine, CPUExecMode mode)
+{
+    CPUState *cpu = CreateTestCPU(machine, mode, 1);
+    if (cpu == NULL)
+        return;
+    printf("large sprite: machine %d, %s\n", machine, test_mode_names[mode]);
+    memset(cpu->memory + SPRITE_ADDRESS, 0xFF, 32);
+
+    RUN_PROGRAM(cpu, 0x00FF, 0xA300, 0x607C, 0x613C, 0xD010);
+    uint64_t (*rows)[CH8_DISPLAY_HIRES_HEIGHT] = cpu->display.planes[0];
+    CHECK(cpu->variable_registers[0xF] == 0);
+    // Pixels 124 to 127 of rows 60 to 63.
+    CHECK(rows[1][60] == 0x0FULL && rows[1][63] == 0x0FULL);
+    CHECK(rows[1][59] == 0);
+    if (machine == CPU_MACHINE_XOCHIP)
+    {
+        // The rest wraps to pixels 0 to 11 and rows 0 to 11.
+        CHECK(rows[0][60] == 0xFFF0000000000000ULL && rows[0][63] == 0xFFF0000000000000ULL);
+        CHECK(rows[0][0] == 0xFFF0000000000000ULL && rows[1][0] == 0x0FULL);
+        CHECK(rows[0][11] == 0xFFF0000000000000ULL && rows[0][12] == 0);
+    }
+    else
+    {
+        CHECK(rows[0][60] == 0 && rows[0][0] == 0 && rows[1][0] == 0);
+    }
+
+    // Drawing it again erases it and reports the collision.
+    RUN_PROGRAM(cpu, 0xD010);
+    CHECK(cpu->variable_registers[0xF] == 1);
+    CHECK(rows[1][60] == 0 && rows[0][0] == 0);
+
+    core_DestroyCPU(cpu);
+}
+
+// F000 NNNN reaching past 4 KiB, skips stepping over all four bytes of it, and the PC wrapping
+// when F000 NNNN ends at the top of memory.
+void TestLongIndex(CPUExecMode mode)
+{
+    CPUState *cpu = CreateTestCPU(CPU_MACHINE_XOCHIP, mode, 1);
+    if (cpu == NULL)
+        return;
+    printf("long index: %s\n", test_mode_names[mode]);
+    cpu->memory[0xE000] = 0x42;
+
+    RUN_PROGRAM(cpu, 0xF000, 0xE000, 0xF065);
+    CHECK(cpu->index_register == 0xE000);
+    CHECK(cpu->variable_registers[0] == 0x42);
+
+    // 3XNN skips F000 NNNN whole, and 6107 runs next.
+    RUN_PROGRAM(cpu, 0x6005, 0x3005, 0xF000, 0x1234, 0x6107);
+    CHECK(cpu->index_register == 0xE000);
+    CHECK(cpu->variable_registers[1] == 0x07);
+
+    // F000 NNNN in the last four bytes leaves the PC at 0, here a jump to itself. No jump
+    // reaches that high, so start there directly.
+    const uint16_t top[] = {0xF000, 0xBEEF};
+    const uint16_t loop = 0x1000;
+    WriteWords(cpu, 0xFFFC, top, 2);
+    WriteWords(cpu, 0x0000, &loop, 1);
+    cpu->program_counter = 0xFFFC;
+    core_RunCPUUnthrottled(cpu, PROGRAM_CYCLES);
+    CHECK(cpu->index_register == 0xBEEF);
+    CHECK(cpu->program_counter == 0);
+
+    core_DestroyCPU(cpu);
+}
+
+// FN01 draws each selected plane from consecutive sprite rows, and limits clearing to them.
+void TestPlanes(CPUExecMode mode)
+{
+    CPUState *cpu = CreateTestCPU(CPU_MACHINE_XOCHIP, mode, 1);
+    if (cpu == NULL)
+        return;
+    printf("planes: %s\n", test_mode_names[mode]);
+    cpu->memory[SPRITE_ADDRESS] = 0xF0;
+    cpu->memory[SPRITE_ADDRESS + 1] = 0x0F;
+
+    // Both planes, one row each, at x = 60 so the row wraps around the right edge.
+    RUN_PROGRAM(cpu, 0xF301, 0xA300, 0x603C, 0x6100, 0xD011);
+    uint64_t (*plane0)[CH8_DISPLAY_HIRES_HEIGHT] = cpu->display.planes[0];
+    uint64_t (*plane1)[CH8_DISPLAY_HIRES_HEIGHT] = cpu->display.planes[1];
+    CHECK(cpu->display.selected_planes == 3 && cpu->display.plane_mask == 3);
+    CHECK(plane0[0][0] == 0x0FULL);
+    CHECK(plane1[0][0] == 0xF000000000000000ULL);
+    CHECK(cpu->variable_registers[0xF] == 0);
+
+    // Plane 0 alone erases its half and collides; plane 1 is untouched.
+    RUN_PROGRAM(cpu, 0xF101, 0xD011);
+    CHECK(plane0[0][0] == 0);
+    CHECK(plane1[0][0] == 0xF000000000000000ULL);
+    CHECK(cpu->variable_registers[0xF] == 1);
+
+    // Scrolling and clearing only affect plane 1 when it alone is selected.
+    RUN_PROGRAM(cpu, 0xD011, 0xF201, 0x00C1);
+    CHECK(plane0[0][0] == 0x0FULL);
+    CHECK(plane1[0][0] == 0 && plane1[0][1] == 0xF000000000000000ULL);
+    RUN_PROGRAM(cpu, 0x00E0);
+    CHECK(plane0[0][0] == 0x0FULL && plane1[0][1] == 0);
+
+    core_DestroyCPU(cpu);
+}
+
+// F002 loads the 16-byte audio pattern at I, and FX3A sets its pitch.
+void TestAudioPattern(CPUExecMode mode)
+{
+    CPUState *cpu = CreateTestCPU(CPU_MACHINE_XOCHIP, mode, 1);
+    if (cpu == NULL)
+        return;
+    printf("audio pattern: %s\n", test_mode_names[mode]);
+    for (size_t i = 0; i < CH8_AUDIO_PATTERN_SIZE; i++)
+        cpu->memory[0x8000 + i] = 0x11 * i;
+
+    RUN_PROGRAM(cpu, 0xF000, 0x8000, 0xF002, 0x6A70, 0xFA3A);
+    CHECK(memcmp(cpu->audio_pattern, cpu->memory + 0x8000, CH8_AUDIO_PATTERN_SIZE) == 0);
+    CHECK(cpu->audio_pitch == 0x70);
+
+    core_DestroyCPU(cpu);
+}
+
+// A 17th nested call and a return with an empty stack stall on the faulting instruction
+// instead of running past either end of the stack.
+void TestStackFaults(CPUExecMode mode)
+{
+    CPUState *cpu = CreateTestCPU(CPU_MACHINE_CHIP8, mode, 1);
+    if (cpu == NULL)
+        return;
+    printf("stack faults: %s\n", test_mode_names[mode]);
+
+    // 0x200 calls itself forever. 6107 is never reached.
+    const uint16_t recursion[] = {0x2200, 0x6107};
+    WriteWords(cpu, CH8_PROGRAM_START_ADDRESS, recursion, 2);
+    core_RunCPUUnthrottled(cpu, PROGRAM_CYCLES);
+    CHECK(cpu->stack_fault);
+    CHECK(cpu->program_counter == CH8_PROGRAM_START_ADDRESS);
+    CHECK(cpu->stack_pointer == cpu->stack + CH8_STACK_DEPTH);
+    CHECK(cpu->stack[CH8_STACK_DEPTH - 1] == CH8_PROGRAM_START_ADDRESS + 2);
+    CHECK(cpu->variable_registers[1] == 0);
+    core_DestroyCPU(cpu);
+
+    cpu = CreateTestCPU(CPU_MACHINE_CHIP8, mode, 1);
+    const uint16_t underflow[] = {0x00EE, 0x6107};
+    WriteWords(cpu, CH8_PROGRAM_START_ADDRESS, underflow, 2);
+    core_RunCPUUnthrottled(cpu, PROGRAM_CYCLES);
+    CHECK(cpu->stack_fault);
+    CHECK(cpu->program_counter == CH8_PROGRAM_START_ADDRESS);
+    CHECK(cpu->stack_pointer == cpu->stack);
+    CHECK(cpu->variable_registers[1] == 0);
+    core_DestroyCPU(cpu);
+}
@@ -0,0 +1,123 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <core/cpu.h>
+#include <core/rewind.h>
+#include <core/state.h>
+
+#include "test.h"
+
+#define FRAME_COUNT (130)
+#define KEYFRAME_INTERVAL (16)
+
+static uint8_t current[CH8_STATE_SIZE];
+
+static void TestRewind(const char *rom, CPUMachine machine);
+static void TestFailedRewind(CPUMachine machine);
+static bool MatchesState(CPUState *cpu, const uint8_t *state, size_t size);
+
+// Rewinding must restore every recorded frame exactly, whether it is a keyframe or a delta,
+// and on XO-CHIP where a state is larger than 64 KiB.
+int main()
+{
+    const char *roms[] = {TEST_ROM("3-corax+.ch8"), TEST_ROM("5-quirks.ch8"), TEST_ROM("8-scrolling.ch8")};
+
+    for (size_t i = 0; i < sizeof(roms) / sizeof(roms[0]); i++)
+    {
+        TestRewind(roms[i], CPU_MACHINE_CHIP8);
+        TestRewind(roms[i], CPU_MACHINE_XOCHIP);
+    }
+    TestFailedRewind(CPU_MACHINE_CHIP8);
+    TestFailedRewind(CPU_MACHINE_XOCHIP);
+
+    return TEST_RESULT();
+}
+
+void TestRewind(const char *rom, CPUMachine machine)
+{
+    printf("rewind: %s, machine %d\n", rom, machine);
+    CPUState *cpu = CreateTestCPU(machine, CPU_EXEC_INTERPRETER, 3);
+    core_LoadProgramCPU(cpu, rom);
+    RewindBuffer *rewind = core_CreateRewindBuffer(CH8_REWIND_DEFAULT_BUFFER_SIZE, FRAME_COUNT, KEYFRAME_INTERVAL);
+
+    size_t state_size = CH8_STATE_SIZE_FOR_MEMORY(cpu->memory_size);
+    uint8_t *frames = malloc(FRAME_COUNT * state_size);
+    for (size_t frame = 0; frame < FRAME_COUNT; frame++)
+    {
+        // Touch the last byte of memory so XO-CHIP deltas run past 64 KiB.
+        cpu->memory[cpu->memory_size - 1] ^= frame;
+        core_InvalidateDecodedCPU(cpu, cpu->memory_size - 1, 1);
+        core_RunCPUUnthrottled(cpu, cpu->cycles_per_timer_tick);
+
+        core_PushRewindFrame(rewind, cpu);
+        CHECK(core_SaveState(cpu, frames + frame * state_size, state_size) == state_size);
+    }
+    CHECK(core_GetRewindFrameCount(rewind) == FRAME_COUNT);
+
+    // Newest frame, then a delta just past a keyframe, then a keyframe.
+    CHECK(core_RewindCPU(rewind, cpu, 0));
+    CHECK(MatchesState(cpu, frames + (FRAME_COUNT - 1) * state_size, state_size));
+    CHECK(core_RewindCPU(rewind, cpu, 10));
+    CHECK(MatchesState(cpu, frames + (FRAME_COUNT - 11) * state_size, state_size));
+    CHECK(core_GetRewindFrameCount(rewind) == FRAME_COUNT - 10);
+    CHECK(core_RewindCPU(rewind, cpu, 7));
+    CHECK(MatchesState(cpu, frames + (FRAME_COUNT - 18) * state_size, state_size));
+
+    // A restored CPU runs on exactly as it did the first time.
+    cpu->memory[cpu->memory_size - 1] ^= FRAME_COUNT - 17;
+    core_InvalidateDecodedCPU(cpu, cpu->memory_size - 1, 1);
+    core_RunCPUUnthrottled(cpu, cpu->cycles_per_timer_tick);
+    CHECK(MatchesState(cpu, frames + (FRAME_COUNT - 17) * state_size, state_size));
+
+    // Distances past the oldest frame are clamped to it.
+    CHECK(core_RewindCPU(rewind, cpu, 10 * FRAME_COUNT));
+    CHECK(MatchesState(cpu, frames, state_size));
+    CHECK(core_GetRewindFrameCount(rewind) == 1);
+
+    free(frames);
+    core_DestroyRewindBuffer(rewind);
+    core_DestroyCPU(cpu);
+}
+
+// A rewind to a frame that can't be loaded must leave both the CPU and the recording as they
+// were, so later frames are still encoded against the right keyframe.
+void TestFailedRewind(CPUMachine machine)
+{
+    printf("failed rewind: machine %d\n", machine);
+    CPUState *cpu = CreateTestCPU(machine, CPU_EXEC_INTERPRETER, 3);
+    core_LoadProgramCPU(cpu, TEST_ROM("3-corax+.ch8"));
+    RewindBuffer *rewind = core_CreateRewindBuffer(CH8_REWIND_DEFAULT_BUFFER_SIZE, FRAME_COUNT, KEYFRAME_INTERVAL);
+
+    for (size_t frame = 0; frame < 2 * KEYFRAME_INTERVAL + 3; frame++)
+    {
+        core_RunCPUUnthrottled(cpu, cpu->cycles_per_timer_tick);
+        core_PushRewindFrame(rewind, cpu);
+    }
+
+    // The oldest keyframe starts with a run covering the magic. Break the magic.
+    const RewindEntry *oldest = &rewind->entries[rewind->first_entry];
+    rewind->data[oldest->offset + 8] ^= 0xFF;
+    size_t count = core_GetRewindFrameCount(rewind);
+    uint8_t *before = malloc(CH8_STATE_SIZE);
+    size_t before_size = core_SaveState(cpu, before, CH8_STATE_SIZE);
+    CHECK(!core_RewindCPU(rewind, cpu, count));
+    CHECK(core_GetRewindFrameCount(rewind) == count);
+    CHECK(MatchesState(cpu, before, before_size));
+
+    // Record on, and come back to the newest frame.
+    core_RunCPUUnthrottled(cpu, cpu->cycles_per_timer_tick);
+    core_PushRewindFrame(rewind, cpu);
+    before_size = core_SaveState(cpu, before, CH8_STATE_SIZE);
+    core_RunCPUUnthrottled(cpu, cpu->cycles_per_timer_tick);
+    CHECK(core_RewindCPU(rewind, cpu, 0));
+    CHECK(MatchesState(cpu, before, before_size));
+
+    free(before);
+    core_DestroyRewindBuffer(rewind);
+    core_DestroyCPU(cpu);
+}
+
+bool MatchesState(CPUState *cpu, const uint8_t *state, size_t size)
+{
+    return core_SaveState(cpu, current, sizeof(current)) == size && memcmp(current, state, size) == 0;
+}
@@ -0,0 +1,119 @@
+#include <string.h>
+
+#include <core/cpu.h>
+#include <core/state.h>
+
+#include "test.h"
+
+static uint8_t saved[CH8_STATE_SIZE];
+static uint8_t restored[CH8_STATE_SIZE];
+static uint8_t corrupt[CH8_STATE_SIZE];
+
+static void TestRoundTrip(CPUMachine machine, CPUExecMode mode);
+static void TestRejects(CPUMachine machine);
+static bool RejectsCorrupt(CPUState *cpu, size_t size);
+
+// A saved state loaded into another CPU must run on exactly like the original, and states
+// that would corrupt the CPU must be rejected without touching it.
+int main()
+{
+    for (CPUMachine machine = CPU_MACHINE_CHIP8; machine < CPU_MACHINE_COUNT; machine++)
+    {
+        for (CPUExecMode mode = CPU_EXEC_INTERPRETER; mode <= CPU_EXEC_THREADED; mode++)
+            TestRoundTrip(machine, mode);
+        TestRejects(machine);
+    }
+
+    return TEST_RESULT();
+}
+
+void TestRoundTrip(CPUMachine machine, CPUExecMode mode)
+{
+    CPUState *original = CreateTestCPU(machine, mode, 5);
+    if (original == NULL)
+        return;
+    CPUState *copy = CreateTestCPU(machine, mode, 9);
+    printf("round trip: machine %d, %s\n", machine, test_mode_names[mode]);
+
+    core_LoadProgramCPU(original, TEST_ROM("3-corax+.ch8"));
+    core_RunCPUUnthrottled(original, 123457);
+
+    size_t size = core_SaveState(original, saved, sizeof(saved));
+    CHECK(size == CH8_STATE_SIZE_FOR_MEMORY(original->memory_size));
+    CHECK(core_SaveState(original, saved, size - 1) == 0);
+    CHECK(core_LoadState(copy, saved, size));
+    CHECK(copy->machine == machine);
+
+    // Both must stay in lockstep, including the random generator and timers.
+    core_RunCPUUnthrottled(original, 50000);
+    core_RunCPUUnthrottled(copy, 50000);
+    size = core_SaveState(original, saved, sizeof(saved));
+    CHECK(core_SaveState(copy, restored, sizeof(restored)) == size);
+    CHECK(memcmp(saved, restored, size) == 0);
+    CHECK(memcmp(original->display.planes, copy->display.planes, sizeof(original->display.planes)) == 0);
+
+    core_DestroyCPU(copy);
+    core_DestroyCPU(original);
+}
+
+void TestRejects(CPUMachine machine)
+{
+    CPUState *cpu = CreateTestCPU(machine, CPU_EXEC_INTERPRETER, 5);
+    printf("rejects: machine %d\n", machine);
+    core_LoadProgramCPU(cpu, TEST_ROM("3-corax+.ch8"));
+    core_RunCPUUnthrottled(cpu, 5000);
+
+    size_t size = core_SaveState(cpu, saved, sizeof(saved));
+    size_t memory_offset = 4 + 2 + 1;
+    size_t stack_depth_offset = memory_offset + cpu->memory_size + CH8_VREG_COUNT + 2 + 2 + CH8_STACK_DEPTH * 2;
+    size_t clock_offset = stack_depth_offset + 1 + 1 + 1 + 4;
+
+    memcpy(corrupt, saved, size);
+    corrupt[0] = 'X';
+    CHECK(RejectsCorrupt(cpu, size));
+
+    memcpy(corrupt, saved, size);
+    corrupt[4] = CH8_STATE_VERSION + 1;
+    CHECK(RejectsCorrupt(cpu, size));
+
+    memcpy(corrupt, saved, size);
+    corrupt[6] = CPU_MACHINE_COUNT;
+    CHECK(RejectsCorrupt(cpu, size));
+
+    memcpy(corrupt, saved, size);
+    CHECK(RejectsCorrupt(cpu, size - 1));
+
+    memcpy(corrupt, saved, size);
+    corrupt[stack_depth_offset] = CH8_STACK_DEPTH + 1;
+    CHECK(RejectsCorrupt(cpu, size));
+
+    // Clock frequency of 0.
+    memcpy(corrupt, saved, size);
+    memset(corrupt + clock_offset - 4, 0, 4);
+    CHECK(RejectsCorrupt(cpu, size));
+
+    // Cycles per timer tick of 0.
+    memcpy(corrupt, saved, size);
+    memset(corrupt + clock_offset, 0, 8);
+    CHECK(RejectsCorrupt(cpu, size));
+
+    // Next timer tick at the current cycle.
+    memcpy(corrupt, saved, size);
+    memcpy(corrupt + clock_offset + 16, corrupt + clock_offset + 8, 8);
+    CHECK(RejectsCorrupt(cpu, size));
+
+    CHECK(core_LoadState(cpu, saved, size));
+    core_DestroyCPU(cpu);
+}
+
+// Loads 'corrupt' and checks it was rejected without changing 'cpu'.
+bool RejectsCorrupt(CPUState *cpu, size_t size)
+{
+    size_t before_size = core_SaveState(cpu, restored, sizeof(restored));
+    if (core_LoadState(cpu, corrupt, size))
+        return false;
+
+    static uint8_t after[CH8_STATE_SIZE];
+    size_t after_size = core_SaveState(cpu, after, sizeof(after));
+    return after_size == before_size && memcmp(restored, after, after_size) == 0;
+}
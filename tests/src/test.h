@@ -0,0 +1,46 @@
+#ifndef TESTS_TEST_H
+#define TESTS_TEST_H
+
+#include <stdio.h>
+
+#include <core/cpu.h>
+
+#define TEST_ROM(name) CH8_EXAMPLE_ROMS_DIR "test_suite/" name
+
+// Failed checks are reported and counted, and the test goes on so one run shows every failure.
+static int test_failures = 0;
+
+#define CHECK(condition)                                                                 \
+    do                                                                                   \
+    {                                                                                    \
+        if (!(condition))                                                                \
+        {                                                                                \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            test_failures++;                                                             \
+        }                                                                                \
+    } while (0)
+
+// Exit code of a test: 0 if every check passed.
+#define TEST_RESULT() (test_failures == 0 ? 0 : 1)
+
+static const char *const test_mode_names[] = {
+    [CPU_EXEC_INTERPRETER] = "interpreter",
+    [CPU_EXEC_JIT] = "jit",
+    [CPU_EXEC_THREADED] = "threaded",
+};
+
+// Creates a headless CPU for 'machine' in 'mode'. NULL if the mode isn't available here, such
+// as the JIT on a non-x86-64 host.
+static inline CPUState *CreateTestCPU(CPUMachine machine, CPUExecMode mode, uint64_t seed)
+{
+    CPUState *cpu = core_CreateHeadlessCPU(700, seed);
+    if (!core_SetExecModeCPU(cpu, mode))
+    {
+        core_DestroyCPU(cpu);
+        return NULL;
+    }
+    core_SetMachineCPU(cpu, machine);
+    return cpu;
+}
+
+#endif
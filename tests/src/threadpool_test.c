@@ -0,0 +1,47 @@
+#include <stdatomic.h>
+
+#include <threading/threadpool.h>
+
+#include "test.h"
+
+#define ROUND_COUNT (100)
+#define SPAWN_COUNT (2000)
+
+static ThreadPool *pool;
+static atomic_int spawns_left;
+static atomic_int jobs_finished;
+
+static void SpawningTask(void *argument);
+
+// WaitThreadPool must cover jobs submitted by jobs, even when other workers steal and finish
+// them before their submitter returns.
+int main()
+{
+    for (int round = 0; round < ROUND_COUNT; round++)
+    {
+        pool = CreateThreadPool(8);
+        atomic_store(&spawns_left, SPAWN_COUNT);
+        atomic_store(&jobs_finished, 0);
+
+        SubmitThreadPool(pool, SpawningTask, NULL);
+        WaitThreadPool(pool);
+        // Each spawn adds two jobs to the first.
+        CHECK(atomic_load(&jobs_finished) == 2 * SPAWN_COUNT + 1);
+        CHECK(pool->queued == 0 && pool->pending == 0);
+
+        DestroyThreadPool(pool);
+    }
+
+    return TEST_RESULT();
+}
+
+void SpawningTask(void *argument)
+{
+    (void)argument;
+    if (atomic_fetch_sub(&spawns_left, 1) > 0)
+    {
+        SubmitThreadPool(pool, SpawningTask, NULL);
+        SubmitThreadPool(pool, SpawningTask, NULL);
+    }
+    atomic_fetch_add(&jobs_finished, 1);
+}
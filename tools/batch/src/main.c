@@ -0,0 +1,185 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <core/cpu.h>
+#include <core/movie.h>
+
+#include <threading/threadpool.h>
+#include <timing/timing.h>
+
+#define BATCH_DEFAULT_CYCLES (10000000)
+#define BATCH_DEFAULT_SLICE (1000000)
+#define BATCH_CLOCK_FREQUENCY (700)
+
+typedef struct BatchOptions
+{
+    uint64_t n_cycles;
+    // Cycles run per job. Instances resubmit themselves after every slice, so idle
+    // workers can steal the remainder of long runs.
+    uint64_t slice_cycles;
+    size_t copies;
+    uint64_t seed;
+    size_t n_threads;
+    CPUExecMode mode;
+} BatchOptions;
+
+typedef struct BatchInstance
+{
+    ThreadPool *pool;
+    const BatchOptions *options;
+    const char *rom;
+    uint64_t seed;
+    CPUState *cpu;
+    double wall_time;
+    uint64_t framebuffer_hash;
+    uint64_t cycles;
+    // The ROM over- or underflowed the stack. It stalls from there, so the run ends early.
+    bool stack_fault;
+} BatchInstance;
+
+static void PrintUsage();
+static bool ParseOptions(int argc, char **argv, BatchOptions *options, int *first_rom);
+static void RunInstanceSlice(void *argument);
+
+int main(int argc, char **argv)
+{
+    BatchOptions options;
+    int first_rom;
+    if (!ParseOptions(argc, argv, &options, &first_rom) || first_rom == argc)
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    size_t n_roms = argc - first_rom;
+    size_t n_instances = n_roms * options.copies;
+    BatchInstance *instances = calloc(n_instances, sizeof(BatchInstance));
+
+    ThreadPool *pool = CreateThreadPool(options.n_threads);
+    double start_time = GetMonotonicTime();
+    for (size_t i = 0; i < n_instances; i++)
+    {
+        BatchInstance *instance = &instances[i];
+        instance->pool = pool;
+        instance->options = &options;
+        instance->rom = argv[first_rom + i / options.copies];
+        instance->seed = options.seed + i;
+        SubmitThreadPool(pool, RunInstanceSlice, instance);
+    }
+    WaitThreadPool(pool);
+    double wall_time = GetMonotonicTime() - start_time;
+
+    uint64_t total_cycles = 0;
+    double total_instance_time = 0;
+    printf("%-5s %-28s %10s %12s %10s %18s\n", "#", "rom", "seed", "cycles", "wall(s)", "framebuffer");
+    for (size_t i = 0; i < n_instances; i++)
+    {
+        const BatchInstance *instance = &instances[i];
+        const char *name = strrchr(instance->rom, '/');
+        printf("%-5zu %-28s %10llu %12llu %10.3f  %016llx%s\n", i, name ? name + 1 : instance->rom, (unsigned long long)instance->seed,
+               (unsigned long long)instance->cycles, instance->wall_time,
+               (unsigned long long)instance->framebuffer_hash, instance->stack_fault ? "  stack fault" : "");
+        total_cycles += instance->cycles;
+        total_instance_time += instance->wall_time;
+    }
+
+    printf("\n%zu instances on %zu threads in %.3f s. %.1f Mips aggregate. Parallel speedup %.2fx.\n",
+           n_instances, pool->count, wall_time, total_cycles / wall_time / 1e6, total_instance_time / wall_time);
+
+    DestroyThreadPool(pool);
+    free(instances);
+    return 0;
+}
+
+void PrintUsage()
+{
+    fprintf(stderr,
+            "usage: ch8-batch [options] <rom>...\n"
+            "  --cycles N     cycles per instance (default %d)\n"
+            "  --copies K     instances per ROM, each with its own seed (default 1)\n"
+            "  --seed S       seed of the first instance; instance i gets S + i (default 1)\n"
+            "  --threads T    worker threads, 0 for one per CPU (default 0)\n"
+            "  --slice N      cycles per scheduled job (default %d)\n"
+            "  --mode M       interpreter, threaded or jit (default interpreter)\n",
+            BATCH_DEFAULT_CYCLES, BATCH_DEFAULT_SLICE);
+}
+
+bool ParseOptions(int argc, char **argv, BatchOptions *options, int *first_rom)
+{
+    options->n_cycles = BATCH_DEFAULT_CYCLES;
+    options->slice_cycles = BATCH_DEFAULT_SLICE;
+    options->copies = 1;
+    options->seed = 1;
+    options->n_threads = 0;
+    options->mode = CPU_EXEC_INTERPRETER;
+
+    int i = 1;
+    for (; i < argc && strncmp(argv[i], "--", 2) == 0; i += 2)
+    {
+        if (i + 1 >= argc)
+            return false;
+
+        const char *value = argv[i + 1];
+        if (strcmp(argv[i], "--cycles") == 0)
+            options->n_cycles = strtoull(value, NULL, 0);
+        else if (strcmp(argv[i], "--copies") == 0)
+            options->copies = strtoul(value, NULL, 0);
+        else if (strcmp(argv[i], "--seed") == 0)
+            options->seed = strtoull(value, NULL, 0);
+        else if (strcmp(argv[i], "--threads") == 0)
+            options->n_threads = strtoul(value, NULL, 0);
+        else if (strcmp(argv[i], "--slice") == 0)
+            options->slice_cycles = strtoull(value, NULL, 0);
+        else if (strcmp(argv[i], "--mode") == 0)
+        {
+            if (strcmp(value, "interpreter") == 0)
+                options->mode = CPU_EXEC_INTERPRETER;
+            else if (strcmp(value, "threaded") == 0)
+                options->mode = CPU_EXEC_THREADED;
+            else if (strcmp(value, "jit") == 0)
+                options->mode = CPU_EXEC_JIT;
+            else
+                return false;
+        }
+        else
+            return false;
+    }
+
+    *first_rom = i;
+    return options->copies > 0 && options->slice_cycles > 0;
+}
+
+void RunInstanceSlice(void *argument)
+{
+    BatchInstance *instance = argument;
+    double start_time = GetMonotonicTime();
+
+    if (instance->cpu == NULL)
+    {
+        instance->cpu = core_CreateHeadlessCPU(BATCH_CLOCK_FREQUENCY, instance->seed);
+        core_SetExecModeCPU(instance->cpu, instance->options->mode);
+        core_SetMachineCPU(instance->cpu, core_GetMachineForROM(instance->rom));
+        core_LoadProgramCPU(instance->cpu, instance->rom);
+    }
+
+    uint64_t remaining = instance->options->n_cycles - instance->cycles;
+    uint64_t n_cycles = remaining < instance->options->slice_cycles ? remaining : instance->options->slice_cycles;
+    instance->cycles += core_RunCPUUnthrottled(instance->cpu, n_cycles);
+
+    instance->stack_fault = instance->cpu->stack_fault;
+    bool finished = instance->cycles == instance->options->n_cycles || instance->stack_fault;
+    if (finished)
+    {
+        instance->framebuffer_hash = core_HashDisplayCPU(instance->cpu);
+        core_DestroyCPU(instance->cpu);
+        instance->cpu = NULL;
+    }
+
+    instance->wall_time += GetMonotonicTime() - start_time;
+
+    if (!finished)
+    {
+        SubmitThreadPool(instance->pool, RunInstanceSlice, instance);
+    }
+}
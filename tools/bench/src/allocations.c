@@ -0,0 +1,97 @@
+#include <stdatomic.h>
+#include <stddef.h>
+#include <errno.h>
+
+#include "allocations.h"
+
+static _Atomic uint64_t allocations;
+static _Atomic uint64_t frees;
+static _Atomic uint64_t bytes;
+
+static void CountAllocation(void *ptr, size_t size);
+
+#ifdef __GLIBC__
+
+// Definitions in the executable take precedence over libc's for every shared object,
+// including core, so the CPU's own heap use is counted. glibc exports its allocator
+// under these names, which lets us forward without dlsym (which itself calls calloc).
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void *__libc_memalign(size_t alignment, size_t size);
+extern void __libc_free(void *ptr);
+
+void *malloc(size_t size)
+{
+    void *ptr = __libc_malloc(size);
+    CountAllocation(ptr, size);
+    return ptr;
+}
+
+void *calloc(size_t n, size_t size)
+{
+    void *ptr = __libc_calloc(n, size);
+    CountAllocation(ptr, n * size);
+    return ptr;
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    void *new_ptr = __libc_realloc(ptr, size);
+    CountAllocation(new_ptr, size);
+    return new_ptr;
+}
+
+void *aligned_alloc(size_t alignment, size_t size)
+{
+    void *ptr = __libc_memalign(alignment, size);
+    CountAllocation(ptr, size);
+    return ptr;
+}
+
+int posix_memalign(void **ptr, size_t alignment, size_t size)
+{
+    if (alignment % sizeof(void *) != 0 || (alignment & (alignment - 1)) != 0)
+        return EINVAL;
+
+    *ptr = __libc_memalign(alignment, size);
+    CountAllocation(*ptr, size);
+    return *ptr != NULL || size == 0 ? 0 : ENOMEM;
+}
+
+void free(void *ptr)
+{
+    if (ptr != NULL)
+        atomic_fetch_add_explicit(&frees, 1, memory_order_relaxed);
+    __libc_free(ptr);
+}
+
+bool AllocationCountingSupported()
+{
+    return true;
+}
+
+#else
+
+bool AllocationCountingSupported()
+{
+    return false;
+}
+
+#endif
+
+void GetAllocationCounts(AllocationCounts *counts)
+{
+    counts->allocations = atomic_load_explicit(&allocations, memory_order_relaxed);
+    counts->frees = atomic_load_explicit(&frees, memory_order_relaxed);
+    counts->bytes = atomic_load_explicit(&bytes, memory_order_relaxed);
+}
+
+void CountAllocation(void *ptr, size_t size)
+{
+    if (ptr == NULL)
+        return;
+
+    atomic_fetch_add_explicit(&allocations, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&bytes, size, memory_order_relaxed);
+}
@@ -0,0 +1,22 @@
+#ifndef BENCH_ALLOCATIONS_H
+#define BENCH_ALLOCATIONS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct AllocationCounts
+{
+    // malloc, calloc, realloc and aligned allocations.
+    uint64_t allocations;
+    uint64_t frees;
+    uint64_t bytes;
+} AllocationCounts;
+
+/// @brief Whether heap calls are counted in this build.
+/// @details Counting interposes the C allocator and is only implemented for glibc.
+bool AllocationCountingSupported();
+
+/// @brief Reads the heap calls made so far by every thread in the process.
+void GetAllocationCounts(AllocationCounts *counts);
+
+#endif
@@ -0,0 +1,414 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+
+#include <core/cpu.h>
+
+#include <timing/timing.h>
+
+#include "allocations.h"
+
+#ifdef CH8_EXAMPLE_ROMS_DIR
+#define ROMS_BASE_PATH CH8_EXAMPLE_ROMS_DIR
+#else
+#define ROMS_BASE_PATH "../../assets/roms/"
+#endif
+
+#ifndef CH8_BUILD_TYPE
+#define CH8_BUILD_TYPE "unknown"
+#endif
+
+#define TEST_SUITE_ROMS ROMS_BASE_PATH "test_suite/"
+
+#define BENCH_DEFAULT_CYCLES (20000000)
+#define BENCH_DEFAULT_KERNEL_CYCLES (5000000)
+#define BENCH_CLOCK_FREQUENCY (700)
+// Each measurement is the best of this many runs.
+#define BENCH_REPEATS (3)
+
+// Kernel bodies are unrolled to about this many instructions before jumping back.
+#define KERNEL_UNROLL (128)
+#define KERNEL_MAX_SETUP (4)
+#define KERNEL_MAX_BODY (12)
+// Kernels write memory here, well away from their code.
+#define KERNEL_DATA_ADDRESS (0xE00)
+// Placeholders in kernel bodies, patched when the kernel is assembled.
+#define KERNEL_CALL (0x2000)
+#define KERNEL_JUMP_NEXT (0x1000)
+
+typedef struct BenchMode
+{
+    CPUExecMode mode;
+    const char *name;
+} BenchMode;
+
+// A loop exercising one class of opcodes, timed to give its cost per instruction.
+typedef struct OpcodeKernel
+{
+    const char *name;
+    const char *opcodes;
+    // Run once before the loop.
+    uint16_t setup[KERNEL_MAX_SETUP];
+    size_t setup_count;
+    // Repeated up to KERNEL_UNROLL instructions. KERNEL_CALL calls a subroutine that returns
+    // straight away, KERNEL_JUMP_NEXT jumps to the following instruction.
+    uint16_t body[KERNEL_MAX_BODY];
+    size_t body_count;
+} OpcodeKernel;
+
+typedef struct BenchOptions
+{
+    uint64_t n_cycles;
+    uint64_t kernel_cycles;
+    const char *roms_dir;
+    bool json;
+    // Names the build being measured, so runs of different builds can be told apart.
+    const char *label;
+    // Results are written here instead of stdout if set.
+    const char *output;
+} BenchOptions;
+
+typedef struct BenchResult
+{
+    bool available;
+    double seconds;
+    uint64_t cycles;
+    // Heap calls during the timed run only, not CPU creation or ROM loading.
+    AllocationCounts allocations;
+} BenchResult;
+
+static const BenchMode modes[] = {
+    {CPU_EXEC_INTERPRETER, "interpreter"},
+    {CPU_EXEC_THREADED, "threaded"},
+    {CPU_EXEC_JIT, "jit"},
+};
+#define MODES_COUNT (sizeof(modes) / sizeof(modes[0]))
+
+// Conditional skips are set up never to skip, so every instruction in a kernel executes.
+static const OpcodeKernel kernels[] = {
+    {"alu", "6XNN 7XNN 8XY0-8XYE", {0x6000, 0x6103}, 2,
+     {0x6005, 0x7001, 0x8014, 0x8015, 0x8106, 0x8017, 0x810E, 0x8012, 0x8011, 0x8013, 0x8010}, 11},
+    {"skip", "3XNN 4XNN 9XY0 EX9E", {0x6000, 0x6100}, 2,
+     {0x3001, 0x4000, 0x9010, 0xE09E}, 4},
+    {"flow", "1NNN 2NNN 00EE", {0}, 0,
+     {KERNEL_CALL, KERNEL_JUMP_NEXT}, 2},
+    {"index", "ANNN FX1E FX29", {0x6001}, 1,
+     {0xA000 | KERNEL_DATA_ADDRESS, 0xF01E, 0xF029}, 3},
+    {"timer", "FX07 FX15", {0x6000}, 1,
+     {0xF007, 0xF015}, 2},
+    {"random", "CXNN", {0}, 0,
+     {0xC0FF}, 1},
+    {"memory", "FX33 FX55 FX65", {0xA000 | KERNEL_DATA_ADDRESS, 0x6300}, 2,
+     {0xF333, 0xF365, 0xF355}, 3},
+    {"draw", "DXYN", {0xA000 | CH8_FONT_START_ADDRESS, 0x6000, 0x6100}, 3,
+     {0xD015}, 1},
+    {"clear", "00E0", {0}, 0,
+     {0x00E0}, 1},
+};
+#define KERNELS_COUNT (sizeof(kernels) / sizeof(kernels[0]))
+
+static void PrintUsage();
+static bool ParseOptions(int argc, char **argv, BenchOptions *options);
+static int FilterROM(const struct dirent *entry);
+static void LoadKernel(CPUState *cpu, const OpcodeKernel *kernel);
+static void RunBenchmark(const char *rom, const OpcodeKernel *kernel, const BenchMode *mode, uint64_t n_cycles, BenchResult *result);
+static void PrintTableRow(FILE *out, const char *name, const BenchMode *mode, const BenchResult *result);
+static void PrintJSONString(FILE *out, const char *string);
+static void PrintJSONResults(FILE *out, const BenchResult *results);
+static void PrintJSONBuild(FILE *out, const BenchOptions *options);
+
+int main(int argc, char **argv)
+{
+    BenchOptions options;
+    if (!ParseOptions(argc, argv, &options))
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    struct dirent **entries;
+    int n_entries = scandir(options.roms_dir, &entries, FilterROM, alphasort);
+    if (n_entries < 0)
+    {
+        fprintf(stderr, "Failed to open ROM directory %s.\n", options.roms_dir);
+        return 1;
+    }
+
+    FILE *out = stdout;
+    if (options.output != NULL && (out = fopen(options.output, "w")) == NULL)
+    {
+        fprintf(stderr, "Failed to open %s.\n", options.output);
+        return 1;
+    }
+
+    BenchResult *rom_results = calloc((size_t)n_entries * MODES_COUNT, sizeof(BenchResult));
+    BenchResult kernel_results[KERNELS_COUNT * MODES_COUNT];
+    for (int i = 0; i < n_entries; i++)
+    {
+        char path[1024];
+        snprintf(path, sizeof(path), "%s/%s", options.roms_dir, entries[i]->d_name);
+        for (size_t m = 0; m < MODES_COUNT; m++)
+            RunBenchmark(path, NULL, &modes[m], options.n_cycles, &rom_results[i * MODES_COUNT + m]);
+    }
+    for (size_t k = 0; k < KERNELS_COUNT; k++)
+    {
+        for (size_t m = 0; m < MODES_COUNT; m++)
+            RunBenchmark(NULL, &kernels[k], &modes[m], options.kernel_cycles, &kernel_results[k * MODES_COUNT + m]);
+    }
+
+    if (options.json)
+    {
+        fprintf(out, "{\n");
+        PrintJSONBuild(out, &options);
+        fprintf(out, "  \"roms\": [");
+        for (int i = 0; i < n_entries; i++)
+        {
+            fprintf(out, "%s\n    {\"name\": ", i > 0 ? "," : "");
+            PrintJSONString(out, entries[i]->d_name);
+            fprintf(out, ", \"modes\": [");
+            PrintJSONResults(out, &rom_results[i * MODES_COUNT]);
+            fprintf(out, "]}");
+        }
+        fprintf(out, "\n  ],\n  \"opcode_classes\": [");
+        for (size_t k = 0; k < KERNELS_COUNT; k++)
+        {
+            fprintf(out, "%s\n    {\"name\": \"%s\", \"opcodes\": \"%s\", \"modes\": [",
+                    k > 0 ? "," : "", kernels[k].name, kernels[k].opcodes);
+            PrintJSONResults(out, &kernel_results[k * MODES_COUNT]);
+            fprintf(out, "]}");
+        }
+        fprintf(out, "\n  ]\n}\n");
+    }
+    else
+    {
+        fprintf(out, "%-24s %-12s %10s %10s %8s\n", "rom", "mode", "Mips", "ns/instr", "allocs");
+        for (int i = 0; i < n_entries; i++)
+        {
+            for (size_t m = 0; m < MODES_COUNT; m++)
+                PrintTableRow(out, entries[i]->d_name, &modes[m], &rom_results[i * MODES_COUNT + m]);
+        }
+
+        fprintf(out, "\n%-24s %-12s %10s %10s %8s\n", "opcode class", "mode", "Mips", "ns/instr", "allocs");
+        for (size_t k = 0; k < KERNELS_COUNT; k++)
+        {
+            for (size_t m = 0; m < MODES_COUNT; m++)
+                PrintTableRow(out, kernels[k].name, &modes[m], &kernel_results[k * MODES_COUNT + m]);
+        }
+    }
+
+    for (int i = 0; i < n_entries; i++)
+        free(entries[i]);
+    free(entries);
+    free(rom_results);
+    if (out != stdout)
+        fclose(out);
+    return 0;
+}
+
+void PrintUsage()
+{
+    fprintf(stderr,
+            "usage: ch8-bench [options] [rom directory]\n"
+            "  --cycles N         instructions per ROM run (default %d)\n"
+            "  --kernel-cycles N  instructions per opcode class run (default %d)\n"
+            "  --json             print results as JSON\n"
+            "  --label NAME       name of the build being measured, reported in JSON\n"
+            "  --output FILE      write results to FILE instead of stdout\n"
+            "ROMs default to %s.\n",
+            BENCH_DEFAULT_CYCLES, BENCH_DEFAULT_KERNEL_CYCLES, TEST_SUITE_ROMS);
+}
+
+bool ParseOptions(int argc, char **argv, BenchOptions *options)
+{
+    options->n_cycles = BENCH_DEFAULT_CYCLES;
+    options->kernel_cycles = BENCH_DEFAULT_KERNEL_CYCLES;
+    options->roms_dir = TEST_SUITE_ROMS;
+    options->json = false;
+    options->label = "";
+    options->output = NULL;
+
+    int i = 1;
+    for (; i < argc && strncmp(argv[i], "--", 2) == 0; i++)
+    {
+        if (strcmp(argv[i], "--json") == 0)
+        {
+            options->json = true;
+            continue;
+        }
+
+        if (i + 1 >= argc)
+            return false;
+
+        const char *value = argv[++i];
+        if (strcmp(argv[i - 1], "--cycles") == 0)
+            options->n_cycles = strtoull(value, NULL, 0);
+        else if (strcmp(argv[i - 1], "--kernel-cycles") == 0)
+            options->kernel_cycles = strtoull(value, NULL, 0);
+        else if (strcmp(argv[i - 1], "--label") == 0)
+            options->label = value;
+        else if (strcmp(argv[i - 1], "--output") == 0)
+            options->output = value;
+        else
+            return false;
+    }
+
+    if (i < argc)
+        options->roms_dir = argv[i++];
+
+    return i == argc && options->n_cycles > 0 && options->kernel_cycles > 0;
+}
+
+int FilterROM(const struct dirent *entry)
+{
+    const char *extension = strrchr(entry->d_name, '.');
+    return extension != NULL && strcmp(extension, ".ch8") == 0;
+}
+
+void LoadKernel(CPUState *cpu, const OpcodeKernel *kernel)
+{
+    uint16_t code[KERNEL_MAX_SETUP + KERNEL_UNROLL + KERNEL_MAX_BODY + 2];
+    size_t count = 0;
+    for (size_t i = 0; i < kernel->setup_count; i++)
+        code[count++] = kernel->setup[i];
+
+    uint16_t loop_address = CH8_PROGRAM_START_ADDRESS + count * 2;
+    size_t repeats = (KERNEL_UNROLL + kernel->body_count - 1) / kernel->body_count;
+    for (size_t r = 0; r < repeats; r++)
+    {
+        for (size_t i = 0; i < kernel->body_count; i++)
+            code[count++] = kernel->body[i];
+    }
+    code[count++] = 0x1000 | loop_address;
+    // Subroutine for KERNEL_CALL.
+    uint16_t subroutine_address = CH8_PROGRAM_START_ADDRESS + count * 2;
+    code[count++] = 0x00EE;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        uint16_t address = CH8_PROGRAM_START_ADDRESS + i * 2;
+        uint16_t opcode = code[i];
+        if (opcode == KERNEL_CALL)
+            opcode = 0x2000 | subroutine_address;
+        else if (opcode == KERNEL_JUMP_NEXT)
+            opcode = 0x1000 | (address + 2);
+
+        cpu->memory[address] = opcode >> 8;
+        cpu->memory[address + 1] = opcode & 0xFF;
+    }
+    core_InvalidateDecodedCPU(cpu, CH8_PROGRAM_START_ADDRESS, count * 2);
+}
+
+// Runs either 'rom' or 'kernel' BENCH_REPEATS times and keeps the fastest run.
+void RunBenchmark(const char *rom, const OpcodeKernel *kernel, const BenchMode *mode, uint64_t n_cycles, BenchResult *result)
+{
+    *result = (BenchResult){.cycles = n_cycles};
+    for (int repeat = 0; repeat < BENCH_REPEATS; repeat++)
+    {
+        CPUState *cpu = core_CreateHeadlessCPU(BENCH_CLOCK_FREQUENCY, CH8_DEFAULT_SEED);
+        if (!core_SetExecModeCPU(cpu, mode->mode))
+        {
+            core_DestroyCPU(cpu);
+            return;
+        }
+        if (rom != NULL)
+        {
+            core_SetMachineCPU(cpu, core_GetMachineForROM(rom));
+            core_LoadProgramCPU(cpu, rom);
+        }
+        else
+            LoadKernel(cpu, kernel);
+
+        AllocationCounts before, after;
+        GetAllocationCounts(&before);
+        double start = GetMonotonicTime();
+        core_RunCPUUnthrottled(cpu, n_cycles);
+        double elapsed = GetMonotonicTime() - start;
+        GetAllocationCounts(&after);
+
+        if (repeat == 0 || elapsed < result->seconds)
+            result->seconds = elapsed;
+        // Allocations should not depend on timing. Report the worst run in case they do.
+        if (repeat == 0 || after.allocations - before.allocations > result->allocations.allocations)
+        {
+            result->allocations.allocations = after.allocations - before.allocations;
+            result->allocations.frees = after.frees - before.frees;
+            result->allocations.bytes = after.bytes - before.bytes;
+        }
+
+        core_DestroyCPU(cpu);
+    }
+
+    result->available = true;
+}
+
+void PrintTableRow(FILE *out, const char *name, const BenchMode *mode, const BenchResult *result)
+{
+    if (!result->available)
+    {
+        fprintf(out, "%-24s %-12s %10s %10s %8s\n", name, mode->name, "n/a", "n/a", "n/a");
+        return;
+    }
+
+    fprintf(out, "%-24s %-12s %10.1f %10.2f %8llu\n", name, mode->name,
+            result->cycles / result->seconds / 1e6, SEC_TO_NS(result->seconds) / result->cycles,
+            (unsigned long long)result->allocations.allocations);
+}
+
+void PrintJSONString(FILE *out, const char *string)
+{
+    fputc('"', out);
+    for (const char *c = string; *c != '\0'; c++)
+    {
+        if (*c == '"' || *c == '\\')
+            fputc('\\', out);
+        if ((unsigned char)*c < 0x20)
+            fprintf(out, "\\u%04x", *c);
+        else
+            fputc(*c, out);
+    }
+    fputc('"', out);
+}
+
+// Prints one object per entry of 'modes'. Unavailable modes only report "available": false.
+void PrintJSONResults(FILE *out, const BenchResult *results)
+{
+    for (size_t m = 0; m < MODES_COUNT; m++)
+    {
+        const BenchResult *result = &results[m];
+        fprintf(out, "%s\n      {\"mode\": \"%s\", \"available\": %s", m > 0 ? "," : "",
+                modes[m].name, result->available ? "true" : "false");
+        if (result->available)
+        {
+            fprintf(out, ", \"cycles\": %llu, \"seconds\": %.6f, \"instructions_per_second\": %.1f, \"ns_per_instruction\": %.3f",
+                    (unsigned long long)result->cycles, result->seconds,
+                    result->cycles / result->seconds, SEC_TO_NS(result->seconds) / result->cycles);
+            if (AllocationCountingSupported())
+            {
+                fprintf(out, ", \"allocations\": %llu, \"frees\": %llu, \"allocated_bytes\": %llu",
+                        (unsigned long long)result->allocations.allocations,
+                        (unsigned long long)result->allocations.frees,
+                        (unsigned long long)result->allocations.bytes);
+            }
+        }
+        fprintf(out, "}");
+    }
+    fprintf(out, "\n    ");
+}
+
+void PrintJSONBuild(FILE *out, const BenchOptions *options)
+{
+    fprintf(out, "  \"label\": ");
+    PrintJSONString(out, options->label);
+    fprintf(out, ",\n  \"build\": {\"type\": ");
+    PrintJSONString(out, CH8_BUILD_TYPE);
+    fprintf(out, ", \"compiler\": ");
+    PrintJSONString(out, __VERSION__);
+#ifdef CH8_TRACE
+    fprintf(out, ", \"trace_logging\": true");
+#else
+    fprintf(out, ", \"trace_logging\": false");
+#endif
+    fprintf(out, ", \"allocation_counting\": %s},\n", AllocationCountingSupported() ? "true" : "false");
+    fprintf(out, "  \"repeats\": %d,\n  \"clock_frequency\": %d,\n", BENCH_REPEATS, BENCH_CLOCK_FREQUENCY);
+}
@@ -0,0 +1,128 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <core/cpu.h>
+#include <graphio/graphio.h>
+
+#include <timing/timing.h>
+
+#define RENDER_DEFAULT_FRAMES (3000)
+#define RENDER_DEFAULT_WIDTH (640)
+#define RENDER_DEFAULT_HEIGHT (320)
+#define RENDER_CLOCK_FREQUENCY (700)
+
+typedef struct RenderOptions
+{
+    uint64_t n_frames;
+    uint32_t width;
+    uint32_t height;
+    // Final frame is written here as PNG if set.
+    const char *png;
+} RenderOptions;
+
+static void PrintUsage();
+static bool ParseOptions(int argc, char **argv, RenderOptions *options, int *rom);
+
+// Runs a ROM through the headless renderer: one 60 Hz tick of emulation, then one frame.
+// Measures the real texture upload and shader pipeline without a display.
+int main(int argc, char **argv)
+{
+    RenderOptions options;
+    int rom;
+    if (!ParseOptions(argc, argv, &options, &rom) || rom != argc - 1)
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    Logger *logger = logger_Initialize(LOGS_BASE_PATH "render.log", LOG_LEVEL_FULL);
+    CPUState *cpu = core_CreateHeadlessCPU(RENDER_CLOCK_FREQUENCY, CH8_DEFAULT_SEED);
+    core_SetMachineCPU(cpu, core_GetMachineForROM(argv[rom]));
+    core_LoadProgramCPU(cpu, argv[rom]);
+    GraphioContext *gio = gio_CreateHeadlessGraphioContext(logger, &cpu->display, options.width, options.height);
+
+    uint64_t frames_read = 0;
+    uint64_t last_frame_read = 0;
+    double draw_time = 0;
+    double start_time = GetMonotonicTime();
+    for (uint64_t i = 0; i < options.n_frames; i++)
+    {
+        // The CPU runs on this thread, so each tick publishes a frame before we draw.
+        core_RunCPUUnthrottled(cpu, cpu->cycles_per_timer_tick);
+
+        double draw_start = GetMonotonicTime();
+        gio_Draw(gio);
+        draw_time += GetMonotonicTime() - draw_start;
+
+        // Poll without waiting, like a consumer that must not stall the submit thread would.
+        uint64_t frame_number;
+        if (gio_ReadbackFrame(gio, false, &frame_number) != NULL && frame_number != last_frame_read)
+        {
+            last_frame_read = frame_number;
+            frames_read++;
+        }
+    }
+
+    uint64_t frame_number = 0;
+    const uint8_t *pixels = gio_ReadbackFrame(gio, true, &frame_number);
+    double elapsed = GetMonotonicTime() - start_time;
+
+    printf("%llu frames at %ux%u in %.3f s. %.1f fps, %.1f us per gio_Draw. %llu frames read back without waiting.\n",
+           (unsigned long long)options.n_frames, options.width, options.height, elapsed,
+           options.n_frames / elapsed, SEC_TO_NS(draw_time) / 1000.0 / options.n_frames,
+           (unsigned long long)frames_read);
+
+    if (options.png != NULL && pixels != NULL)
+    {
+        gio_SavePixelBufferPNG(options.png, pixels, options.width, options.height, HEADLESS_IMAGE_CHANNELS);
+        printf("Frame %llu written to %s.\n", (unsigned long long)frame_number, options.png);
+    }
+
+    gio_StopGraphioContext(gio);
+    gio_DestroyGraphioContext(gio);
+    core_DestroyCPU(cpu);
+    logger_Destroy(logger);
+    return 0;
+}
+
+void PrintUsage()
+{
+    fprintf(stderr,
+            "usage: ch8-render [options] <rom>\n"
+            "  --frames N     frames to render (default %d)\n"
+            "  --width W      render target width (default %d)\n"
+            "  --height H     render target height (default %d)\n"
+            "  --png FILE     write the last frame to FILE\n",
+            RENDER_DEFAULT_FRAMES, RENDER_DEFAULT_WIDTH, RENDER_DEFAULT_HEIGHT);
+}
+
+bool ParseOptions(int argc, char **argv, RenderOptions *options, int *rom)
+{
+    options->n_frames = RENDER_DEFAULT_FRAMES;
+    options->width = RENDER_DEFAULT_WIDTH;
+    options->height = RENDER_DEFAULT_HEIGHT;
+    options->png = NULL;
+
+    int i = 1;
+    for (; i < argc && strncmp(argv[i], "--", 2) == 0; i += 2)
+    {
+        if (i + 1 >= argc)
+            return false;
+
+        const char *value = argv[i + 1];
+        if (strcmp(argv[i], "--frames") == 0)
+            options->n_frames = strtoull(value, NULL, 0);
+        else if (strcmp(argv[i], "--width") == 0)
+            options->width = strtoul(value, NULL, 0);
+        else if (strcmp(argv[i], "--height") == 0)
+            options->height = strtoul(value, NULL, 0);
+        else if (strcmp(argv[i], "--png") == 0)
+            options->png = value;
+        else
+            return false;
+    }
+
+    *rom = i;
+    return options->n_frames > 0 && options->width > 0 && options->height > 0;
+}
@@ -0,0 +1,124 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <core/cpu.h>
+#include <core/movie.h>
+
+#include <timing/timing.h>
+
+typedef struct ReplayOptions
+{
+    CPUExecMode mode;
+    // Framebuffer hash the replay must end with, if set.
+    bool check_hash;
+    uint64_t expected_hash;
+} ReplayOptions;
+
+static void PrintUsage();
+static bool ParseOptions(int argc, char **argv, ReplayOptions *options, int *movie);
+
+// Replays a movie recorded by the app headlessly and unthrottled, and reports the final
+// framebuffer hash. Equal movies give equal hashes in every execution mode.
+int main(int argc, char **argv)
+{
+    ReplayOptions options;
+    int movie_arg;
+    if (!ParseOptions(argc, argv, &options, &movie_arg) || movie_arg != argc - 2)
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    Movie *movie = core_OpenMovie(argv[movie_arg]);
+    if (movie == NULL)
+    {
+        fprintf(stderr, "%s is not a CHIP-8 movie of version %d.\n", argv[movie_arg], CH8_MOVIE_VERSION);
+        return 1;
+    }
+
+    CPUState *cpu = core_CreateHeadlessCPU(movie->header.clock_frequency, movie->header.seed);
+    if (!core_SetMachineCPU(cpu, movie->header.machine))
+    {
+        fprintf(stderr, "Movie was recorded on an unknown machine.\n");
+        return 1;
+    }
+    if (!core_SetExecModeCPU(cpu, options.mode))
+    {
+        fprintf(stderr, "Execution mode not supported on this host.\n");
+        return 1;
+    }
+    core_LoadProgramCPU(cpu, argv[movie_arg + 1]);
+    // Movies recorded from reset start at cycle 0. Catch up to later starts without input.
+    core_RunCPUUnthrottled(cpu, movie->header.start_cycle);
+    if (!core_SetMovieCPU(cpu, movie))
+    {
+        fprintf(stderr, "Movie was not recorded from %s.\n", argv[movie_arg + 1]);
+        return 1;
+    }
+
+    uint64_t n_cycles = movie->end_cycle - movie->header.start_cycle;
+    double start_time = GetMonotonicTime();
+    core_RunCPUUnthrottled(cpu, n_cycles);
+    double elapsed = GetMonotonicTime() - start_time;
+    core_SetMovieCPU(cpu, NULL);
+
+    uint64_t hash = core_HashDisplayCPU(cpu);
+    printf("%llu cycles in %.3f s (%.1f Mips). Framebuffer %016llx.\n", (unsigned long long)n_cycles, elapsed,
+           elapsed > 0 ? n_cycles / elapsed / 1e6 : 0.0, (unsigned long long)hash);
+
+    core_DestroyCPU(cpu);
+    core_DestroyMovie(movie);
+
+    if (options.check_hash && hash != options.expected_hash)
+    {
+        fprintf(stderr, "Expected framebuffer %016llx.\n", (unsigned long long)options.expected_hash);
+        return 2;
+    }
+    return 0;
+}
+
+void PrintUsage()
+{
+    fprintf(stderr,
+            "usage: ch8-replay [options] <movie> <rom>\n"
+            "  --mode M       interpreter, threaded or jit (default interpreter)\n"
+            "  --expect HASH  fail unless the final framebuffer hash is HASH, in hex\n");
+}
+
+bool ParseOptions(int argc, char **argv, ReplayOptions *options, int *movie)
+{
+    options->mode = CPU_EXEC_INTERPRETER;
+    options->check_hash = false;
+    options->expected_hash = 0;
+
+    int i = 1;
+    for (; i < argc && strncmp(argv[i], "--", 2) == 0; i += 2)
+    {
+        if (i + 1 >= argc)
+            return false;
+
+        const char *value = argv[i + 1];
+        if (strcmp(argv[i], "--expect") == 0)
+        {
+            options->check_hash = true;
+            options->expected_hash = strtoull(value, NULL, 16);
+        }
+        else if (strcmp(argv[i], "--mode") == 0)
+        {
+            if (strcmp(value, "interpreter") == 0)
+                options->mode = CPU_EXEC_INTERPRETER;
+            else if (strcmp(value, "threaded") == 0)
+                options->mode = CPU_EXEC_THREADED;
+            else if (strcmp(value, "jit") == 0)
+                options->mode = CPU_EXEC_JIT;
+            else
+                return false;
+        }
+        else
+            return false;
+    }
+
+    *movie = i;
+    return true;
+}
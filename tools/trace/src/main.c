@@ -0,0 +1,314 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <core/cpu.h>
+#include <core/trace.h>
+
+#define TRACE_CLOCK_FREQUENCY (700)
+#define SUMMARY_TOP_ADDRESSES (10)
+
+typedef struct TraceFilter
+{
+    uint16_t address_from;
+    uint16_t address_to;
+    uint64_t cycle_from;
+    uint64_t cycle_to;
+    // OP_COUNT matches every instruction.
+    InstructionOp op;
+    bool changed_only;
+} TraceFilter;
+
+typedef struct TraceSummary
+{
+    uint64_t first_cycle;
+    uint64_t last_cycle;
+    // Counted as CycleCPU would while profiling, so the mix and hot addresses print like 'profile'.
+    CPUProfile profile;
+    // Memory rebuilt from the traced opcodes, for core_PrintProfile to read them back.
+    CPUState *cpu;
+    uint64_t register_writes[CH8_VREG_COUNT];
+    uint64_t index_writes;
+    uint64_t stack_changes;
+} TraceSummary;
+
+static void PrintUsage();
+static int Record(const char *rom, uint64_t n_cycles, const char *filename);
+static int Profile(const char *rom, uint64_t n_cycles, size_t top_n);
+static int Decode(const char *filename, const TraceFilter *filter, bool summarize);
+static bool ParseFilter(int argc, char **argv, TraceFilter *filter);
+static bool ParseRange(const char *text, int base, uint64_t *from, uint64_t *to);
+static bool MatchFilter(const TraceFilter *filter, const CPUTraceRecord *record, InstructionOp op);
+static void PrintRecord(const CPUTraceRecord *record, InstructionOp op);
+static void AddToSummary(TraceSummary *summary, const CPUTraceRecord *record, InstructionOp op);
+static void PrintSummary(const TraceSummary *summary);
+
+int main(int argc, char **argv)
+{
+    if (argc >= 5 && strcmp(argv[1], "record") == 0)
+    {
+        return Record(argv[2], strtoull(argv[3], NULL, 0), argv[4]);
+    }
+
+    if (argc >= 4 && strcmp(argv[1], "profile") == 0)
+    {
+        size_t top_n = argc >= 5 ? strtoull(argv[4], NULL, 0) : SUMMARY_TOP_ADDRESSES;
+        return Profile(argv[2], strtoull(argv[3], NULL, 0), top_n);
+    }
+
+    if (argc >= 3 && (strcmp(argv[1], "dump") == 0 || strcmp(argv[1], "summary") == 0))
+    {
+        TraceFilter filter;
+        if (!ParseFilter(argc - 3, argv + 3, &filter))
+        {
+            PrintUsage();
+            return 1;
+        }
+        return Decode(argv[2], &filter, strcmp(argv[1], "summary") == 0);
+    }
+
+    PrintUsage();
+    return 1;
+}
+
+void PrintUsage()
+{
+    fprintf(stderr,
+            "usage: ch8-trace record <rom> <cycles> <trace>\n"
+            "       ch8-trace dump <trace> [filters]\n"
+            "       ch8-trace summary <trace> [filters]\n"
+            "       ch8-trace profile <rom> <cycles> [top addresses]\n"
+            "filters:\n"
+            "  --pc LO[-HI]         addresses in hex\n"
+            "  --cycles FROM[-TO]   cycle range\n"
+            "  --op PATTERN         opcode pattern, such as DXYN or 8XY4\n"
+            "  --changed            only instructions that changed registers, timers or stack\n");
+}
+
+int Record(const char *rom, uint64_t n_cycles, const char *filename)
+{
+    TraceWriter *writer = logger_CreateTraceWriter(filename, 0);
+    if (writer == NULL)
+    {
+        return 1;
+    }
+
+    CPUState *cpu = core_CreateHeadlessCPU(TRACE_CLOCK_FREQUENCY, CH8_DEFAULT_SEED);
+    core_SetMachineCPU(cpu, core_GetMachineForROM(rom));
+    core_LoadProgramCPU(cpu, rom);
+    core_SetTraceCPU(cpu, writer);
+    core_RunCPUUnthrottled(cpu, n_cycles);
+    core_SetTraceCPU(cpu, NULL);
+    core_DestroyCPU(cpu);
+
+    logger_FlushTraceWriter(writer);
+    printf("Recorded %llu instructions, %llu bytes.\n", (unsigned long long)n_cycles, (unsigned long long)writer->bytes_written);
+    logger_DestroyTraceWriter(writer);
+    return 0;
+}
+
+// Counts in memory instead of writing a trace, so long runs stay cheap.
+int Profile(const char *rom, uint64_t n_cycles, size_t top_n)
+{
+    CPUProfile *profile = calloc(1, sizeof(CPUProfile));
+    CPUState *cpu = core_CreateHeadlessCPU(TRACE_CLOCK_FREQUENCY, CH8_DEFAULT_SEED);
+    core_SetMachineCPU(cpu, core_GetMachineForROM(rom));
+    core_LoadProgramCPU(cpu, rom);
+    core_SetProfileCPU(cpu, profile);
+    core_RunCPUUnthrottled(cpu, n_cycles);
+    core_SetProfileCPU(cpu, NULL);
+
+    core_PrintProfile(profile, cpu, top_n, stdout);
+
+    core_DestroyCPU(cpu);
+    free(profile);
+    return 0;
+}
+
+int Decode(const char *filename, const TraceFilter *filter, bool summarize)
+{
+    FILE *file_pointer = fopen(filename, "rb");
+    if (file_pointer == NULL)
+    {
+        fprintf(stderr, "Failed to open %s.\n", filename);
+        return 1;
+    }
+    if (!core_ReadTraceHeader(file_pointer))
+    {
+        fprintf(stderr, "%s is not a CHIP-8 trace of version %d.\n", filename, CH8_TRACE_VERSION);
+        fclose(file_pointer);
+        return 1;
+    }
+
+    TraceSummary *summary = NULL;
+    if (summarize)
+    {
+        summary = calloc(1, sizeof(TraceSummary));
+        summary->cpu = core_CreateHeadlessCPU(TRACE_CLOCK_FREQUENCY, CH8_DEFAULT_SEED);
+        // The trace doesn't say which machine it came from. XO-CHIP memory fits any address.
+        core_SetMachineCPU(summary->cpu, CPU_MACHINE_XOCHIP);
+    }
+    CPUTraceRecord record = {0};
+    while (core_ReadTraceRecord(file_pointer, &record))
+    {
+        DecodedInstruction instruction;
+        core_DecodeInstruction(record.opcode, &instruction);
+        if (!MatchFilter(filter, &record, instruction.op))
+        {
+            continue;
+        }
+
+        if (summarize)
+            AddToSummary(summary, &record, instruction.op);
+        else
+            PrintRecord(&record, instruction.op);
+    }
+
+    if (summarize)
+    {
+        PrintSummary(summary);
+        core_DestroyCPU(summary->cpu);
+        free(summary);
+    }
+
+    fclose(file_pointer);
+    return 0;
+}
+
+bool ParseFilter(int argc, char **argv, TraceFilter *filter)
+{
+    filter->address_from = 0;
+    filter->address_to = UINT16_MAX;
+    filter->cycle_from = 0;
+    filter->cycle_to = UINT64_MAX;
+    filter->op = OP_COUNT;
+    filter->changed_only = false;
+
+    for (int i = 0; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--changed") == 0)
+        {
+            filter->changed_only = true;
+        }
+        else if (strcmp(argv[i], "--pc") == 0 && i + 1 < argc)
+        {
+            uint64_t from, to;
+            if (!ParseRange(argv[++i], 16, &from, &to))
+                return false;
+            filter->address_from = from;
+            filter->address_to = to;
+        }
+        else if (strcmp(argv[i], "--cycles") == 0 && i + 1 < argc)
+        {
+            if (!ParseRange(argv[++i], 10, &filter->cycle_from, &filter->cycle_to))
+                return false;
+        }
+        else if (strcmp(argv[i], "--op") == 0 && i + 1 < argc)
+        {
+            const char *pattern = argv[++i];
+            for (filter->op = 0; filter->op < OP_COUNT; filter->op++)
+            {
+                if (strcasecmp(pattern, core_GetInstructionOpName(filter->op)) == 0)
+                    break;
+            }
+            if (filter->op == OP_COUNT)
+                return false;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool ParseRange(const char *text, int base, uint64_t *from, uint64_t *to)
+{
+    char *end;
+    *from = strtoull(text, &end, base);
+    if (end == text)
+        return false;
+    if (*end == '\0')
+    {
+        *to = *from;
+        return true;
+    }
+    if (*end != '-')
+        return false;
+
+    const char *to_text = end + 1;
+    *to = strtoull(to_text, &end, base);
+    return end != to_text && *end == '\0';
+}
+
+bool MatchFilter(const TraceFilter *filter, const CPUTraceRecord *record, InstructionOp op)
+{
+    return record->address >= filter->address_from && record->address <= filter->address_to &&
+           record->cycle >= filter->cycle_from && record->cycle <= filter->cycle_to &&
+           (filter->op == OP_COUNT || filter->op == op) &&
+           (!filter->changed_only || record->changed != 0);
+}
+
+void PrintRecord(const CPUTraceRecord *record, InstructionOp op)
+{
+    printf("%10llu  0x%04X  %04X  %-6s", (unsigned long long)record->cycle, record->address, record->opcode,
+           core_GetInstructionOpName(op));
+
+    for (uint8_t i = 0; i < CH8_VREG_COUNT; i++)
+    {
+        if (record->changed & (1u << i))
+            printf(" V%X=%02X", i, record->variable_registers[i]);
+    }
+    if (record->changed & CH8_TRACE_CHANGED_I)
+        printf(" I=%04X", record->index_register);
+    if (record->changed & CH8_TRACE_CHANGED_DELAY_TIMER)
+        printf(" DT=%02X", record->delay_timer);
+    if (record->changed & CH8_TRACE_CHANGED_SOUND_TIMER)
+        printf(" ST=%02X", record->sound_timer);
+    if (record->changed & CH8_TRACE_CHANGED_STACK)
+        printf(" SP=%u", record->stack_depth);
+    if (record->changed & CH8_TRACE_TIMER_TICK)
+        printf(" tick");
+
+    printf("\n");
+}
+
+void AddToSummary(TraceSummary *summary, const CPUTraceRecord *record, InstructionOp op)
+{
+    if (summary->profile.instructions == 0)
+        summary->first_cycle = record->cycle;
+    summary->last_cycle = record->cycle;
+
+    summary->profile.instructions++;
+    summary->profile.op_counts[op]++;
+    summary->profile.address_counts[record->address >> 1]++;
+    uint8_t *memory = summary->cpu->memory;
+    memory[record->address] = record->opcode >> 8;
+    memory[(record->address + 1) & (summary->cpu->memory_size - 1)] = record->opcode & 0xFF;
+    for (uint32_t changed = record->changed & CH8_TRACE_CHANGED_VREGS; changed != 0; changed &= changed - 1)
+    {
+        summary->register_writes[__builtin_ctz(changed)]++;
+    }
+    if (record->changed & CH8_TRACE_CHANGED_I)
+        summary->index_writes++;
+    if (record->changed & CH8_TRACE_CHANGED_STACK)
+        summary->stack_changes++;
+}
+
+void PrintSummary(const TraceSummary *summary)
+{
+    core_PrintProfile(&summary->profile, summary->cpu, SUMMARY_TOP_ADDRESSES, stdout);
+    if (summary->profile.instructions == 0)
+    {
+        return;
+    }
+    printf("\nCycles: %llu-%llu\n", (unsigned long long)summary->first_cycle, (unsigned long long)summary->last_cycle);
+
+    printf("\nRegister writes:\n ");
+    for (uint8_t i = 0; i < CH8_VREG_COUNT; i++)
+    {
+        printf(" V%X=%llu", i, (unsigned long long)summary->register_writes[i]);
+    }
+    printf("\n  I=%llu stack=%llu\n", (unsigned long long)summary->index_writes, (unsigned long long)summary->stack_changes);
+}